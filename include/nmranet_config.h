@@ -78,6 +78,11 @@ DECLARE_CONST(executor_select_prescaler);
  */
 DECLARE_CONST(executor_max_sleep_msec);
 
+/** How many free buffers per size bucket every thread may keep cached in
+ * front of the main buffer pool. 0 disables the cache. Used only on hosts
+ * with OPENMRN_FEATURE_POOL_THREAD_CACHE. */
+DECLARE_CONST(buffer_pool_thread_cache_size);
+
 /** Number of packets to queue in the CANbus device driver for send. Each packet
  * takes 16 bytes of RAM. */
 DECLARE_CONST(can_tx_buffer_size);
@@ -128,6 +133,10 @@ DECLARE_CONST(gridconnect_buffer_delay_usec);
  * two threads per client (multi-threaded) execution model. */
 DECLARE_CONST(gridconnect_tcp_use_select);
 
+/** Whether the clients of a GridConnect TCP server should share the rendering
+ * of each outgoing frame instead of every client rendering its own copy. */
+DECLARE_CONST(gridconnect_tcp_shared_rendering);
+
 /// Maximum number of packets to parse from a single DirectHubPort before we
 /// wait for data to drain from the system.
 DECLARE_CONST(directhub_port_max_incoming_packets);
@@ -136,6 +145,20 @@ DECLARE_CONST(directhub_port_max_incoming_packets);
 /// will allocate at least this many bytes dedicated for each input port.
 DECLARE_CONST(directhub_port_incoming_buffer_size);
 
+/// Latency budget of the DirectHub output ports. When less than
+/// directhub_port_write_coalesce_bytes are queued, the port waits up to this
+/// many microseconds for more data, in order to write it all with a single
+/// syscall. 0 writes immediately.
+DECLARE_CONST(directhub_port_write_delay_usec);
+
+/// Number of queued bytes at which a DirectHub output port writes without
+/// waiting for the latency budget to expire.
+DECLARE_CONST(directhub_port_write_coalesce_bytes);
+
+/// Maximum number of CAN frames read from a single binary CAN DirectHub port
+/// that may be in flight before we wait for data to drain from the system.
+DECLARE_CONST(directhub_can_port_max_incoming_frames);
+
 /** Number of entries in the remote alias cache */
 DECLARE_CONST(remote_alias_cache_size);
 
@@ -178,10 +201,39 @@ DECLARE_CONST(node_init_identify);
  * time. */
 DECLARE_CONST(bulk_alias_num_can_frames);
 
+/** Maximum number of aliases for which the bulk alias allocator has sent the
+ * CID frames but not yet the RID frame. 0 for no limit. */
+DECLARE_CONST(bulk_alias_window);
+
+/** How many CAN frames per second the bulk alias allocator may send. 0 for no
+ * pacing other than waiting for the frames to leave the device. */
+DECLARE_CONST(bulk_alias_frames_per_sec);
+
 /** Default number of bytes in maximum stream window size for { @ref
  * StreamReceiver }. */
 DECLARE_CONST(stream_receiver_default_window_size);
 
+/** Minimum time in usec between calling two event handlers that reply to an
+ * identify events message. 0 for no pacing other than waiting for each
+ * handler's replies to leave the node. */
+DECLARE_CONST(event_identify_pace_usec);
+
+/** Set to CONSTANT_TRUE to remember which event handlers reply to an identify
+ * events message, and call only those for later identify messages until the
+ * event registry changes. Event handlers that may start replying without
+ * registering or unregistering anything need to call
+ * EventService::clear_identify_cache() then. */
+DECLARE_CONST(event_identify_cache);
+
+/** Set to CONSTANT_TRUE to keep the event handler registrations in a
+ * FlatEventHandlers instead of the default TreeEventHandlers. */
+DECLARE_CONST(event_registry_flat);
+
+/** A GcCanRoutingHub forgets the route to a node address that has not sent
+ * any frame for this many seconds. Frames to unknown addresses are sent to
+ * every port. 0 disables aging. */
+DECLARE_CONST(routing_hub_address_max_age_sec);
+
 /** Stack size for @ref SocketListener threads. */
 DECLARE_CONST(socket_listener_stack_size);
 
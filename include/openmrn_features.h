@@ -91,6 +91,37 @@
 #define OPENMRN_FEATURE_EXECUTOR_SELECT 1
 #endif
 
+#if defined(__linux__) && defined(OPENMRN_HAVE_PSELECT) &&                     \
+    !defined(__EMSCRIPTEN__)
+/// Uses ::epoll_pwait in the Executor instead of ::pselect. This removes the
+/// FD_SETSIZE limit on the file descriptors and makes a wakeup independent of
+/// the number of file descriptors being watched.
+#define OPENMRN_HAVE_EPOLL 1
+#endif
+
+#if defined(__linux__) || defined(__MACH__)
+/// Uses ::writev to write multiple buffers with a single syscall.
+#define OPENMRN_HAVE_WRITEV 1
+#endif
+
+#if (defined(__linux__) || defined(__MACH__)) && !defined(__EMSCRIPTEN__)
+/// Compiles the per-thread free buffer cache of DynamicPool. Needs
+/// thread_local storage with destructors.
+#define OPENMRN_FEATURE_POOL_THREAD_CACHE 1
+#endif
+
+#if defined(__linux__) || defined(__MACH__)
+/// Uses the hash table based HashAliasCache instead of AliasCache for the
+/// remote alias cache of IfCan. Hosts are the ones that see large networks.
+#define OPENMRN_FEATURE_HASH_ALIAS_CACHE 1
+#endif
+
+#if OPENMRN_HAVE_EPOLL
+/// Compiles ExecutorGroup, which runs strands of work over a pool of worker
+/// threads. Needs epoll to forward the select calls of the strands.
+#define OPENMRN_FEATURE_EXECUTOR_GROUP 1
+#endif
+
 #if (defined(ARDUINO) && !defined(ESP_PLATFORM)) || defined(ESP_NONOS) ||      \
     defined(__EMSCRIPTEN__)
 /// A loop() function is calling the executor in the single-threaded OS context.
@@ -171,6 +202,13 @@
 
 #endif
 
+#if defined(__linux__) || defined(__MACH__) || defined(__WINNT__) ||           \
+    defined(__EMSCRIPTEN__)
+/// Compiles the hierarchical timer wheel in ActiveTimers and uses it in the
+/// executors by default.
+#define OPENMRN_FEATURE_TIMER_WHEEL 1
+#endif
+
 #if !defined(__MACH__)
 /// Compiles support for calling reboot() in ConfigUpdateFlow.hxx and
 /// MemoryConfig.cxx.
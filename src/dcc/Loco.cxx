@@ -76,31 +76,105 @@ unsigned DccPayloadBase::get_fn_update_code(unsigned address)
     return SPEED;
 }
 
+unsigned DccPayloadBase::get_touched_bit(unsigned code)
+{
+    if (code >= FUNCTION29)
+    {
+        return TOUCHED_F29;
+    }
+    else if (code >= FUNCTION13)
+    {
+        return TOUCHED_F13;
+    }
+    else if (code >= FUNCTION5)
+    {
+        return TOUCHED_F5;
+    }
+    return 0;
+}
+
+bool DccPayloadBase::refresh_includes(unsigned code)
+{
+    unsigned bit = get_touched_bit(code);
+    if (!bit)
+    {
+        return true;
+    }
+    if (!(fnTouched_ & bit))
+    {
+        return false;
+    }
+    unsigned age = refreshAge_;
+    unsigned period = age < 2 ? 1 : age < 4 ? 2 : age < 8 ? 4 : 8;
+    return (age % period) == 0;
+}
+
+unsigned DccPayloadBase::next_refresh_code()
+{
+    unsigned code = MIN_REFRESH + nextRefresh_;
+    unsigned next = code + 1;
+    while (next <= MAX_REFRESH && !refresh_includes(next))
+    {
+        ++next;
+    }
+    if (next > MAX_REFRESH)
+    {
+        // End of cycle.
+        next = MIN_REFRESH;
+        refreshAge_ = refreshAge_ == 15 ? 8 : refreshAge_ + 1;
+    }
+    nextRefresh_ = next - MIN_REFRESH;
+    return code;
+}
+
 // Generates next outgoing packet.
 template <class Payload>
 void DccTrain<Payload>::get_next_packet(unsigned code, Packet *packet)
 {
-    packet->start_dcc_packet();
-    if (this->p.isShortAddress_)
+    if (code == REFRESH)
     {
-        packet->add_dcc_address(DccShortAddress(this->p.address_));
+        code = this->p.next_refresh_code();
+        fill_packet(code, packet);
+        return;
     }
-    else
+    fill_packet(code, packet);
+    if (code != ESTOP)
     {
-        packet->add_dcc_address(DccLongAddress(this->p.address_));
+        // User action. Up repeat count.
+        packet->packet_header.rept_count = 2;
     }
-    if (code == REFRESH)
+    if (code == SPEED)
+    {
+        this->p.directionChanged_ = 0;
+    }
+}
+
+template <class Payload> unsigned DccTrain<Payload>::refresh_bytes_per_cycle()
+{
+    unsigned bytes = 0;
+    for (unsigned code = MIN_REFRESH; code <= MAX_REFRESH; ++code)
     {
-        code = MIN_REFRESH + this->p.nextRefresh_++;
-        if (this->p.nextRefresh_ > MAX_REFRESH - MIN_REFRESH)
+        if (this->p.refresh_includes(code))
         {
-            this->p.nextRefresh_ = 0;
+            Packet pkt;
+            fill_packet(code, &pkt);
+            bytes += pkt.dlc;
         }
     }
+    return bytes;
+}
+
+template <class Payload>
+void DccTrain<Payload>::fill_packet(unsigned code, Packet *packet)
+{
+    packet->start_dcc_packet();
+    if (this->p.isShortAddress_)
+    {
+        packet->add_dcc_address(DccShortAddress(this->p.address_));
+    }
     else
     {
-        // User action. Up repeat count.
-        packet->packet_header.rept_count = 2;
+        packet->add_dcc_address(DccLongAddress(this->p.address_));
     }
     switch (code)
     {
@@ -151,12 +225,6 @@ void DccTrain<Payload>::get_next_packet(unsigned code, Packet *packet)
         // fall through
         case SPEED:
         {
-            if (this->p.directionChanged_)
-            {
-                // packet->packet_header.rept_count = 2;
-                this->p.directionChanged_ = 0;
-            }
-            // packet->packet_header.rept_count = 1;
             this->p.add_dcc_speed_to_packet(packet);
             return;
         }
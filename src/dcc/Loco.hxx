@@ -80,9 +80,10 @@ enum DccTrainUpdateCode
     MM_F3,
     MM_F4,
     MIN_REFRESH = SPEED,
-    /** @TODO(balazs.racz) choose adaptive max-refresh based on how many
-     * functions are actually in use for the loco. */
-    MAX_REFRESH = FUNCTION9,
+    /** Largest code the background refresh may generate. The refresh of a
+     * DccTrain only includes the function groups above F4 that were ever
+     * turned on, see DccPayloadBase::refresh_includes. */
+    MAX_REFRESH = FUNCTION61,
     MM_MAX_REFRESH = 7,
     ESTOP = 16,
 };
@@ -367,8 +368,9 @@ struct DccPayloadBase
 
     /// functions f0-f28.
     unsigned fn_ : 29;
-    /// Which refresh packet should go out next.
-    uint8_t nextRefresh_ : 3;
+    /// Bitmask of TOUCHED_* values: which ranges of functions were ever
+    /// turned on.
+    unsigned fnTouched_ : 3;
 
     // ==== 32-bit boundary ====
 
@@ -392,6 +394,41 @@ struct DccPayloadBase
     /// f29-f68 state.
     uint8_t fhi_[5];
 
+    /// Which refresh packet should go out next (offset from MIN_REFRESH).
+    uint8_t nextRefresh_ : 4;
+    /// How many refresh cycles ago a function was last changed. Counts up to
+    /// 15, then wraps back to 8.
+    uint8_t refreshAge_ : 4;
+
+    /// Bits of fnTouched_.
+    enum
+    {
+        /// F5-F12 were used.
+        TOUCHED_F5 = 1,
+        /// F13-F28 were used.
+        TOUCHED_F13 = 2,
+        /// F29-F68 were used.
+        TOUCHED_F29 = 4,
+    };
+
+    /// @return the TOUCHED_* bit that covers a given function update code,
+    /// or 0 for SPEED and FUNCTION0.
+    static unsigned get_touched_bit(unsigned code);
+
+    /// Decides whether the current background refresh cycle should contain
+    /// a given packet. Speed and F0-F4 are always refreshed. The other
+    /// function groups are refreshed only if a function in them was ever
+    /// turned on, and with exponential back-off: after a function change
+    /// they are refreshed in the next three cycles, then every 2nd, 4th and
+    /// finally every 8th cycle.
+    /// @param code a refresh code, MIN_REFRESH..MAX_REFRESH.
+    /// @return true if code should be sent in the current cycle.
+    bool refresh_includes(unsigned code);
+
+    /// Moves forward in the background refresh cycle.
+    /// @return the code of the next refresh packet to send.
+    unsigned next_refresh_code();
+
     /// @return the largest function number supported by this train
     /// (inclusive).
     static unsigned get_max_fn()
@@ -404,6 +441,17 @@ struct DccPayloadBase
     /// @param value function state
     void set_fn_store(unsigned idx, bool value)
     {
+        if (value != get_fn_store(idx))
+        {
+            // Refreshes the function groups more often again.
+            refreshAge_ = 0;
+        }
+        if (value)
+        {
+            // The function group of this function will be part of the
+            // background refresh from now on.
+            fnTouched_ |= get_touched_bit(get_fn_update_code(idx));
+        }
         if (idx < 29)
         {
             if (value)
@@ -487,6 +535,7 @@ struct Dcc28Payload : public DccPayloadBase
 };
 
 static_assert(sizeof(Dcc28Payload) == 16, "size of dcc payload is wrong");
+static_assert(MAX_REFRESH - MIN_REFRESH < 16, "refresh code overflow");
 
 /// TrainImpl class for a DCC locomotive.
 template <class Payload> class DccTrain : public AbstractTrain<Payload>
@@ -514,6 +563,17 @@ public:
     /// requested by the previous cycle or the on-update notification). @param
     /// packet needs to be filled in for the output.
     void get_next_packet(unsigned code, Packet *packet) OVERRIDE;
+
+    /// @return how many bytes of DCC packets (address, instruction and
+    /// checksum) the current background refresh cycle of this train
+    /// contains.
+    unsigned refresh_bytes_per_cycle() OVERRIDE;
+
+private:
+    /// Fills in the packet for a given code from the current train state.
+    /// @param code is the packet code (not REFRESH).
+    /// @param packet needs to be filled in for the output.
+    void fill_packet(unsigned code, Packet *packet);
 };
 
 /// TrainImpl class for a 28-speed-step DCC locomotive.
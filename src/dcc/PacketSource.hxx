@@ -56,6 +56,14 @@ public:
      * tells which recently changed value should be generated. 
      * @param packet is the storage to set the outgoing packet in. */
     virtual void get_next_packet(unsigned code, Packet* packet) = 0;
+
+    /** @return how many bytes of packets (including the checksum) the
+     * background refresh of this source sends in one full refresh cycle, or
+     * 0 if not known. */
+    virtual unsigned refresh_bytes_per_cycle()
+    {
+        return 0;
+    }
 };
 
 /// Abstract class that is a packet source but not a TrainImpl. Provides dummy
@@ -0,0 +1,301 @@
+/** \copyright
+ * Copyright (c) 2026, agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are  permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file PriorityUpdateLoop.cxx
+ *
+ * Control flow central to the command station: sends out packets for user
+ * actions with priority, and refreshes the individual trains in the remaining
+ * packet slots.
+ *
+ * @author agent
+ * @date 17 Oct 2026
+ */
+
+#include "dcc/PriorityUpdateLoop.hxx"
+
+#include <algorithm>
+
+#include "dcc/Loco.hxx"
+#include "dcc/Packet.hxx"
+#include "dcc/PacketSource.hxx"
+
+namespace dcc
+{
+
+PriorityUpdateLoop::PriorityUpdateLoop(Service *service, TrackIf *track_send)
+    : StateFlow(service)
+    , trackSend_(track_send)
+{
+}
+
+PriorityUpdateLoop::~PriorityUpdateLoop()
+{
+}
+
+unsigned PriorityUpdateLoop::refresh_bytes_per_cycle()
+{
+    AtomicHolder h(this);
+    unsigned bytes = 0;
+    for (auto &band : refreshBands_)
+    {
+        for (auto *s : band.sources)
+        {
+            bytes += s->refresh_bytes_per_cycle();
+        }
+    }
+    return bytes;
+}
+
+PriorityUpdateLoop::Band PriorityUpdateLoop::band_of(unsigned code)
+{
+    switch (code)
+    {
+        case ESTOP:
+            return URGENT_BAND;
+        case dcc::SPEED:
+            return SPEED_BAND;
+        default:
+            return FUNCTION_BAND;
+    }
+}
+
+bool PriorityUpdateLoop::add_refresh_source(
+    dcc::PacketSource *source, unsigned priority)
+{
+    AtomicHolder h(this);
+    if (priority < EXCLUSIVE_MIN_PRIORITY)
+    {
+        auto bit = refreshBands_.begin();
+        while (bit != refreshBands_.end() && bit->priority > priority)
+        {
+            ++bit;
+        }
+        if (bit == refreshBands_.end() || bit->priority != priority)
+        {
+            bit = refreshBands_.insert(bit, RefreshBand(priority));
+        }
+        bit->sources.push_back(source);
+        return exclusiveSources_.empty();
+    }
+    auto it = exclusiveSources_.begin();
+    while (it != exclusiveSources_.end() && it->first > priority)
+    {
+        ++it;
+    }
+    bool highest = it == exclusiveSources_.begin();
+    exclusiveSources_.insert(it, std::make_pair(priority, source));
+    return highest;
+}
+
+void PriorityUpdateLoop::remove_refresh_source(dcc::PacketSource *source)
+{
+    AtomicHolder h(this);
+    for (auto bit = refreshBands_.begin(); bit != refreshBands_.end();)
+    {
+        auto &v = bit->sources;
+        auto it = std::find(v.begin(), v.end(), source);
+        if (it != v.end())
+        {
+            if ((size_t)(it - v.begin()) < bit->nextIndex)
+            {
+                --bit->nextIndex;
+            }
+            v.erase(it);
+        }
+        if (v.empty())
+        {
+            bit = refreshBands_.erase(bit);
+        }
+        else
+        {
+            ++bit;
+        }
+    }
+    exclusiveSources_.erase(std::remove_if(exclusiveSources_.begin(),
+                                exclusiveSources_.end(),
+                                [source](
+                                    const std::pair<unsigned, PacketSource *>
+                                        &e) { return e.second == source; }),
+        exclusiveSources_.end());
+    for (auto &band : pending_)
+    {
+        band.erase(std::remove_if(band.begin(), band.end(),
+                       [source](const Update &u)
+                       { return u.source == source; }),
+            band.end());
+    }
+}
+
+void PriorityUpdateLoop::notify_update(PacketSource *source, unsigned code)
+{
+    AtomicHolder h(this);
+    auto &band = pending_[band_of(code)];
+    for (const auto &u : band)
+    {
+        if (u.source == source && u.code == code)
+        {
+            // Already pending. The packet will be generated from the latest
+            // state when it goes out.
+            ++stats_.mergedUpdates;
+            return;
+        }
+    }
+    // The update can go out in the next slot at the earliest.
+    band.push_back({source, code, slot_ + 1});
+}
+
+bool PriorityUpdateLoop::take_update(Update *u, bool allow_refresh)
+{
+    Band b;
+    uint32_t interval = config_dcc_update_refresh_interval();
+    if (!pending_[URGENT_BAND].empty())
+    {
+        b = URGENT_BAND;
+    }
+    else if (allow_refresh && interval && !refreshBands_.empty() &&
+        slot_ - lastRefreshSlot_ >= interval)
+    {
+        // Refresh is starving.
+        return false;
+    }
+    else if (!pending_[FUNCTION_BAND].empty() &&
+        (pending_[SPEED_BAND].empty() ||
+            slot_ - pending_[FUNCTION_BAND].front().slot >=
+                (uint32_t)config_dcc_update_max_function_delay()))
+    {
+        b = FUNCTION_BAND;
+    }
+    else if (!pending_[SPEED_BAND].empty())
+    {
+        b = SPEED_BAND;
+    }
+    else
+    {
+        return false;
+    }
+    *u = pending_[b].front();
+    pending_[b].pop_front();
+    uint32_t delay = slot_ - u->slot;
+    ++stats_.updatePackets[b];
+    stats_.totalDelay[b] += delay;
+    if (delay > stats_.maxDelay[b])
+    {
+        stats_.maxDelay[b] = delay;
+    }
+    return true;
+}
+
+PacketSource *PriorityUpdateLoop::RefreshBand::take(long long now)
+{
+    long long prev_cycle_start = lastCycleStart;
+    if (nextIndex >= sources.size())
+    {
+        nextIndex = 0;
+        lastCycleStart = now;
+    }
+    if (nextIndex == 0 && now - prev_cycle_start < MSEC_TO_NSEC(5))
+    {
+        // We do not want to send another packet to the same locomotive too
+        // quick.
+        return nullptr;
+    }
+    return sources[nextIndex++];
+}
+
+PacketSource *PriorityUpdateLoop::take_refresh()
+{
+    if (refreshBands_.empty())
+    {
+        // We do not have any locomotives at all. We will keep sending idle
+        // packets.
+        return nullptr;
+    }
+    long long current_time = os_get_time_monotonic();
+    // Band i gets every 2^(i+1)-th refresh slot, the last band gets what
+    // remains.
+    unsigned num_bands = refreshBands_.size();
+    if (!++refreshCount_)
+    {
+        refreshCount_ = 1;
+    }
+    unsigned first =
+        std::min((unsigned)__builtin_ctz(refreshCount_), num_bands - 1);
+    for (unsigned i = 0; i < num_bands; ++i)
+    {
+        PacketSource *s =
+            refreshBands_[(first + i) % num_bands].take(current_time);
+        if (s)
+        {
+            lastRefreshSlot_ = slot_;
+            return s;
+        }
+    }
+    // Every band would send a packet to the same locomotive too quick. We
+    // send an idle packet instead.
+    return nullptr;
+}
+
+StateFlowBase::Action PriorityUpdateLoop::entry()
+{
+    Update u {nullptr, 0, 0};
+    {
+        AtomicHolder h(this);
+        ++slot_;
+        ++stats_.slots;
+        if (!exclusiveSources_.empty())
+        {
+            u.source = exclusiveSources_.front().second;
+            ++stats_.exclusivePackets;
+            // The background refresh is not supposed to get slots now.
+            lastRefreshSlot_ = slot_;
+        }
+        else if (!take_update(&u, true))
+        {
+            u.source = take_refresh();
+            if (u.source)
+            {
+                ++stats_.refreshPackets;
+            }
+            else if (!take_update(&u, false))
+            {
+                ++stats_.idlePackets;
+            }
+        }
+    }
+    if (u.source)
+    {
+        u.source->get_next_packet(u.code, message()->data());
+    }
+    else
+    {
+        message()->data()->set_dcc_idle();
+    }
+    // We pass on the filled packet to the track processor.
+    trackSend_->send(transfer_message());
+    return exit();
+}
+
+} // namespace dcc
@@ -0,0 +1,246 @@
+/** \copyright
+ * Copyright (c) 2026, agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are  permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file PriorityUpdateLoop.hxx
+ *
+ * Control flow central to the command station: sends out packets for user
+ * actions with priority, and refreshes the individual trains in the remaining
+ * packet slots.
+ *
+ * @author agent
+ * @date 17 Oct 2026
+ */
+
+#ifndef _DCC_PRIORITYUPDATELOOP_HXX_
+#define _DCC_PRIORITYUPDATELOOP_HXX_
+
+#include <deque>
+#include <vector>
+
+#include "dcc/UpdateLoop.hxx"
+#include "executor/StateFlow.hxx"
+#include "utils/constants.hxx"
+
+/// When there are pending updates, every this many packet slots one is still
+/// given to the background refresh. 0 means that refresh only happens when
+/// there are no pending updates.
+DECLARE_CONST(dcc_update_refresh_interval);
+
+/// A function update that has been waiting for at least this many packet
+/// slots is sent out before any pending speed update.
+DECLARE_CONST(dcc_update_max_function_delay);
+
+namespace dcc
+{
+
+/// Implementation of a command station update loop that prioritizes user
+/// actions over the background refresh.
+///
+/// The notifications from the packet sources are sorted into three bands:
+/// - urgent (emergency stop) updates are sent out in the next packet slot.
+/// - speed updates.
+/// - function updates. These are sent after the speed updates, but a
+///   function update that waited for dcc_update_max_function_delay slots
+///   goes before the speed updates.
+///
+/// A notification for a source and code that is already pending does not
+/// take another slot; the packet is generated from the source's state at the
+/// time it is sent, so it will carry the latest value anyway.
+///
+/// While updates are pending, every dcc_update_refresh_interval-th slot is
+/// still given to the background refresh, so that a stream of user actions
+/// cannot starve the refresh of the other locomotives. When there are no
+/// pending updates, the refresh round-robins over all sources the same way
+/// as SimpleUpdateLoop does.
+///
+/// Non-exclusive sources are grouped into refresh bands by their priority.
+/// The highest priority band gets every second refresh slot, the next one
+/// every fourth, and so on; the lowest priority band gets the remaining
+/// slots. With all sources at the default priority 0 this is a plain
+/// round-robin.
+///
+/// Exclusive sources (priority at least EXCLUSIVE_MIN_PRIORITY) get all
+/// packet slots, the highest priority one first. Pending updates are kept
+/// while an exclusive source is registered and are sent out after it goes
+/// away.
+///
+/// Usage is the same as SimpleUpdateLoop.
+class PriorityUpdateLoop : public StateFlow<Buffer<dcc::Packet>, QList<1>>,
+                           private UpdateLoopBase
+{
+public:
+    PriorityUpdateLoop(Service *service, TrackIf *track_send);
+    ~PriorityUpdateLoop();
+
+    /// Which band an update is sent in.
+    enum Band
+    {
+        URGENT_BAND,
+        SPEED_BAND,
+        FUNCTION_BAND,
+        NUM_BANDS
+    };
+
+    /// Statistics about the packet slots assigned.
+    struct Stats
+    {
+        /// Total number of packet slots filled.
+        uint32_t slots {0};
+        /// Number of slots given to background refresh.
+        uint32_t refreshPackets {0};
+        /// Number of slots filled with an idle packet.
+        uint32_t idlePackets {0};
+        /// Number of slots given to exclusive sources.
+        uint32_t exclusivePackets {0};
+        /// Number of updates sent out in each band.
+        uint32_t updatePackets[NUM_BANDS] {0, 0, 0};
+        /// Number of notifications that were merged into an already pending
+        /// update.
+        uint32_t mergedUpdates {0};
+        /// Largest number of packet slots an update waited in each band,
+        /// from the notification to being sent.
+        uint32_t maxDelay[NUM_BANDS] {0, 0, 0};
+        /// Sum of the slots waited by updates in each band (divide by
+        /// updatePackets to get the mean).
+        uint64_t totalDelay[NUM_BANDS] {0, 0, 0};
+    };
+
+    /** Adds a new refresh source to the background refresh packets. */
+    bool add_refresh_source(
+        dcc::PacketSource *source, unsigned priority) override;
+
+    /** Deletes a packet refresh source, and forgets about all of its pending
+     * updates. */
+    void remove_refresh_source(dcc::PacketSource *source) override;
+
+    /** Queues an update to be sent out with priority. */
+    void notify_update(PacketSource *source, unsigned code) override;
+
+    /// @return the statistics about the packet slots assigned so far.
+    const Stats &stats()
+    {
+        return stats_;
+    }
+
+    /// Clears the statistics.
+    void clear_stats()
+    {
+        AtomicHolder h(this);
+        stats_ = Stats();
+    }
+
+    /// @return the sum of PacketSource::refresh_bytes_per_cycle() over all
+    /// refresh sources, i.e. how much track time the background refresh
+    /// needs to get around every locomotive once.
+    unsigned refresh_bytes_per_cycle();
+
+    /// @return which band an update code will be sent in.
+    static Band band_of(unsigned code);
+
+    // Entry to the state flow -- when a new packet needs to be sent.
+    Action entry() override;
+
+private:
+    /// A pending update.
+    struct Update
+    {
+        /// Who to call.
+        PacketSource *source;
+        /// Code to pass to get_next_packet.
+        unsigned code;
+        /// First slot this update could have been sent in.
+        uint32_t slot;
+    };
+
+    /// Picks a pending update for the current slot and removes it from the
+    /// queue. Must be called with the lock held.
+    /// @param u will be filled in with the update to send.
+    /// @param allow_refresh if true, the slot may be given to the background
+    /// refresh when it did not get enough slots lately.
+    /// @return false if the current slot should go to the background refresh
+    /// instead.
+    bool take_update(Update *u, bool allow_refresh);
+
+    /// Picks the next source for the background refresh. Must be called with
+    /// the lock held.
+    /// @return the source to refresh, or nullptr if the slot should be an
+    /// idle packet.
+    PacketSource *take_refresh();
+
+    // Place where we forward the packets filled in.
+    TrackIf *trackSend_;
+
+    /// Pending updates, per band, oldest first.
+    std::deque<Update> pending_[NUM_BANDS];
+
+    /// Non-exclusive packet sources of the same priority.
+    struct RefreshBand
+    {
+        RefreshBand(unsigned p)
+            : priority(p)
+            , nextIndex(0)
+            , lastCycleStart(os_get_time_monotonic())
+        {
+        }
+
+        /// Picks the next source to refresh in this band.
+        /// @param now current time
+        /// @return the source, or nullptr if the band's refresh cycle would
+        /// come around too quick.
+        PacketSource *take(long long now);
+
+        /// Priority of all sources in this band.
+        unsigned priority;
+        /// Packet sources to ask about refreshing data periodically.
+        std::vector<dcc::PacketSource *> sources;
+        /// Offset in the sources vector for the next loco to send.
+        size_t nextIndex;
+        /// os time for the last time we sent a packet for loco zero.
+        long long lastCycleStart;
+    };
+
+    /// Non-exclusive sources by priority, highest priority first. There are
+    /// no empty bands.
+    std::vector<RefreshBand> refreshBands_;
+
+    /// Exclusive sources with their priority, highest priority first.
+    std::vector<std::pair<unsigned, dcc::PacketSource *>> exclusiveSources_;
+
+    /// Counts the background refresh slots; decides which band gets the
+    /// next one.
+    uint32_t refreshCount_ {0};
+    /// Counts the packet slots.
+    uint32_t slot_ {0};
+    /// Value of slot_ at the last background refresh packet.
+    uint32_t lastRefreshSlot_ {0};
+
+    /// Statistics.
+    Stats stats_;
+};
+
+} // namespace dcc
+
+#endif // _DCC_PRIORITYUPDATELOOP_HXX_
@@ -35,3 +35,5 @@
 #include "utils/constants.hxx"
 
 DEFAULT_CONST(dcc_virtual_f0_offset, 100);
+DEFAULT_CONST(dcc_update_refresh_interval, 4);
+DEFAULT_CONST(dcc_update_max_function_delay, 8);
@@ -35,6 +35,8 @@
 #ifndef _EXECUTOR_DISPATCHER_HXX_
 #define _EXECUTOR_DISPATCHER_HXX_
 
+#include <algorithm>
+#include <atomic>
 #include <vector>
 
 #include "executor/Notifiable.hxx"
@@ -46,6 +48,34 @@
    invoked.
 
    Handlers are called in no particular order.
+
+   The registered handlers are stored in an immutable table. The dispatch flow
+   reads the current table without taking any locks. New registrations are
+   collected in a pending list, and the dispatch flow merges them into a new
+   copy of the table before it looks at the next message, so registering many
+   handlers costs one copy of the table instead of one copy per handler.
+   Unregistering only clears the handler pointer in the table; the cleared
+   entries are dropped at the next copy. Within the table the handlers are
+   grouped by their mask and sorted by the masked identifier, so matching an
+   incoming message costs one binary search per distinct mask instead of a
+   scan over all handlers.
+
+   Handlers can be registered in two modes. A regular handler owns the
+   message it receives: when more than one regular handler matches, each but
+   the last gets a freshly allocated copy of the message. A shared handler
+   promises to only read the message: it is called inline from the dispatch
+   flow with an additional reference to the original buffer, so no allocation
+   or copy happens on its behalf. A shared handler may decline a message
+   (see FlowInterface::accepts_shared); it then gets a private copy like a
+   regular handler. See @ref DispatchFlow::register_shared_handler.
+
+   Unregistering a handler is safe while the dispatch flow is running on a
+   different thread: the unregister call returns only after the dispatch flow
+   has stopped using the handler, so the caller may delete it right away.
+   When called on the thread that runs the dispatch flow (such as the
+   dispatcher's own executor, or from inside a handler), unregister never
+   blocks. A thread that the dispatch flow may be waiting on (for example one
+   holding a lock that a handler takes) must not unregister handlers.
  */
 template <int NUM_PRIO>
 class DispatchFlowBase : public UntypedStateFlow<QList<NUM_PRIO>>
@@ -83,10 +113,16 @@ protected:
        one
        @param handler is the flow to forward message to. It must stay alive so
        long as *this is alive or the handler is removed.
+       @param shared if true, the handler will receive a reference to the
+       original message instead of a copy.
      */
-    void register_handler(UntypedHandler *handler, ID id, ID mask);
+    void register_handler(
+        UntypedHandler *handler, ID id, ID mask, bool shared = false);
 
-    /// Removes a specific instance of a handler from this dispatcher.
+    /// Removes a specific instance of a handler from this dispatcher. When
+    /// called from a thread other than the one running the dispatch flow,
+    /// blocks until the dispatch flow is not using the handler anymore. Must
+    /// not be called from a thread that the dispatch flow may be waiting on.
     ///
     /// @param handler handler pointer to unregister.
     /// @param id bits to unregister the handler for
@@ -94,8 +130,9 @@ protected:
     ///
     void unregister_handler(UntypedHandler *handler, ID id, ID mask);
 
-    /// Removes all instances of a handler from this dispatcher. @param handler
-    /// is the handler to unregister from all instances.
+    /// Removes all instances of a handler from this dispatcher. Blocks the
+    /// same way as unregister_handler. @param handler is the handler to
+    /// unregister from all instances.
     void unregister_handler_all(UntypedHandler *handler);
 
     /// Sets one handler to receive all messages that no other handler has
@@ -115,9 +152,22 @@ protected:
      */
     virtual Action allocate_and_clone() = 0;
 
-    /** Sends the current message to lastHandlerToCall, transferring ownership.
-     */
-    virtual void send_transfer() = 0;
+    /** Sends the current message to a handler, transferring ownership.
+     * @param handler is the handler to call. */
+    virtual void send_transfer(UntypedHandler *handler) = 0;
+
+    /** Sends a new reference of the current message to a shared handler. The
+     * dispatch flow keeps its own reference. @param handler is the shared
+     * handler to call. */
+    virtual void send_shared(UntypedHandler *handler) = 0;
+
+    /** @return true if a shared handler can take a reference to the current
+     * message inline. @param handler is the shared handler to ask. */
+    virtual bool accepts_shared(UntypedHandler *handler) = 0;
+
+    /** Allocates a private copy of the message from the pool of
+     * declinedHandler_, and sends it there. Continues in declined_done(). */
+    virtual Action allocate_and_copy_declined() = 0;
 
     /*typedef typename StateFlow<MessageType, QList<NUM_PRIO>>::Callback Callback;
     using StateFlow<MessageType, QList<NUM_PRIO>>::again;
@@ -132,6 +182,10 @@ protected:
 
     STATE_FLOW_STATE(entry) override;
 
+    /// Executes the states of the dispatch flow. Announces the running thread
+    /// to the unregister calls.
+    void run() override;
+
     /*    Action entry()
         {
             currentIndex_ = 0;
@@ -144,6 +198,9 @@ protected:
     STATE_FLOW_STATE(iterate);
     /// State after a clone-and-send operation is complete.  @return next action
     STATE_FLOW_STATE(clone_done);
+    /// State after a shared handler that declined the message got its
+    /// private copy. @return next action
+    STATE_FLOW_STATE(declined_done);
     /// State when the entire iteration is done.  @return next action
     STATE_FLOW_STATE(iteration_done);
 
@@ -160,10 +217,48 @@ private:
         HandlerInfo() : handler(nullptr)
         {
         }
+        /// Copy constructor. @param o entry to copy.
+        HandlerInfo(const HandlerInfo &o)
+            : id(o.id)
+            , mask(o.mask)
+            , handler(o.handler.load())
+            , shared(o.shared)
+        {
+        }
+        /// Assignment operator. @param o entry to copy. @return *this
+        HandlerInfo &operator=(const HandlerInfo &o)
+        {
+            id = o.id;
+            mask = o.mask;
+            handler.store(o.handler.load());
+            shared = o.shared;
+            return *this;
+        }
+        /// Constructor. @param id registered identifier; @param mask
+        /// registered mask; @param handler handler to call; @param shared
+        /// true if the handler accepts a shared reference to the message.
+        HandlerInfo(
+            ID id, ID mask, UntypedHandler *handler, bool shared = false)
+            : id(id)
+            , mask(mask)
+            , handler(handler)
+            , shared(shared)
+        {
+        }
         ID id; ///< Bits that this handler is registered for.
         ID mask; ///< Mask that should be applied for the bits check.
-        /// Handler to call. NULL if the handler has been removed.
-        UntypedHandler *handler;
+        /// Handler to call. NULL if the handler has been removed. Cleared by
+        /// the unregister calls while the dispatch flow may be reading it.
+        std::atomic<UntypedHandler *> handler;
+        /// true if the handler gets a reference to the original message
+        /// instead of a copy.
+        bool shared;
+
+        /// @return the identifier bits that are relevant for matching.
+        ID key() const
+        {
+            return id & mask;
+        }
 
         /// Equality comparison function on the handlers. Used for remove()
         /// calls.
@@ -179,22 +274,142 @@ private:
             return (this->id == id && this->mask == mask &&
                     this->handler == handler);
         }
+
+        /// Sort order of the handler table: by mask first, then by the
+        /// masked identifier. @param o other entry. @return true if *this
+        /// has to come before o.
+        bool operator<(const HandlerInfo &o) const
+        {
+            if (mask != o.mask)
+            {
+                return mask < o.mask;
+            }
+            return key() < o.key();
+        }
     };
 
-    /// Registered handlers.
-    vector<HandlerInfo> handlers_;
+    /// Immutable snapshot of all registered handlers. Once published in
+    /// table_, the only modification allowed is clearing the handler pointer
+    /// of an entry that is being unregistered.
+    struct HandlerTable
+    {
+        /// Registered handlers, sorted by mask, then by masked identifier.
+        vector<HandlerInfo> entries;
+        /// Start offset of each run of entries with the same mask. The last
+        /// element is entries.size().
+        vector<unsigned> groups;
+
+        /// @return the number of distinct mask groups.
+        unsigned num_groups() const
+        {
+            return groups.empty() ? 0 : groups.size() - 1;
+        }
+
+        /// Recomputes the groups vector from the entries.
+        void update_groups()
+        {
+            groups.clear();
+            for (unsigned i = 0; i < entries.size(); ++i)
+            {
+                if (i == 0 || entries[i].mask != entries[i - 1].mask)
+                {
+                    groups.push_back(i);
+                }
+            }
+            groups.push_back(entries.size());
+        }
+    };
+
+    /// Creates a copy of the current handler table, leaving out all entries
+    /// that have been cleared. Must be called with lock_ held.
+    /// @return newly allocated table.
+    HandlerTable *copy_table();
+
+    /// Publishes a new handler table that contains the pending registrations.
+    /// Called by the dispatch flow before it looks at a message.
+    void merge_pending();
+
+    /// Clears the handler pointer of a table entry. Publishes a compacted
+    /// copy of the table once more than half of the entries are cleared.
+    /// Must be called with lock_ held. @param e the entry to clear.
+    void clear_entry(HandlerInfo *e);
+
+    /// Replaces the current handler table with a new one, and frees the
+    /// tables that are not used by the dispatch flow anymore. Must be called
+    /// with lock_ held. @param t the new table, ownership is transferred.
+    void publish_table(HandlerTable *t);
+
+    /// Sets currentIndex_ and rangeEnd_ to the entries of group
+    /// currentGroup_ that may match the current message.
+    /// @param id identifier of the current message.
+    void seek_group(ID id);
+
+    /// Sets a handler pointer to the handler of a table entry, unless the
+    /// entry got unregistered meanwhile. @param dst lastHandlerToCall_ or
+    /// declinedHandler_. @param h the table entry.
+    void set_handler(std::atomic<UntypedHandler *> *dst, HandlerInfo *h);
+
+    /// Called after the handler pointers were cleared. Blocks until the
+    /// dispatch flow finishes the states it is running on another thread,
+    /// since those may have loaded the handler before it was cleared. Must
+    /// not be called with lock_ held.
+    void wait_for_dispatch();
+
+    /// Wakes up the wait_for_dispatch calls after the flow stopped running.
+    void notify_waiters();
+
+    /// Current table of registered handlers. Written only under lock_.
+    std::atomic<HandlerTable *> table_ {nullptr};
+
+    /// The table that the dispatch flow is iterating on, or nullptr if the
+    /// flow is idle. Writers must not free this table.
+    std::atomic<HandlerTable *> readerTable_ {nullptr};
+
+    /// A table that was replaced, but could not be freed yet due to being in
+    /// use by the dispatch flow. Protected by lock_.
+    HandlerTable *retiredTable_ {nullptr};
+
+    /// Registrations that are not yet in table_. Protected by lock_.
+    vector<HandlerInfo> pending_;
+    /// true if pending_ is not empty.
+    std::atomic<bool> hasPending_ {false};
+    /// Number of entries in table_ whose handler pointer was cleared.
+    /// Protected by lock_.
+    unsigned numCleared_ {0};
+
+    /// wait_for_dispatch calls to notify when the flow stops running.
+    /// Protected by lock_.
+    vector<Notifiable *> waiters_;
+    /// true if waiters_ may be non-empty.
+    std::atomic<bool> hasWaiters_ {false};
+
+    /// Index of the mask group we are looking at in readerTable_.
+    unsigned currentGroup_;
+    /// Index of the next handler to look at in readerTable_.
+    unsigned currentIndex_;
+    /// End of the candidate range in the current mask group.
+    unsigned rangeEnd_;
+    /// true if the current message was given to at least one shared handler.
+    bool sharedDelivered_;
 
-    /// Index of the next handler to look at.
-    size_t currentIndex_;
+    /// The thread that is executing the states of the dispatch flow, or 0 if
+    /// the flow is not running.
+    std::atomic<os_thread_t> runner_ {0};
+    /// Incremented every time the flow stops running.
+    std::atomic<unsigned> runCount_ {0};
 
 protected:
-    /// If non-NULL we still need to call this handler.
-    UntypedHandler *lastHandlerToCall_{nullptr};
+    /// If non-NULL we still need to call this handler. Cleared by the
+    /// unregister calls while the dispatch flow may be reading it.
+    std::atomic<UntypedHandler *> lastHandlerToCall_{nullptr};
+    /// Shared handler that declined the current message and is waiting for
+    /// its private copy. Cleared by the unregister calls.
+    std::atomic<UntypedHandler *> declinedHandler_{nullptr};
     /// Handler to give all messages that were not matched by any other handler
     /// registration.
     UntypedHandler *fallbackHandler_{nullptr};
 private:
-    /// Protects handler add / remove against iteration.
+    /// Serializes handler add / remove calls against each other.
     OSMutex lock_;
 };
 
@@ -257,6 +472,33 @@ public:
         Base::register_handler(handler, id, mask);
     }
 
+    /**
+       Adds a new read-only handler to this dispatcher. Matching is the same
+       as for @ref register_handler.
+
+       Instead of a private copy of the message, the handler's send() function
+       is called inline from the dispatch flow with a new reference to the
+       original buffer. This saves an allocation and a copy of the message for
+       every shared handler. In exchange the handler must not modify the
+       message, must not add the buffer to any queue (e.g. by sending it to a
+       StateFlow), and must eventually call unref() on it. These rules hold
+       for handlers that process the message synchronously in send().
+
+       Before each message the dispatcher calls the handler's
+       accepts_shared(). If that returns false, the handler is treated as a
+       regular handler for that message: it gets a private copy allocated
+       from its pool(), and the dispatcher waits for that allocation.
+
+       @param id is the identifier of the message to listen to.
+       @param mask is the mask of the ID matcher.
+       @param handler is the handler to call. It must stay alive so long as
+       *this is alive or the handler is removed. Use @ref unregister_handler
+       to remove it.
+     */
+    void register_shared_handler(HandlerType *handler, ID id, ID mask) {
+        Base::register_handler(handler, id, mask, true);
+    }
+
     /// Removes a specific instance of a handler from this dispatcher.
     ///
     /// @param handler handler pointer to unregister.
@@ -289,19 +531,21 @@ protected:
 
     /// Requests allocating a new buffer for sending off a clone.
     Action allocate_and_clone() OVERRIDE {
-        if (!this->lastHandlerToCall_) {
+        HandlerType *h =
+            static_cast<HandlerType *>(this->lastHandlerToCall_.load());
+        if (!h) {
             // got unregistered.
             return call_immediately(STATE(clone_done));
         }
-        HandlerType* h = static_cast<HandlerType *>(this->lastHandlerToCall_);
         return allocate_and_call(h, STATE(clone));
     }
 
     /// Takes the allocated new buffer, copies the message into it and sends
     /// off to the clone target. @return next action.
     Action clone() {
-        HandlerType* h = static_cast<HandlerType *>(this->lastHandlerToCall_);
-        if (!this->lastHandlerToCall_) {  // got unregistered
+        HandlerType *h =
+            static_cast<HandlerType *>(this->lastHandlerToCall_.load());
+        if (!h) {  // got unregistered
             BufferBase* b;
             this->cast_allocation_result(&b);
             if (b) this->get_allocation_result(h)->unref();
@@ -315,11 +559,54 @@ protected:
     }
 
     /// Takes the existing buffer and sends off to the target flow. Only used
-    /// as the last action. Requires: lastHandlerToCall != nullptr.
-    void send_transfer() OVERRIDE {
-        HandlerType* h = static_cast<HandlerType *>(this->lastHandlerToCall_);
+    /// as the last action. @param handler is the handler to call.
+    void send_transfer(typename Base::UntypedHandler *handler) OVERRIDE {
+        HandlerType* h = static_cast<HandlerType *>(handler);
         h->send(this->transfer_message());
     }
+
+    /// Sends a new reference of the current message to a shared handler.
+    /// @param handler is the shared handler to call.
+    void send_shared(typename Base::UntypedHandler *handler) OVERRIDE {
+        HandlerType* h = static_cast<HandlerType *>(handler);
+        h->send(this->message()->ref());
+    }
+
+    /// @return true if a shared handler takes the current message inline.
+    /// @param handler is the shared handler to ask.
+    bool accepts_shared(typename Base::UntypedHandler *handler) OVERRIDE {
+        return static_cast<HandlerType *>(handler)->accepts_shared();
+    }
+
+    /// Allocates a private copy for a shared handler that declined the
+    /// message. @return next action.
+    Action allocate_and_copy_declined() OVERRIDE {
+        HandlerType *h =
+            static_cast<HandlerType *>(this->declinedHandler_.load());
+        if (!h) {
+            // got unregistered.
+            return call_immediately(STATE(declined_done));
+        }
+        return allocate_and_call(h, STATE(copy_declined));
+    }
+
+    /// Copies the message into the allocated buffer and sends it to the
+    /// shared handler that declined the message. @return next action.
+    Action copy_declined() {
+        HandlerType *h =
+            static_cast<HandlerType *>(this->declinedHandler_.load());
+        if (!h) {  // got unregistered
+            BufferBase* b;
+            this->cast_allocation_result(&b);
+            if (b) this->get_allocation_result(h)->unref();
+            return call_immediately(STATE(declined_done));
+        }
+        MessageType *copy = this->get_allocation_result(h);
+        copy->set_done(this->message()->new_child());
+        *copy->data() = *this->message()->data();
+        h->send(copy);
+        return call_immediately(STATE(declined_done));
+    }
 };
 
 
@@ -337,40 +624,114 @@ template<int NUM_PRIO>
 DispatchFlowBase<NUM_PRIO>::~DispatchFlowBase()
 {
     HASSERT(this->is_waiting());
+    delete table_.load();
+    delete retiredTable_;
 }
 
 template<int NUM_PRIO>
 size_t DispatchFlowBase<NUM_PRIO>::size()
 {
     OSMutexLock h(&lock_);
+    HandlerTable *t = table_.load();
     size_t ret = 0;
-    for (auto &h : handlers_)
+    if (!t)
+    {
+        return pending_.size();
+    }
+    for (auto &h : t->entries)
     {
         if (h.handler)
         {
             ++ret;
         }
     }
-    return ret;
+    return ret + pending_.size();
+}
+
+template <int NUM_PRIO>
+typename DispatchFlowBase<NUM_PRIO>::HandlerTable *
+DispatchFlowBase<NUM_PRIO>::copy_table()
+{
+    HandlerTable *t = new HandlerTable;
+    HandlerTable *current = table_.load();
+    if (current)
+    {
+        t->entries.reserve(current->entries.size() + 1);
+        for (auto &h : current->entries)
+        {
+            if (h.handler)
+            {
+                t->entries.push_back(h);
+            }
+        }
+    }
+    return t;
+}
+
+template <int NUM_PRIO>
+void DispatchFlowBase<NUM_PRIO>::publish_table(HandlerTable *t)
+{
+    t->update_groups();
+    numCleared_ = 0;
+    HandlerTable *old = table_.exchange(t);
+    // The dispatch flow announces the table it is using before it would
+    // dereference it, and re-checks table_ afterwards. Thus any table that is
+    // not announced right now will never be used again.
+    HandlerTable *busy = readerTable_.load();
+    if (retiredTable_ && retiredTable_ != busy)
+    {
+        delete retiredTable_;
+        retiredTable_ = nullptr;
+    }
+    if (old != busy)
+    {
+        delete old;
+    }
+    else
+    {
+        HASSERT(!retiredTable_);
+        retiredTable_ = old;
+    }
+}
+
+template<int NUM_PRIO>
+void DispatchFlowBase<NUM_PRIO>::register_handler(
+    UntypedHandler *handler, ID id, ID mask, bool shared)
+{
+    OSMutexLock h(&lock_);
+    pending_.emplace_back(id, mask, handler, shared);
+    hasPending_ = true;
 }
 
 template<int NUM_PRIO>
-void DispatchFlowBase<NUM_PRIO>::register_handler(UntypedHandler *handler,
-                                                  ID id, ID mask)
+void DispatchFlowBase<NUM_PRIO>::merge_pending()
 {
     OSMutexLock h(&lock_);
-    size_t idx = 0;
-    while (idx < handlers_.size() && handlers_[idx].handler)
+    if (pending_.empty())
     {
-        ++idx;
+        return;
     }
-    if (idx >= handlers_.size())
+    HandlerTable *t = copy_table();
+    size_t old_size = t->entries.size();
+    // Entries with the same key keep their registration order.
+    std::stable_sort(pending_.begin(), pending_.end());
+    t->entries.insert(t->entries.end(), pending_.begin(), pending_.end());
+    std::inplace_merge(t->entries.begin(), t->entries.begin() + old_size,
+        t->entries.end());
+    pending_.clear();
+    hasPending_ = false;
+    publish_table(t);
+}
+
+template<int NUM_PRIO>
+void DispatchFlowBase<NUM_PRIO>::clear_entry(HandlerInfo *e)
+{
+    e->handler = nullptr;
+    HandlerTable *current = table_.load();
+    if (++numCleared_ * 2 > current->entries.size())
     {
-        handlers_.resize(handlers_.size() + 1);
+        publish_table(copy_table());
     }
-    handlers_[idx].handler = handler;
-    handlers_[idx].id = id;
-    handlers_[idx].mask = mask;
 }
 
 template<int NUM_PRIO>
@@ -378,98 +739,295 @@ void
 DispatchFlowBase<NUM_PRIO>::unregister_handler(UntypedHandler *handler,
                                                ID id, ID mask)
 {
-    OSMutexLock h(&lock_);
-    /// @todo(balazs.racz) optimize by looking at the current index - 1.
-    size_t idx = 0;
-    while (idx < handlers_.size() && !handlers_[idx].Equals(id, mask, handler))
-    {
-        ++idx;
-    }
-    // Checks that we found the thing to unregister.
-    HASSERT(idx < handlers_.size() &&
-            "Tried to unregister a handler not previously registered.");
-    if (lastHandlerToCall_ == handlers_[idx].handler) {
-        lastHandlerToCall_ = nullptr;
-    }
-    handlers_[idx].handler = nullptr;
-    if (idx == handlers_.size() - 1)
     {
-        handlers_.resize(handlers_.size() - 1);
+        OSMutexLock h(&lock_);
+        for (auto it = pending_.begin(); it != pending_.end(); ++it)
+        {
+            if (it->Equals(id, mask, handler))
+            {
+                // The dispatch flow has not seen this registration yet.
+                pending_.erase(it);
+                hasPending_ = !pending_.empty();
+                return;
+            }
+        }
+        HandlerTable *current = table_.load();
+        HandlerInfo *found = nullptr;
+        if (current)
+        {
+            HandlerInfo probe(id, mask, nullptr);
+            auto range = std::equal_range(
+                current->entries.begin(), current->entries.end(), probe);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                if (it->Equals(id, mask, handler))
+                {
+                    found = &*it;
+                    break;
+                }
+            }
+        }
+        // Checks that we found the thing to unregister.
+        HASSERT(found &&
+                "Tried to unregister a handler not previously registered.");
+        // The dispatch flow might be iterating over the retired table; the
+        // handler must not be called from there anymore.
+        if (retiredTable_)
+        {
+            for (auto &e : retiredTable_->entries)
+            {
+                if (e.Equals(id, mask, handler))
+                {
+                    e.handler = nullptr;
+                    break;
+                }
+            }
+        }
+        UntypedHandler *expected = handler;
+        lastHandlerToCall_.compare_exchange_strong(expected, nullptr);
+        expected = handler;
+        declinedHandler_.compare_exchange_strong(expected, nullptr);
+        clear_entry(found);
     }
+    wait_for_dispatch();
 }
 
 template<int NUM_PRIO>
 void DispatchFlowBase<NUM_PRIO>::unregister_handler_all(
     UntypedHandler *handler)
 {
-    OSMutexLock h(&lock_);
-    for (size_t i = 0; i < handlers_.size(); ++i)
     {
-        if (handlers_[i].handler == handler)
+        OSMutexLock h(&lock_);
+        pending_.erase(std::remove_if(pending_.begin(), pending_.end(),
+                           [handler](const HandlerInfo &e) {
+                               return e.handler == handler;
+                           }),
+            pending_.end());
+        hasPending_ = !pending_.empty();
+        if (retiredTable_)
+        {
+            for (auto &e : retiredTable_->entries)
+            {
+                if (e.handler == handler)
+                {
+                    e.handler = nullptr;
+                }
+            }
+        }
+        bool found = false;
+        if (HandlerTable *t = table_.load())
+        {
+            for (auto &e : t->entries)
+            {
+                if (e.handler == handler)
+                {
+                    e.handler = nullptr;
+                    ++numCleared_;
+                    found = true;
+                }
+            }
+        }
+        UntypedHandler *expected = handler;
+        lastHandlerToCall_.compare_exchange_strong(expected, nullptr);
+        expected = handler;
+        declinedHandler_.compare_exchange_strong(expected, nullptr);
+        if (!found)
+        {
+            return;
+        }
+        if (numCleared_ * 2 > table_.load()->entries.size())
+        {
+            publish_table(copy_table());
+        }
+    }
+    wait_for_dispatch();
+}
+
+template<int NUM_PRIO>
+void DispatchFlowBase<NUM_PRIO>::wait_for_dispatch()
+{
+    // The count has to be read first: if the flow stops running between the
+    // two loads, we see no runner.
+    unsigned count = runCount_.load();
+    os_thread_t runner = runner_.load();
+    if (runner == 0 || runner == os_thread_self())
+    {
+        // Not running, or we are being called from a handler. Either way the
+        // flow will see the cleared handler pointers when it next looks.
+        return;
+    }
+    SyncNotifiable n;
+    {
+        OSMutexLock h(&lock_);
+        // Has to be set before checking the count. The flow increments the
+        // count before looking at this flag.
+        hasWaiters_ = true;
+        if (runCount_.load() != count)
         {
-            handlers_[i].handler = nullptr;
+            return;
         }
+        waiters_.push_back(&n);
     }
-    while (!handlers_.empty() && handlers_.back().handler == nullptr)
+    n.wait_for_notification();
+}
+
+template<int NUM_PRIO>
+void DispatchFlowBase<NUM_PRIO>::notify_waiters()
+{
+    if (!hasWaiters_.load())
+    {
+        return;
+    }
+    OSMutexLock h(&lock_);
+    for (Notifiable *n : waiters_)
+    {
+        n->notify();
+    }
+    waiters_.clear();
+    hasWaiters_ = false;
+}
+
+template<int NUM_PRIO>
+void DispatchFlowBase<NUM_PRIO>::set_handler(
+    std::atomic<UntypedHandler *> *dst, HandlerInfo *h)
+{
+    UntypedHandler *handler = h->handler.load();
+    dst->store(handler);
+    if (handler && h->handler.load() != handler)
     {
-        handlers_.pop_back();
+        // Got unregistered after we loaded it. The unregister call might
+        // have missed our store to dst.
+        dst->compare_exchange_strong(handler, nullptr);
     }
 }
 
+template<int NUM_PRIO>
+void DispatchFlowBase<NUM_PRIO>::run()
+{
+    // Sequentially consistent operations order this store before any handler
+    // pointer load in the states, and the unregister calls' pointer clearing
+    // before their load of runner_.
+    runner_.store(os_thread_self());
+    StateFlowBase::run();
+    ++runCount_;
+    runner_.store(0);
+    notify_waiters();
+}
+
 template<int NUM_PRIO>
 StateFlowBase::Action DispatchFlowBase<NUM_PRIO>::entry()
 {
-    currentIndex_ = 0;
+    if (hasPending_.load())
+    {
+        merge_pending();
+    }
+    HandlerTable *t;
+    do
+    {
+        t = table_.load();
+        readerTable_.store(t);
+    } while (t != table_.load());
+    currentGroup_ = 0;
     lastHandlerToCall_ = nullptr;
+    sharedDelivered_ = false;
+    if (t && t->num_groups())
+    {
+        seek_group(get_message_id());
+    }
+    else
+    {
+        currentIndex_ = rangeEnd_ = 0;
+    }
     return call_immediately(STATE(iterate));
 }
 
+template<int NUM_PRIO>
+void DispatchFlowBase<NUM_PRIO>::seek_group(ID id)
+{
+    HandlerTable *t = readerTable_.load();
+    auto begin = t->entries.begin() + t->groups[currentGroup_];
+    auto end = t->entries.begin() + t->groups[currentGroup_ + 1];
+    if (negateMatch_)
+    {
+        // Almost everything matches; we need to look at each entry.
+        currentIndex_ = begin - t->entries.begin();
+        rangeEnd_ = end - t->entries.begin();
+        return;
+    }
+    HandlerInfo probe(id, begin->mask, nullptr);
+    auto range = std::equal_range(begin, end, probe);
+    currentIndex_ = range.first - t->entries.begin();
+    rangeEnd_ = range.second - t->entries.begin();
+}
+
 template<int NUM_PRIO>
 StateFlowBase::Action DispatchFlowBase<NUM_PRIO>::iterate()
 {
+    HandlerTable *t = readerTable_.load();
     ID id = get_message_id();
+    while (true)
     {
-        // @todo(balazs.racz) make the registered handlers structure for the
-        // dispatcher lock-free. This mutex here is very expensive.
-        OSMutexLock l(&lock_);
-        for (; currentIndex_ < handlers_.size(); ++currentIndex_)
+        if (currentIndex_ >= rangeEnd_)
         {
-            auto &h = handlers_[currentIndex_];
-            if (!h.handler)
+            if (!t || ++currentGroup_ >= t->num_groups())
             {
-                continue;
+                return iteration_done();
             }
-            if (negateMatch_ && (id & h.mask) == (h.id & h.mask))
-            {
-                continue;
-            }
-            if ((!negateMatch_) && (id & h.mask) != (h.id & h.mask))
+            seek_group(id);
+            continue;
+        }
+        auto &h = t->entries[currentIndex_];
+        UntypedHandler *handler = h.handler.load();
+        if (!handler ||
+            (negateMatch_ && (id & h.mask) == h.key()))
+        {
+            ++currentIndex_;
+            continue;
+        }
+        if (h.shared)
+        {
+            sharedDelivered_ = true;
+            if (!accepts_shared(handler))
             {
-                continue;
+                // The handler gets a private copy from its own pool. Waiting
+                // for that allocation holds back the dispatcher like for a
+                // regular handler.
+                set_handler(&declinedHandler_, &h);
+                return allocate_and_copy_declined();
             }
-            // At this point: we have another handler.
-            if (!lastHandlerToCall_)
-            {
-                // This was the first we found.
-                lastHandlerToCall_ = handlers_[currentIndex_].handler;
-                continue;
-            }            
-            break;
+            // No copy needed; the handler is called inline.
+            ++currentIndex_;
+            send_shared(handler);
+            continue;
         }
+        // At this point: we have another handler.
+        if (!lastHandlerToCall_)
+        {
+            // This was the first we found.
+            set_handler(&lastHandlerToCall_, &h);
+            ++currentIndex_;
+            continue;
+        }
+        break;
     }
-    if (currentIndex_ >= handlers_.size())
-    {
-        return iteration_done();
-    }
-    // Now: we have at least two different handler. We need to clone the
-    // message. We use the pool of the last handler to call by default.
+    // Now: we have at least two different regular handlers. We need to clone
+    // the message. We use the pool of the last handler to call by default.
     return allocate_and_clone();
 }
 
 template<int NUM_PRIO>
 StateFlowBase::Action DispatchFlowBase<NUM_PRIO>::clone_done()
 {
-    lastHandlerToCall_ = handlers_[currentIndex_].handler;
+    set_handler(
+        &lastHandlerToCall_, &readerTable_.load()->entries[currentIndex_]);
+    ++currentIndex_;
+    return call_immediately(STATE(iterate));
+}
+
+template<int NUM_PRIO>
+StateFlowBase::Action DispatchFlowBase<NUM_PRIO>::declined_done()
+{
+    declinedHandler_ = nullptr;
     ++currentIndex_;
     return call_immediately(STATE(iterate));
 }
@@ -477,16 +1035,17 @@ StateFlowBase::Action DispatchFlowBase<NUM_PRIO>::clone_done()
 template<int NUM_PRIO>
 StateFlowBase::Action DispatchFlowBase<NUM_PRIO>::iteration_done()
 {
-    if (lastHandlerToCall_)
+    readerTable_.store(nullptr);
+    UntypedHandler *handler = lastHandlerToCall_.load();
+    if (handler)
     {
-        send_transfer();
+        send_transfer(handler);
     }
-    else if (fallbackHandler_)
+    else if (fallbackHandler_ && !sharedDelivered_)
     {
         // Nothing handled this message, and we have a fallbac handler
         // registered. Gives the message to the fallback handler.
-        lastHandlerToCall_ = fallbackHandler_;
-        send_transfer();
+        send_transfer(fallbackHandler_);
     }
     return release_and_exit();
 }
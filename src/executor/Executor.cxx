@@ -38,6 +38,7 @@
 #include "executor/Executor.hxx"
 
 #include "openmrn_features.h"
+#include <errno.h>
 #include <unistd.h>
 
 #ifdef __WINNT__
@@ -77,10 +78,15 @@ ExecutorBase::ExecutorBase()
     , started_(0)
     , selectPrescaler_(0)
 {
+#if OPENMRN_HAVE_EPOLL
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    HASSERT(epollFd_ >= 0);
+#else
     FD_ZERO(&selectRead_);
     FD_ZERO(&selectWrite_);
     FD_ZERO(&selectExcept_);
     selectNFds_ = 0;
+#endif
 }
 
 /** Lookup an executor by its name.
@@ -302,7 +308,7 @@ void *ExecutorBase::entry()
         unsigned priority = UINT_MAX;
         if (!selectPrescaler_ || ((msg = next(&priority)) == nullptr))
         {
-            long long wait_length = activeTimers_.get_next_timeout();
+            long long wait_length = get_next_timeout();
             wait_with_select(wait_length);
             selectPrescaler_ = config_executor_select_prescaler();
             msg = next(&priority);
@@ -329,6 +335,176 @@ void *ExecutorBase::entry()
     return NULL;
 }
 
+#if OPENMRN_HAVE_EPOLL
+
+/// Events reported by epoll that make a file descriptor count as readable,
+/// writable or exceptional for a ::select call, indexed by SelectType - 1.
+static const uint32_t EPOLL_EVENTS_FOR_TYPE[3] = {
+    EPOLLIN | EPOLLRDNORM | EPOLLRDBAND | EPOLLHUP | EPOLLERR,
+    EPOLLOUT | EPOLLWRNORM | EPOLLWRBAND | EPOLLERR,
+    EPOLLPRI,
+};
+
+ExecutorBase::EpollFd *ExecutorBase::epoll_entry(int fd)
+{
+    if ((unsigned)fd >= epollFds_.size())
+    {
+        epollFds_.resize(fd + 1);
+    }
+    return &epollFds_[fd];
+}
+
+void ExecutorBase::epoll_update(int fd)
+{
+    EpollFd *e = epoll_entry(fd);
+    struct epoll_event ev;
+    ev.events = 0;
+    ev.data.u64 = 0;
+    ev.data.fd = fd;
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        if (e->jobs[i])
+        {
+            ev.events |= EPOLL_EVENTS_FOR_TYPE[i];
+        }
+    }
+    if (!ev.events)
+    {
+        // The fd might have been closed already, which removes it from the
+        // epoll set; errors are thus expected here.
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+        return;
+    }
+    // With EPOLLONESHOT the kernel disarms the fd after reporting an event,
+    // so a triggered Selectable does not need a syscall to be removed.
+    ev.events |= EPOLLONESHOT;
+    if (epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev) == 0)
+    {
+        return;
+    }
+    if (errno == ENOENT)
+    {
+        // Not registered yet, or the fd was closed and the number reused.
+        if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev) == 0)
+        {
+            return;
+        }
+    }
+    // epoll refuses regular files and some character devices (like
+    // /dev/null) with EPERM. ::select reports these as always ready, so we
+    // schedule the pending Selectables right away.
+    HASSERT(errno == EPERM);
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        Selectable *job = e->jobs[i];
+        if (job)
+        {
+            add(job->wakeup_, job->priority_);
+            e->jobs[i] = nullptr;
+        }
+    }
+}
+
+void ExecutorBase::select(Selectable *job)
+{
+    Selectable *&slot = epoll_entry(job->fd_)->jobs[job->selectType_ - 1];
+    if (slot)
+    {
+        LOG(FATAL,
+            "Multiple Selectables are waiting for the same fd %d type %u",
+            job->fd_, job->selectType_);
+    }
+    slot = job;
+    epoll_update(job->fd_);
+}
+
+bool ExecutorBase::is_selected(Selectable *job)
+{
+    return epoll_entry(job->fd_)->jobs[job->selectType_ - 1] != nullptr;
+}
+
+void ExecutorBase::unselect(Selectable *job)
+{
+    Selectable *&slot = epoll_entry(job->fd_)->jobs[job->selectType_ - 1];
+    if (!slot)
+    {
+        LOG(FATAL, "Tried to remove a non-active selectable: fd %d type %u",
+            job->fd_, job->selectType_);
+    }
+    slot = nullptr;
+    epoll_update(job->fd_);
+}
+
+void ExecutorBase::wait_with_select(long long wait_length)
+{
+    // We will check the queue for any prior wakeups after this call. If we
+    // already processed the executables, the wakeup is not necessary. Without
+    // this clear, there would always be two select() iterations happening when
+    // we are done with work and can go to sleep.
+    selectHelper_.clear_wakeup();
+    if (!empty())
+    {
+        wait_length = 0;
+    }
+    long long max_sleep = MSEC_TO_NSEC(config_executor_max_sleep_msec());
+    if (wait_length > max_sleep)
+    {
+        wait_length = max_sleep;
+    }
+    static constexpr int MAX_EVENTS = 32;
+    struct epoll_event events[MAX_EVENTS];
+    int ret = selectHelper_.epoll_wait(
+        epollFd_, events, MAX_EVENTS, wait_length);
+    dispatch_epoll_events(events, ret);
+}
+
+void ExecutorBase::poll_selectables()
+{
+    static constexpr int MAX_EVENTS = 32;
+    struct epoll_event events[MAX_EVENTS];
+    int ret;
+    do
+    {
+        ret = ::epoll_wait(epollFd_, events, MAX_EVENTS, 0);
+        dispatch_epoll_events(events, ret);
+    } while (ret == MAX_EVENTS);
+}
+
+void ExecutorBase::dispatch_epoll_events(
+    struct epoll_event *events, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        int fd = events[i].data.fd;
+        EpollFd *e = epoll_entry(fd);
+        bool remaining = false;
+        for (unsigned t = 0; t < 3; ++t)
+        {
+            Selectable *job = e->jobs[t];
+            if (!job)
+            {
+                continue;
+            }
+            if (events[i].events & EPOLL_EVENTS_FOR_TYPE[t])
+            {
+                add(job->wakeup_, job->priority_);
+                e->jobs[t] = nullptr;
+            }
+            else
+            {
+                remaining = true;
+            }
+        }
+        if (remaining)
+        {
+            // Re-arms the fd for the Selectables that did not trigger.
+            epoll_update(fd);
+        }
+    }
+}
+
+#else
+
 void ExecutorBase::select(Selectable *job)
 {
     fd_set *s = get_select_set(job->type());
@@ -425,6 +601,8 @@ void ExecutorBase::wait_with_select(long long wait_length)
     selectNFds_ = max_fd;
 }
 
+#endif // OPENMRN_HAVE_EPOLL
+
 #endif
 
 #if defined(ARDUINO)
@@ -458,4 +636,7 @@ ExecutorBase::~ExecutorBase()
     {
         shutdown();
     }
+#if OPENMRN_HAVE_EPOLL
+    ::close(epollFd_);
+#endif
 }
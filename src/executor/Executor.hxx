@@ -38,6 +38,9 @@
 
 #include <functional>
 #include <atomic>
+#include <vector>
+
+#include "openmrn_features.h"
 
 #include "executor/Executable.hxx"
 #include "executor/Notifiable.hxx"
@@ -86,7 +89,7 @@ public:
 
     /** Synchronously runs a closure on this executor. Does not return until
      * the execution is completed. @param fn is the closure to run. */
-    void sync_run(std::function<void()> fn);
+    virtual void sync_run(std::function<void()> fn);
 
 #if OPENMRN_FEATURE_RTOS_FROM_ISR
     /** Send a message to this Executor's queue. Callable from interrupt
@@ -175,6 +178,27 @@ protected:
 
     void run() override {}
 
+    /** Expires the timers that are due. Executors that drive the timers of
+     * other executors too may override this.
+     * @return the time in nanoseconds until the next timer expires. */
+    virtual long long get_next_timeout()
+    {
+        return activeTimers_.get_next_timeout();
+    }
+
+#if OPENMRN_HAVE_EPOLL
+    /** @return the epoll instance watching the Selectables of this
+     * executor. It becomes readable when a Selectable is ready. */
+    int epoll_fd()
+    {
+        return epollFd_;
+    }
+
+    /** Checks the Selectables without blocking, and schedules the ones that
+     * are ready. Must be called on the executor. */
+    void poll_selectables();
+#endif
+
     /** Helper object for interruptible select calls. */
     OSSelectWakeup selectHelper_;
 
@@ -192,6 +216,28 @@ private:
      * @param next_timer_nsec is the maximum time to sleep in nanoseconds. */
     void wait_with_select(long long next_timer_nsec);
 
+#if OPENMRN_HAVE_EPOLL
+    /// The Selectables waiting on one file descriptor.
+    struct EpollFd
+    {
+        /// Pending Selectable for each SelectType (indexed by type - 1).
+        Selectable *jobs[3] = {nullptr, nullptr, nullptr};
+    };
+
+    /// @return the entry for a given file descriptor, allocating if
+    /// needed. @param fd file descriptor.
+    EpollFd *epoll_entry(int fd);
+
+    /// Tells the kernel which events we are waiting for on a file
+    /// descriptor, based on the pending Selectables. @param fd file
+    /// descriptor to update.
+    void epoll_update(int fd);
+
+    /// Schedules the Selectables that became ready.
+    /// @param events array returned by epoll_wait.
+    /// @param count number of entries in events.
+    void dispatch_epoll_events(struct epoll_event *events, int count);
+#else
     /// Helper function.
     ///
     /// @param type a select type: READ, WRITE or EXCEPT
@@ -209,6 +255,7 @@ private:
         LOG(FATAL, "Unexpected select type %d", type);
         return nullptr;
     }
+#endif // OPENMRN_HAVE_EPOLL
 
     /** name of this Executor */
     const char *name_;
@@ -219,6 +266,12 @@ private:
     /** List of active timers. */
     ActiveTimers activeTimers_;
 
+#if OPENMRN_HAVE_EPOLL
+    /** epoll instance watching the file descriptors of the Selectables. */
+    int epollFd_;
+    /** Pending Selectables, indexed by file descriptor. */
+    std::vector<EpollFd> epollFds_;
+#else
     /** fd to select for read. */
     fd_set selectRead_;
     /** fd to select for write. */
@@ -229,6 +282,7 @@ private:
     int selectNFds_;
     /** Head of the linked list for the select calls. */
     TypedQueue<Selectable> selectables_;
+#endif
 
     /** Set to 1 when the executor thread has exited and it is safe to delete
      * *this. */
@@ -0,0 +1,564 @@
+/** \copyright
+ * Copyright (c) 2026, agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file ExecutorGroup.hxx
+ *
+ * A pool of executor threads that share the work of many strands.
+ *
+ * @author agent
+ * @date 17 Oct 2026
+ */
+
+#ifndef _EXECUTOR_EXECUTORGROUP_HXX_
+#define _EXECUTOR_EXECUTORGROUP_HXX_
+
+#include "openmrn_features.h"
+
+#if OPENMRN_FEATURE_EXECUTOR_GROUP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "executor/Executor.hxx"
+#include "os/OS.hxx"
+
+/// Runs the work of many services on a fixed number of threads.
+///
+/// An ExecutorGroup owns a set of worker threads. Each worker is an executor
+/// by itself, which can be used directly for services that should stay on
+/// one thread (e.g. for cache affinity).
+///
+/// Services that only need their executables to run one at a time should be
+/// created on a Strand instead. A strand is an executor without a thread: it
+/// has its own priority queue, timers and select loop, and whenever it has
+/// work, it is scheduled as a whole on its home worker. Idle workers steal
+/// runnable strands from the other workers. Since a strand is in at most one
+/// worker queue at a time, the executables of a strand never run
+/// concurrently, therefore StateFlows on a strand keep the same
+/// single-threaded semantics as on a regular Executor.
+///
+/// Partitionable services (e.g. one per port or one per virtual node) should
+/// get a strand each, which allows them to spread across the workers.
+///
+/// A strand has no thread. sync_run() on a strand runs the closure inline
+/// when called from the thread that is running the strand, or from the
+/// worker of a single-worker group (which can then not be running the
+/// strand). From other threads it blocks until a worker runs the closure.
+/// Limitation: assert_current() must not be used on a strand.
+template <unsigned NUM_PRIO> class ExecutorGroup
+{
+public:
+    class Strand;
+
+    /// One thread of the group.
+    class Worker : public ExecutorBase
+    {
+    public:
+        /// Constructor. Starts the thread.
+        /// @param parent the group we belong to.
+        /// @param name thread name.
+        /// @param priority thread priority.
+        /// @param stack_size thread stack size.
+        Worker(ExecutorGroup *parent, const char *name, int priority,
+            size_t stack_size)
+            : parent_(parent)
+        {
+            OSThread::start(name, priority, stack_size);
+        }
+
+        ~Worker()
+        {
+            shutdown();
+        }
+
+        void add(Executable *msg, unsigned priority = UINT_MAX) override
+        {
+            pinned_.insert(msg, priority >= NUM_PRIO ? NUM_PRIO - 1 : priority);
+            selectHelper_.wakeup();
+        }
+
+        bool empty() override
+        {
+            return pinned_.empty() && strands_.empty();
+        }
+
+        uint32_t sequence() override
+        {
+            return sequence_;
+        }
+
+    protected:
+        /// Expires the timers of this worker and of all the strands that
+        /// have this worker as home.
+        long long get_next_timeout() override
+        {
+            long long ret = ExecutorBase::get_next_timeout();
+            OSMutexLock l(&lock_);
+            for (Strand *s : homed_)
+            {
+                long long t = s->active_timers()->get_next_timeout();
+                if (t < ret)
+                {
+                    ret = t;
+                }
+            }
+            return ret;
+        }
+
+    private:
+        friend class ExecutorGroup;
+        friend class Strand;
+
+        /// Takes the next executable. Executables added to this worker come
+        /// first, then the strands scheduled here, then strands stolen from
+        /// the other workers.
+        Executable *next(unsigned *priority) override
+        {
+            auto result = pinned_.next();
+            if (!result.item)
+            {
+                result = strands_.next();
+            }
+            if (!result.item)
+            {
+                result = parent_->steal(this);
+            }
+            *priority = result.index;
+            return static_cast<Executable *>(result.item);
+        }
+
+        /// Schedules a strand that has work to do.
+        /// @param s the strand.
+        /// @param priority priority of the work the strand has.
+        void push_strand(Strand *s, unsigned priority)
+        {
+            bool had_backlog;
+            {
+                AtomicHolder h(strands_.lock());
+                had_backlog = strands_.pending() > 0;
+                strands_.insert_locked(s, priority);
+            }
+            selectHelper_.wakeup();
+            Executable *running = current();
+            if (had_backlog || (running && running != s))
+            {
+                // We are busy; let another worker pick up some of the work.
+                parent_->wakeup_peer(this);
+            }
+        }
+
+        /// Wakes up the thread, for example to recompute the timeout.
+        void wakeup()
+        {
+            selectHelper_.wakeup();
+        }
+
+        /// The group we belong to.
+        ExecutorGroup *parent_;
+        /// Executables added directly to this worker. These are never stolen.
+        QListProtected<NUM_PRIO> pinned_;
+        /// Strands that have work to do.
+        QListProtected<NUM_PRIO> strands_;
+        /// Protects homed_.
+        OSMutex lock_;
+        /// Strands that have this worker as home. Their timers and select
+        /// calls are driven by this thread.
+        std::vector<Strand *> homed_;
+    };
+
+    /// An executor without a thread. The work is run by the workers of the
+    /// group, one executable at a time.
+    class Strand : public ExecutorBase
+    {
+    public:
+        /// Constructor. @param home the worker that drives the timers and the
+        /// selects of this strand.
+        Strand(Worker *home)
+            : home_(home)
+            , scheduled_(false)
+            , closing_(false)
+            , selectable_(&forwarder_)
+            , forwarder_(this)
+            , pollTask_(this)
+            , rearm_(this)
+        {
+            {
+                OSMutexLock l(&home_->lock_);
+                home_->homed_.push_back(this);
+            }
+            home_->add(&rearm_, 0);
+        }
+
+        /// Destructor. The strand should be idle, i.e. the services using it
+        /// have been destroyed.
+        ~Strand()
+        {
+            home_->sync_run([this]() {
+                closing_ = true;
+                if (home_->is_selected(&selectable_))
+                {
+                    home_->unselect(&selectable_);
+                }
+                OSMutexLock l(&home_->lock_);
+                for (unsigned i = 0; i < home_->homed_.size(); ++i)
+                {
+                    if (home_->homed_[i] == this)
+                    {
+                        home_->homed_.erase(home_->homed_.begin() + i);
+                        break;
+                    }
+                }
+            });
+            while (true)
+            {
+                {
+                    AtomicHolder h(queue_.lock());
+                    if (!scheduled_)
+                    {
+                        break;
+                    }
+                }
+                usleep(100);
+            }
+        }
+
+        void add(Executable *msg, unsigned priority = UINT_MAX) override
+        {
+            if (priority >= NUM_PRIO)
+            {
+                priority = NUM_PRIO - 1;
+            }
+            bool do_schedule = false;
+            {
+                AtomicHolder h(queue_.lock());
+                queue_.insert_locked(msg, priority);
+                if (!scheduled_)
+                {
+                    scheduled_ = true;
+                    do_schedule = true;
+                }
+            }
+            if (do_schedule)
+            {
+                home_->push_strand(this, priority);
+            }
+            else if (msg == active_timers())
+            {
+                // A new timer might be earlier than what the home worker is
+                // waiting for.
+                home_->wakeup();
+            }
+        }
+
+        bool empty() override
+        {
+            return queue_.empty();
+        }
+
+        uint32_t sequence() override
+        {
+            return sequence_;
+        }
+
+        /// @return the worker that drives the timers and selects of this
+        /// strand.
+        Worker *home()
+        {
+            return home_;
+        }
+
+        void sync_run(std::function<void()> fn) override
+        {
+            os_thread_t self = os_thread_self();
+            if (runner_ == self ||
+                (home_->parent_->size() == 1 &&
+                    home_->selectHelper_.main_thread() == self))
+            {
+                // Either we are running this strand right now, or we are the
+                // only worker, which is not running the strand and cannot
+                // start running it until we return. Waiting for a worker
+                // would deadlock.
+                fn();
+                return;
+            }
+            ExecutorBase::sync_run(std::move(fn));
+        }
+
+    private:
+        friend class Worker;
+
+        /// How many executables we run before giving the worker thread back
+        /// to the other strands.
+        static constexpr unsigned BATCH_SIZE = 16;
+
+        /// Called by a worker thread. Runs a batch of the queued executables.
+        void run() override
+        {
+            runner_ = os_thread_self();
+            for (unsigned i = 0; i < BATCH_SIZE; ++i)
+            {
+                auto result = queue_.next();
+                if (!result.item)
+                {
+                    break;
+                }
+                ++sequence_;
+                static_cast<Executable *>(result.item)->run();
+            }
+            runner_ = 0;
+            unsigned priority;
+            {
+                AtomicHolder h(queue_.lock());
+                priority = first_priority_locked();
+                if (priority >= NUM_PRIO)
+                {
+                    scheduled_ = false;
+                    return;
+                }
+            }
+            home_->push_strand(this, priority);
+        }
+
+        /// @return the highest priority band that has work, or NUM_PRIO if
+        /// the queue is empty. Must be called with the queue lock held.
+        unsigned first_priority_locked()
+        {
+            for (unsigned p = 0; p < NUM_PRIO; ++p)
+            {
+                if (!queue_.empty(p))
+                {
+                    return p;
+                }
+            }
+            return NUM_PRIO;
+        }
+
+        Executable *next(unsigned *priority) override
+        {
+            auto result = queue_.next();
+            *priority = result.index;
+            return static_cast<Executable *>(result.item);
+        }
+
+        /// Runs on the home worker when the epoll fd of the strand is
+        /// readable, and schedules a poll on the strand.
+        class Forwarder : public Executable
+        {
+        public:
+            /// @param parent owning strand.
+            Forwarder(Strand *parent)
+                : parent_(parent)
+            {
+            }
+
+            void run() override
+            {
+                if (!parent_->closing_)
+                {
+                    parent_->add(&parent_->pollTask_, 0);
+                }
+            }
+
+        private:
+            /// Owning strand.
+            Strand *parent_;
+        };
+
+        /// Runs on the strand and schedules the Selectables that are ready.
+        class PollTask : public Executable
+        {
+        public:
+            /// @param parent owning strand.
+            PollTask(Strand *parent)
+                : parent_(parent)
+            {
+            }
+
+            void run() override
+            {
+                parent_->poll_selectables();
+                parent_->home_->add(&parent_->rearm_, 0);
+            }
+
+        private:
+            /// Owning strand.
+            Strand *parent_;
+        };
+
+        /// Runs on the home worker and starts waiting for the epoll fd of
+        /// the strand again.
+        class Rearm : public Executable
+        {
+        public:
+            /// @param parent owning strand.
+            Rearm(Strand *parent)
+                : parent_(parent)
+            {
+            }
+
+            void run() override
+            {
+                if (!parent_->closing_)
+                {
+                    parent_->selectable_.reset(
+                        Selectable::READ, parent_->epoll_fd(), 0);
+                    parent_->home_->select(&parent_->selectable_);
+                }
+            }
+
+        private:
+            /// Owning strand.
+            Strand *parent_;
+        };
+
+        /// Drives our timers and selects.
+        Worker *home_;
+        /// Executables waiting to be run on this strand.
+        QListProtected<NUM_PRIO> queue_;
+        /// True if the strand is in the queue of a worker or is running right
+        /// now. Protected by the queue lock.
+        bool scheduled_;
+        /// The thread running the strand right now, or 0.
+        std::atomic<os_thread_t> runner_ {0};
+        /// Set when the strand is being destroyed. Accessed on the home
+        /// worker.
+        bool closing_;
+        /// Waits in the home worker for the epoll fd of this strand.
+        Selectable selectable_;
+        /// Wakeup of selectable_.
+        Forwarder forwarder_;
+        /// Polls the selectables on the strand.
+        PollTask pollTask_;
+        /// Re-selects selectable_ on the home worker.
+        Rearm rearm_;
+    };
+
+    /// Constructor. Starts the worker threads.
+    /// @param name name of the worker threads.
+    /// @param num_workers how many threads to start.
+    /// @param priority thread priority.
+    /// @param stack_size thread stack size.
+    ExecutorGroup(
+        const char *name, unsigned num_workers, int priority, size_t stack_size)
+    {
+        HASSERT(num_workers > 0);
+        for (unsigned i = 0; i < num_workers; ++i)
+        {
+            workers_.emplace_back(
+                new Worker(this, name, priority, stack_size));
+        }
+    }
+
+    /// Destructor. Deletes the strands, then stops the worker threads. The
+    /// services using the group must have been destroyed before.
+    ~ExecutorGroup()
+    {
+        strands_.clear();
+        workers_.clear();
+    }
+
+    /// @return the number of worker threads.
+    unsigned size()
+    {
+        return workers_.size();
+    }
+
+    /// @param i index of the worker thread, 0 <= i < size().
+    /// @return an executor that runs everything on that thread. Use this for
+    /// services that should not move between threads.
+    Worker *worker(unsigned i)
+    {
+        return workers_[i].get();
+    }
+
+    /// Creates a new strand. The home workers of the strands are assigned
+    /// round-robin. The strand is owned by the group.
+    /// @return the new strand.
+    Strand *new_strand()
+    {
+        OSMutexLock l(&lock_);
+        Worker *home = workers_[strands_.size() % workers_.size()].get();
+        strands_.emplace_back(new Strand(home));
+        return strands_.back().get();
+    }
+
+private:
+    /// Takes a runnable strand from a worker other than the given one.
+    /// @param thief the worker that ran out of work.
+    /// @return a strand with its priority, or an empty result.
+    typename QListProtected<NUM_PRIO>::Result steal(Worker *thief)
+    {
+        unsigned n = workers_.size();
+        unsigned start = nextVictim_++;
+        for (unsigned i = 0; i < n; ++i)
+        {
+            Worker *victim = workers_[(start + i) % n].get();
+            if (victim == thief)
+            {
+                continue;
+            }
+            auto result = victim->strands_.next();
+            if (result.item)
+            {
+                return result;
+            }
+        }
+        return typename QListProtected<NUM_PRIO>::Result();
+    }
+
+    /// Wakes up a worker other than the given one, so that it can steal
+    /// work. @param busy the worker that has a backlog.
+    void wakeup_peer(Worker *busy)
+    {
+        unsigned n = workers_.size();
+        if (n < 2)
+        {
+            return;
+        }
+        Worker *w = workers_[nextVictim_++ % n].get();
+        if (w == busy)
+        {
+            w = workers_[nextVictim_++ % n].get();
+        }
+        w->wakeup();
+    }
+
+    /// Worker threads.
+    std::vector<std::unique_ptr<Worker>> workers_;
+    /// Strands created by new_strand().
+    std::vector<std::unique_ptr<Strand>> strands_;
+    /// Protects strands_.
+    OSMutex lock_;
+    /// Round-robin index for stealing and waking up peers.
+    std::atomic<unsigned> nextVictim_ {0};
+
+    DISALLOW_COPY_AND_ASSIGN(ExecutorGroup);
+};
+
+#endif // OPENMRN_FEATURE_EXECUTOR_GROUP
+
+#endif // _EXECUTOR_EXECUTORGROUP_HXX_
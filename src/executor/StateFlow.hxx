@@ -1138,6 +1138,17 @@ public:
     /// numbers mean process earlier.
     virtual void send(MessageType *message, unsigned priority = UINT_MAX) = 0;
 
+    /// Called by a DispatchFlow before it gives a shared reference of a
+    /// message to this flow (see DispatchFlow::register_shared_handler).
+    ///
+    /// @return false if the flow cannot process the message inline right
+    /// now. The dispatcher will then send a private copy of the message
+    /// through send() instead, allocated from pool().
+    virtual bool accepts_shared()
+    {
+        return true;
+    }
+
     /// This function is never user in the code, but GDB can use it to infer
     /// the correct message types. It has to be virtual so that it is not
     /// optimized away.
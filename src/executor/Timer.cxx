@@ -33,6 +33,9 @@
  */
 
 #include "executor/Timer.hxx"
+
+#include <algorithm>
+
 #include "executor/Executor.hxx"
 #include "os/os.h"
 
@@ -66,6 +69,15 @@ ActiveTimers::~ActiveTimers()
 {
 }
 
+void ActiveTimers::set_backend(Backend backend)
+{
+#if !OPENMRN_FEATURE_TIMER_WHEEL
+    HASSERT(backend == SORTED_LIST);
+#endif
+    HASSERT(empty());
+    backend_ = backend;
+}
+
 void ActiveTimers::notify()
 {
     if (isPending_.exchange(1) == 0)
@@ -81,9 +93,24 @@ void ActiveTimers::run()
     // call.
 }
 
+void ActiveTimers::expire_locked(Timer *timer)
+{
+    remove_locked(timer);
+    timer->isActive_ = 0;
+    timer->isExpired_ = 1;
+    // Puts it on the executor.
+    executor_->add(timer, timer->priority_);
+}
+
 long long ActiveTimers::get_next_timeout()
 {
     OSMutexLock l(&lock_);
+#if OPENMRN_FEATURE_TIMER_WHEEL
+    if (backend_ == TIMER_WHEEL)
+    {
+        return wheel_next_timeout_locked();
+    }
+#endif
 
     QMember **last = &activeTimers_.next;
     Timer *current_timer = static_cast<Timer *>(*last);
@@ -123,6 +150,12 @@ long long ActiveTimers::get_next_timeout()
 
 bool ActiveTimers::empty() {
     OSMutexLock l(&lock_);
+#if OPENMRN_FEATURE_TIMER_WHEEL
+    if (wheelSize_)
+    {
+        return false;
+    }
+#endif
 
     QMember **last = &activeTimers_.next;
     Timer *current_timer = static_cast<Timer *>(*last);
@@ -139,6 +172,14 @@ void ActiveTimers::insert_locked(Timer *timer)
 {
     HASSERT(timer);
     HASSERT(timer->next == nullptr);
+#if OPENMRN_FEATURE_TIMER_WHEEL
+    if (backend_ == TIMER_WHEEL)
+    {
+        wheel_insert_locked(timer);
+        notify();
+        return;
+    }
+#endif
 
     QMember **last = &activeTimers_.next;
     Timer *current_timer = static_cast<Timer *>(*last);
@@ -159,6 +200,13 @@ void ActiveTimers::insert_locked(Timer *timer)
 void ActiveTimers::remove_locked(Timer *timer)
 {
     HASSERT(timer);
+#if OPENMRN_FEATURE_TIMER_WHEEL
+    if (backend_ == TIMER_WHEEL)
+    {
+        wheel_remove_locked(timer);
+        return;
+    }
+#endif
     // Removes the timer from the queue.
     QMember **last = &activeTimers_.next;
     while (*last && *last != timer)
@@ -185,3 +233,208 @@ void ActiveTimers::remove_timer(Timer *timer)
     remove_locked(timer);
     timer->isActive_ = 0;
 }
+
+#if OPENMRN_FEATURE_TIMER_WHEEL
+
+/// Finds the next set bit in a circular bitmap.
+/// @param bits the bitmap of occupied slots.
+/// @param cur current slot index.
+/// @return how many slots after cur the next set bit is (1..64), or 0 if bits
+/// is zero. The bit of cur itself is found at distance 64.
+static unsigned next_set_bit(uint64_t bits, unsigned cur)
+{
+    if (!bits)
+    {
+        return 0;
+    }
+    unsigned sh = (cur + 1) & 63;
+    if (sh)
+    {
+        bits = (bits >> sh) | (bits << (64 - sh));
+    }
+    return __builtin_ctzll(bits) + 1;
+}
+
+void ActiveTimers::wheel_insert_locked(Timer *timer)
+{
+    if (!wheelSize_)
+    {
+        // Nothing can expire in between, so we skip ahead to the present.
+        wheelTick_ = std::max(
+            wheelTick_, OSTime::get_monotonic() >> WHEEL_TICK_SHIFT);
+    }
+    ++wheelSize_;
+    long long tick = timer->when_ >> WHEEL_TICK_SHIFT;
+    long long delta = tick - wheelTick_;
+    static constexpr long long MAX_DELTA = 1LL
+        << (WHEEL_LEVEL_BITS * WHEEL_LEVELS);
+    if (delta <= 0)
+    {
+        // Already expired; goes to the current slot.
+        tick = wheelTick_;
+        delta = 0;
+    }
+    else if (delta >= MAX_DELTA)
+    {
+        tick = wheelTick_ + MAX_DELTA - 1;
+        delta = MAX_DELTA - 1;
+    }
+    unsigned level = 0;
+    while (delta >> (WHEEL_LEVEL_BITS * (level + 1)))
+    {
+        ++level;
+    }
+    unsigned slot =
+        (tick >> (WHEEL_LEVEL_BITS * level)) & (WHEEL_SLOTS - 1);
+    QMember **last = &wheel_[level][slot];
+    if (level == 0)
+    {
+        // The innermost slots are kept sorted, so that timers expire in the
+        // order of their deadlines, same as with the sorted list.
+        while (*last && static_cast<Timer *>(*last)->when_ <= timer->when_)
+        {
+            last = &(*last)->next;
+        }
+    }
+    timer->next = *last;
+    if (*last)
+    {
+        static_cast<Timer *>(*last)->pprev_ = &timer->next;
+    }
+    timer->pprev_ = last;
+    *last = timer;
+    wheelOccupied_[level] |= 1ULL << slot;
+}
+
+void ActiveTimers::wheel_remove_locked(Timer *timer)
+{
+    HASSERT(timer->pprev_ && *timer->pprev_ == timer);
+    QMember **pprev = timer->pprev_;
+    *pprev = timer->next;
+    if (timer->next)
+    {
+        static_cast<Timer *>(timer->next)->pprev_ = pprev;
+    }
+    timer->next = nullptr;
+    timer->pprev_ = nullptr;
+    --wheelSize_;
+    QMember **first = &wheel_[0][0];
+    if (!*pprev && pprev >= first && pprev < first + WHEEL_LEVELS * WHEEL_SLOTS)
+    {
+        // The slot became empty.
+        unsigned idx = pprev - first;
+        wheelOccupied_[idx / WHEEL_SLOTS] &= ~(1ULL << (idx % WHEEL_SLOTS));
+    }
+}
+
+bool ActiveTimers::wheel_expire_current(long long now)
+{
+    bool found_timer = false;
+    QMember *current = wheel_[0][wheelTick_ & (WHEEL_SLOTS - 1)];
+    while (current)
+    {
+        Timer *timer = static_cast<Timer *>(current);
+        current = current->next;
+        if (timer->when_ <= now)
+        {
+            expire_locked(timer);
+            found_timer = true;
+        }
+    }
+    return found_timer;
+}
+
+void ActiveTimers::wheel_cascade()
+{
+    // Outer levels first, because they may put timers into the inner slots
+    // that start at the current tick.
+    for (unsigned level = WHEEL_LEVELS - 1; level > 0; --level)
+    {
+        unsigned shift = WHEEL_LEVEL_BITS * level;
+        if (wheelTick_ & ((1LL << shift) - 1))
+        {
+            continue;
+        }
+        unsigned slot = (wheelTick_ >> shift) & (WHEEL_SLOTS - 1);
+        QMember *current = wheel_[level][slot];
+        wheel_[level][slot] = nullptr;
+        wheelOccupied_[level] &= ~(1ULL << slot);
+        while (current)
+        {
+            Timer *timer = static_cast<Timer *>(current);
+            current = current->next;
+            timer->next = nullptr;
+            --wheelSize_;
+            wheel_insert_locked(timer);
+        }
+    }
+}
+
+long long ActiveTimers::wheel_next_event()
+{
+    long long ret = INT64_MAX;
+    for (unsigned level = 0; level < WHEEL_LEVELS; ++level)
+    {
+        unsigned shift = WHEEL_LEVEL_BITS * level;
+        long long base = wheelTick_ >> shift;
+        unsigned d = next_set_bit(
+            wheelOccupied_[level], base & (WHEEL_SLOTS - 1));
+        if (d)
+        {
+            ret = std::min(ret, (base + d) << shift);
+        }
+    }
+    return ret;
+}
+
+long long ActiveTimers::wheel_next_timeout_locked()
+{
+    long long now = OSTime::get_monotonic();
+    long long now_tick = now >> WHEEL_TICK_SHIFT;
+    bool found_timer = false;
+    while (true)
+    {
+        found_timer |= wheel_expire_current(now);
+        if (wheelTick_ >= now_tick)
+        {
+            break;
+        }
+        // All slots before the next event are empty.
+        wheelTick_ = std::min(wheel_next_event(), now_tick);
+        wheel_cascade();
+    }
+
+    if (found_timer)
+    {
+        return 0;
+    }
+    if (!wheelSize_)
+    {
+        // Wakes up the timer service every now and then. It won't make any
+        // difference.
+        return SEC_TO_NSEC(3600);
+    }
+    // Timers left in the current slot are due later within the current tick.
+    QMember *current = wheel_[0][wheelTick_ & (WHEEL_SLOTS - 1)];
+    long long next = INT64_MAX;
+    if (!current)
+    {
+        long long tick = wheel_next_event();
+        if (tick & (WHEEL_SLOTS - 1))
+        {
+            current = wheel_[0][tick & (WHEEL_SLOTS - 1)];
+        }
+        else
+        {
+            // There may be a cascade at this tick. We wake up when it starts.
+            next = tick << WHEEL_TICK_SHIFT;
+        }
+    }
+    for (; current; current = current->next)
+    {
+        next = std::min(next, static_cast<Timer *>(current)->when_);
+    }
+    return next - now;
+}
+
+#endif // OPENMRN_FEATURE_TIMER_WHEEL
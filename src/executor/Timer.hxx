@@ -35,6 +35,7 @@
 #ifndef _EXECUTOR_TIMER_HXX_
 #define _EXECUTOR_TIMER_HXX_
 
+#include "openmrn_features.h"
 #include "executor/Notifiable.hxx"
 #include "utils/Buffer.hxx"
 #include "utils/QMember.hxx"
@@ -44,17 +45,43 @@ class Timer;
 class ExecutorBase;
 
 /** Class that manages the list of active timers. The Executor uses this class
- * tightly in its sleep-execute loop. */
+ * tightly in its sleep-execute loop.
+ *
+ * There are two data structures available to store the scheduled timers. The
+ * sorted list is small, but inserting or removing a timer takes time linear
+ * in the number of active timers. The hierarchical timer wheel (available
+ * when OPENMRN_FEATURE_TIMER_WHEEL is set) takes constant time for these
+ * operations, but needs WHEEL_LEVELS * WHEEL_SLOTS = 256 list heads, plus
+ * 32 bytes of occupancy bits, of RAM for every executor. That is about 1 KB
+ * with 32-bit pointers and 2 KB with 64-bit pointers. */
 class ActiveTimers : public Executable
 {
 public:
+    /// Data structures for storing the scheduled timers.
+    enum Backend
+    {
+        /// Singly linked list sorted by expiration time.
+        SORTED_LIST,
+        /// Hierarchical timer wheel.
+        TIMER_WHEEL,
+#if OPENMRN_FEATURE_TIMER_WHEEL
+        /// Backend used when nothing else is specified.
+        DEFAULT_BACKEND = TIMER_WHEEL
+#else
+        /// Backend used when nothing else is specified.
+        DEFAULT_BACKEND = SORTED_LIST
+#endif
+    };
+
     /// Constructor.
     ///
     /// @param executor parent that will use this instance.
-    ActiveTimers(ExecutorBase *executor)
+    /// @param backend which data structure to use for storing the timers.
+    ActiveTimers(ExecutorBase *executor, Backend backend = DEFAULT_BACKEND)
         : executor_(executor)
         , isPending_(0)
     {
+        set_backend(backend);
     }
 
     ~ActiveTimers();
@@ -67,6 +94,12 @@ public:
 
     /** @return true if there are no timers waiting. */
     bool empty();
+
+    /** Changes the data structure used for storing the timers. May only be
+     * called when there are no timers waiting.
+     * @param backend the data structure to use from now on. TIMER_WHEEL is
+     * only available when OPENMRN_FEATURE_TIMER_WHEEL is set. */
+    void set_backend(Backend backend);
     
     /** Adds a new timer to the active timer list. It is OK to schedule a timer
      * that is already expired, which will then wake up the executor.
@@ -76,16 +109,17 @@ public:
     void schedule_timer(::Timer *timer);
 
     /** Updates the expiration time of an already scheduled timer. This call is
-     * somewhat expensive, because it needs to walk the entire queue of active
-     * timers. May wake up the executor.
+     * somewhat expensive with the sorted list backend, because it needs to
+     * walk the entire queue of active timers. May wake up the executor.
      *
      * @param timer is the timer whose next execution time has been updated. It
      * must already be scheduled. */
     void update_timer(::Timer *timer);
 
     /** Deletes an already scheduled but not yet expired timer. This call is
-     * somewhat expensive, because it needs to walk the entire queue of active
-     * timers. Asserts that the timer is in fact not yet expired.
+     * somewhat expensive with the sorted list backend, because it needs to
+     * walk the entire queue of active timers. Asserts that the timer is in
+     * fact not yet expired.
      *
      * @param timer is the timer to delete. */
     void remove_timer(::Timer *timer);
@@ -113,14 +147,70 @@ private:
      * @param timer what to insert into the active list. */
     void insert_locked(::Timer *timer);
 
+    /** Removes a timer from the active list, and hands it to the executor.
+     * Caller must hold the lock.
+     * @param timer what to expire. */
+    void expire_locked(::Timer *timer);
+
+#if OPENMRN_FEATURE_TIMER_WHEEL
+    /// How many bits of the nanosecond time are below the resolution of the
+    /// timer wheel. One tick is about a millisecond.
+    static constexpr unsigned WHEEL_TICK_SHIFT = 20;
+    /// Number of bits of the tick count handled by one level of the wheel.
+    static constexpr unsigned WHEEL_LEVEL_BITS = 6;
+    /// Number of slots in each level of the wheel.
+    static constexpr unsigned WHEEL_SLOTS = 1u << WHEEL_LEVEL_BITS;
+    /// Number of levels in the wheel. Timers farther in the future than
+    /// WHEEL_SLOTS ^ WHEEL_LEVELS ticks (about 4.9 hours) are put on the last
+    /// slot of the outermost level and will be cascaded again.
+    static constexpr unsigned WHEEL_LEVELS = 4;
+
+    /// Implementation of get_next_timeout() for the timer wheel. Caller must
+    /// hold the lock. @return nanoseconds until the next timer expires.
+    long long wheel_next_timeout_locked();
+
+    /// Inserts a timer into the wheel. Caller must hold the lock. @param
+    /// timer what to insert.
+    void wheel_insert_locked(::Timer *timer);
+
+    /// Removes a timer from the wheel. Caller must hold the lock. @param
+    /// timer what to remove.
+    void wheel_remove_locked(::Timer *timer);
+
+    /// Expires the timers of the innermost slot at wheelTick_ whose deadline
+    /// is not after now. @param now current time in nanoseconds. @return
+    /// true if at least one timer was expired.
+    bool wheel_expire_current(long long now);
+
+    /// Moves the timers from the outer slots that start at wheelTick_ to the
+    /// inner levels.
+    void wheel_cascade();
+
+    /// @return the first tick after wheelTick_ at which a slot of the wheel
+    /// has to be looked at, or INT64_MAX if the wheel is empty.
+    long long wheel_next_event();
+
+    /// Heads of the linked list of timers in each slot of the wheel.
+    QMember *wheel_[WHEEL_LEVELS][WHEEL_SLOTS] = {};
+    /// One bit for each non-empty slot of the wheel.
+    uint64_t wheelOccupied_[WHEEL_LEVELS] = {};
+    /// Tick (time >> WHEEL_TICK_SHIFT) up to which the wheel has been
+    /// processed.
+    long long wheelTick_ {0};
+    /// Number of timers in the wheel.
+    unsigned wheelSize_ {0};
+#endif
+
     /// Parent.
     ExecutorBase *executor_;
     /// Protects the timer list.
     OSMutex lock_;
-    /// List of timers that are scheduled.
+    /// List of timers that are scheduled (sorted list backend).
     QMember activeTimers_;
     /// 1 if we in the executor's queue.
     std::atomic_uint_least8_t isPending_;
+    /// Which data structure holds the timers.
+    Backend backend_;
 
     friend class TimerTest;
 
@@ -312,6 +402,11 @@ private:
     unsigned isCancelled_ : 1;
     /** For children: 1 if a repeated timer should stop sending wakeups. */
     unsigned tcRequestStop_ : 1;
+#if OPENMRN_FEATURE_TIMER_WHEEL
+    /** Points to the link that points to this timer, if this timer is in the
+     * timer wheel. */
+    QMember **pprev_ {nullptr};
+#endif
 
     DISALLOW_COPY_AND_ASSIGN(Timer);
 };
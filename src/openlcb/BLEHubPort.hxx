@@ -424,7 +424,7 @@ protected:
             wait_and_call(STATE(send_callback));
             inlineCall_ = 1;
             sendComplete_ = 0;
-            hub_->enqueue_send(this); // causes the callback
+            hub_->enqueue_send(this, parent_); // causes the callback
             inlineCall_ = 0;
             if (sendComplete_)
             {
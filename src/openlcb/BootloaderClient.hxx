@@ -38,6 +38,7 @@
 #include "openlcb/DatagramDefs.hxx"
 #include "openlcb/FirmwareUpgradeDefs.hxx"
 #include "openlcb/StreamDefs.hxx"
+#include "openlcb/StreamWindow.hxx"
 #include "openlcb/PIPClient.hxx"
 #include "openlcb/CanDefs.hxx"
 #include "openlcb/MemoryConfig.hxx"
@@ -111,6 +112,12 @@ public:
     {
     }
 
+    /// @return transfer statistics of the last stream write.
+    const StreamWindow::Stats &get_stream_stats()
+    {
+        return window_.stats();
+    }
+
     Action entry() override
     {
         return allocate_and_call(
@@ -412,7 +419,7 @@ private:
         b->data()->reset(Defs::MTI_STREAM_INITIATE_REQUEST, node_->node_id(),
             message()->data()->dst,
             StreamDefs::create_initiate_request(
-                             StreamDefs::MAX_PAYLOAD, false, localStreamId_));
+                             window_.proposed_window(), false, localStreamId_));
         node_->iface()->addressed_message_write_flow()->send(b);
         sleeping_ = true;
         node_->iface()->dispatcher()->register_handler(
@@ -476,11 +483,8 @@ private:
                 "Inconsistency: zero buffer length but "
                 "accepted stream request.");
         }
-        availableBufferSize_ = maxBufferSize_;
+        window_.start(maxBufferSize_);
         bufferOffset_ = 0;
-        speed_ = 0;
-        lastMeasurementOffset_ = 0;
-        lastMeasurementTimeNsec_ = os_get_time_monotonic();
         node_->iface()->dispatcher()->register_handler(
             &streamProceedHandler_, Defs::MTI_STREAM_PROCEED, Defs::MTI_EXACT);
         return call_immediately(STATE(send_stream_data));
@@ -509,20 +513,19 @@ private:
         SET_CAN_FRAME_ID_EFF(*frame, can_id);
         size_t len =
             std::min(size_t(7), message()->data()->data.size() - bufferOffset_);
-        if (availableBufferSize_ < len)
+        if (window_.credit() < len)
         {
-            len = availableBufferSize_;
+            len = window_.credit();
         }
         frame->can_dlc = len + 1;
         frame->data[0] = remoteStreamId_;
         memcpy(&frame->data[1], &message()->data()->data[bufferOffset_], len);
         bufferOffset_ += len;
-        availableBufferSize_ -= len;
-        // LOG(INFO, "available buffer: %d", availableBufferSize_);
+        window_.sent(len);
         b->set_done(n_.reset(this));
         ifCan_->frame_write_flow()->send(b);
 
-        if (availableBufferSize_)
+        if (window_.credit())
         {
             return wait_and_call(STATE(send_stream_data));
         }
@@ -534,13 +537,12 @@ private:
 
     Action wait_for_stream_proceed()
     {
-        if (availableBufferSize_)
+        if (window_.credit())
         {
             // received early stream_proceed response
             return call_immediately(STATE(stream_proceed_timeout));
         }
         sleeping_ = true;
-        sleepStartTimeNsec_ = os_get_time_monotonic();
         return sleep_and_call(&timer_, SEC_TO_NSEC(g_bootloader_timeout_sec),
             STATE(stream_proceed_timeout));
     }
@@ -553,42 +555,25 @@ private:
             // Not for me.
             return message->unref();
         }
-        size_t bytes_sent = bufferOffset_ - lastMeasurementOffset_;
-        long long next_time = os_get_time_monotonic();
-        float new_speed = next_time - lastMeasurementTimeNsec_;
-        new_speed = float(bytes_sent) * 1e9 / new_speed;
-        if (!lastMeasurementOffset_)
-        {
-            speed_ = new_speed;
-        }
-        else
+        const auto &payload = message->data()->payload;
+        if (payload.size() < 2 || payload[0] != localStreamId_)
         {
-            speed_ = speed_ * 0.8 + new_speed * 0.2;
+            // Talking about another stream or incorrect data.
+            return message->unref();
         }
-        struct timespec ts;
-        clock_gettime(CLOCK_REALTIME, &ts);
+        window_.proceed();
         if (request()->progress_callback)
         {
             float ofs = bufferOffset_;
             ofs /= request()->data.size();
             request()->progress_callback(ofs);
         }
+        const auto &stats = window_.stats();
         LOG(INFO,
-            "%02ld.%06ld stream offset: %" PRIdPTR "; wrote %.0lld usec slept "
-            "%.0lld usec, speed=%.0f bytes/sec",
-            ts.tv_sec % 60, ts.tv_nsec / 1000, bufferOffset_,
-            (sleepStartTimeNsec_ - lastMeasurementTimeNsec_) / 1000,
-            (next_time - sleepStartTimeNsec_) / 1000, speed_);
-        lastMeasurementOffset_ = bufferOffset_;
-        lastMeasurementTimeNsec_ = next_time;
-
-        const auto &payload = message->data()->payload;
-        if (payload.size() < 2 || payload[0] != localStreamId_)
-        {
-            // Talking about another stream or incorrect data.
-            return message->unref();
-        }
-        availableBufferSize_ += maxBufferSize_;
+            "stream offset: %" PRIdPTR "; slept %lld usec, "
+            "speed=%.0f bytes/sec",
+            bufferOffset_, stats.lastStallNsec / 1000,
+            stats.recentBytesPerSec);
         message->unref();
         if (sleeping_)
         {
@@ -599,8 +584,9 @@ private:
     Action stream_proceed_timeout()
     {
         sleeping_ = false;
-        if (!availableBufferSize_) // no proceed arrived
+        if (!window_.credit()) // no proceed arrived
         {
+            window_.timeout();
             ///@TODO(balazs.racz) somehow merge these two actions: remember
             /// that we timed out and close the stream.
             return return_error(Defs::ERROR_TEMPORARY,
@@ -612,6 +598,10 @@ private:
 
     Action close_stream()
     {
+        const auto &stats = window_.stats();
+        LOG(INFO, "stream done: %u bytes, %u bytes/sec, stalled %lld msec",
+            (unsigned)stats.bytes, (unsigned)stats.bytes_per_sec(),
+            stats.stallNsec / 1000000);
         node_->iface()->dispatcher()->unregister_handler(
             &streamProceedHandler_, Defs::MTI_STREAM_PROCEED, Defs::MTI_EXACT);
         return allocate_and_call(
@@ -780,22 +770,14 @@ private:
     // Additional flags from the initiate response.
     uint8_t streamAdditionalFlags_;
 
-    // How many bytes can we send before needing to wait for stream data
-    // proceed message.
-    uint32_t availableBufferSize_;
     // The next byte we need to send from the input data.
     size_t bufferOffset_;
 
     Ewma speedAvg_;
-    // The Average speed (ewma) in bytes/second.
-    float speed_;
-    // The offset at which the last speed measurement took place.
-    size_t lastMeasurementOffset_;
-    // The time in nsec at which the last speed measurement took place.
-    long long lastMeasurementTimeNsec_;
-    // Snapshots the time at which we start to sleep to wait for a stream
-    // proceed flag.
-    long long sleepStartTimeNsec_;
+    // Send credit, window size adaptation and transfer statistics. Lives
+    // across streams, so that the next transfer proposes a window size
+    // learned from this one.
+    StreamWindow window_;
 
     WriteResponseHandler writeResponseHandler_{this};
     bool writeResponseRegistered_ = false;
@@ -56,10 +56,15 @@ public:
     Action entry() override
     {
         startTime_ = os_get_time_monotonic();
+        nextSendTime_ = startTime_;
         pendingAliasesByTime_.clear();
         pendingAliasesByKey_.clear();
         nextToStampTime_ = 0;
         nextToClaim_ = 0;
+        if (request()->mode_ == BulkAliasRequest::FILL_POOL)
+        {
+            request()->numAliases_ = pool_deficit(request()->numAliases_);
+        }
         if_can()->frame_dispatcher()->register_handler(&conflictHandler_, 0, 0);
         return call_immediately(STATE(send_cid_frames));
     }
@@ -67,12 +72,12 @@ public:
     /// Picks a bunch of random aliases, sends CID frames for them to the bus.
     Action send_cid_frames()
     {
-        unsigned needed = std::min(request()->numAliases_,
-            (unsigned)(config_bulk_alias_num_can_frames() + 3) / 4);
+        unsigned needed = num_cid_to_send();
         if (!needed)
         {
             return call_immediately(STATE(wait_for_results));
         }
+        consume_pacing(needed * 4);
         bn_.reset(this);
         for (unsigned i = 0; i < needed; ++i)
         {
@@ -108,22 +113,26 @@ public:
     /// elapsed, then waits a bit and tries again.
     Action wait_for_results()
     {
-        if (nextToClaim_ == pendingAliasesByTime_.size())
+        if (nextToClaim_ == pendingAliasesByTime_.size() &&
+            !request()->numAliases_)
         {
             return complete();
         }
-        if (request()->numAliases_)
+        if (num_cid_to_send())
         {
-            // Some conflicts were identified, go and allocate more.
+            // There is room in the window for more aliases, or some
+            // conflicts were identified; go and allocate more.
             return call_immediately(STATE(send_cid_frames));
         }
-        auto ctime = relative_time();
+        uint8_t ctime = relative_time();
         unsigned num_sent = 0;
         bn_.reset(this);
-        while ((nextToClaim_ < pendingAliasesByTime_.size()) &&
+        // The timestamps are 8 bits, so we compare them modulo 256. An alias
+        // never waits that long in the pipeline.
+        while ((nextToClaim_ < nextToStampTime_) &&
             (num_sent < (unsigned)(config_bulk_alias_num_can_frames())) &&
-            (pendingAliasesByTime_[nextToClaim_].cidTime_ + ALLOCATE_DELAY <
-                ctime))
+            (uint8_t(ctime - pendingAliasesByTime_[nextToClaim_].cidTime_) >
+                ALLOCATE_DELAY))
         {
             NodeAlias a =
                 (NodeAlias)(pendingAliasesByTime_[nextToClaim_].alias_);
@@ -138,6 +147,7 @@ public:
             ++num_sent;
             send_can_frame(a, CanDefs::RID_FRAME, 0);
         }
+        consume_pacing(num_sent);
         if (bn_.abort_if_almost_done())
         {
             // no frame sent
@@ -212,6 +222,71 @@ private:
         return (os_get_time_monotonic() - startTime_) / MSEC_TO_NSEC(10);
     }
 
+    /// @return how many new aliases we may start the CID sequence for right
+    /// now, taking into account the window and the pacing rate.
+    unsigned num_cid_to_send()
+    {
+        unsigned needed = std::min(request()->numAliases_,
+            (unsigned)(config_bulk_alias_num_can_frames() + 3) / 4);
+        if (request()->window_)
+        {
+            unsigned in_flight = pendingAliasesByTime_.size() - nextToClaim_;
+            if (in_flight >= request()->window_)
+            {
+                return 0;
+            }
+            needed = std::min(needed, request()->window_ - in_flight);
+        }
+        if (request()->framesPerSec_ &&
+            nextSendTime_ > os_get_time_monotonic())
+        {
+            return 0;
+        }
+        return needed;
+    }
+
+    /// Accounts for frames sent in the pacing rate.
+    /// @param num_frames how many frames are being sent.
+    void consume_pacing(unsigned num_frames)
+    {
+        if (!request()->framesPerSec_ || !num_frames)
+        {
+            return;
+        }
+        nextSendTime_ = std::max(nextSendTime_, os_get_time_monotonic()) +
+            SEC_TO_NSEC(num_frames) / request()->framesPerSec_;
+    }
+
+    /// Computes how many aliases need to be allocated to fill the pool of
+    /// reserved aliases.
+    /// @param expected_nodes how many virtual nodes will need an alias.
+    /// @return how many new aliases to allocate.
+    unsigned pool_deficit(unsigned expected_nodes)
+    {
+        unsigned reserved =
+            if_can()->alias_allocator()->num_reserved_aliases();
+        if (reserved >= expected_nodes)
+        {
+            return 0;
+        }
+        unsigned used = 0;
+        if_can()->local_aliases()->for_each(
+            [](void *ctx, NodeID, NodeAlias) { ++*(unsigned *)ctx; }, &used);
+        unsigned space = if_can()->local_aliases()->size() - used;
+        unsigned needed = expected_nodes - reserved;
+        if (needed > space)
+        {
+            // More aliases would evict entries of the local alias cache,
+            // including the aliases of live nodes.
+            LOG(WARNING,
+                "Bulk alias allocator: local alias cache has space for %u "
+                "aliases, wanted %u.",
+                space, needed);
+            needed = space;
+        }
+        return needed;
+    }
+
     /// We store this type in the time-ordered aliases structure.
     struct PendingAliasInfo
     {
@@ -264,6 +339,8 @@ private:
     BarrierNotifiable bn_;
     /// We measure time elapsed relative to this point.
     long long startTime_;
+    /// Pacing: when we may send the next batch of frames.
+    long long nextSendTime_;
     /// Stores the aliases we are trying to allocate in time order of picking
     /// them.
     std::vector<PendingAliasInfo> pendingAliasesByTime_;
@@ -41,17 +41,51 @@ namespace openlcb
 {
 
 /// Message type to request allocating many aliases for an interface.
+///
+/// The allocator runs the CID/RID sequences of many aliases in a pipeline:
+/// CID frames for new aliases go out while earlier aliases are still waiting
+/// out their 200 msec collision window. The reserved aliases end up in the
+/// local alias cache, where AliasAllocator::get_allocated_alias() hands them
+/// to new virtual nodes without any delay.
 struct BulkAliasRequest : CallableFlowRequestBase
 {
-    /// @param count how many aliases to allocate.
-    void reset(unsigned count)
+    /// Selects how the count in the request is interpreted.
+    enum Mode
+    {
+        /// Allocate count new aliases.
+        ALLOCATE,
+        /// Count is the number of virtual nodes that are expected to be
+        /// created. Allocate as many aliases as are missing from the pool of
+        /// reserved aliases for them. The pool is limited by the free space
+        /// in the local alias cache.
+        FILL_POOL
+    };
+
+    /// @param count how many aliases to allocate (see mode).
+    /// @param mode how to interpret count.
+    /// @param window maximum number of aliases that have their CID frames
+    /// sent out but are not yet reserved. 0 for no limit.
+    /// @param frames_per_sec pacing rate for the outgoing CID and RID
+    /// frames. 0 to only wait for the frames to leave the device.
+    void reset(unsigned count, Mode mode = ALLOCATE,
+        unsigned window = config_bulk_alias_window(),
+        unsigned frames_per_sec = config_bulk_alias_frames_per_sec())
     {
         reset_base();
         numAliases_ = count;
+        mode_ = mode;
+        window_ = window;
+        framesPerSec_ = frames_per_sec;
     }
 
     /// How many aliases to allocate.
     unsigned numAliases_;
+    /// How to interpret numAliases_.
+    Mode mode_;
+    /// Maximum number of aliases in flight, 0 for unlimited.
+    unsigned window_;
+    /// Pacing rate of the outgoing frames, 0 for no pacing.
+    unsigned framesPerSec_;
 };
 
 using BulkAliasAllocatorInterface = FlowInterface<Buffer<BulkAliasRequest>>;
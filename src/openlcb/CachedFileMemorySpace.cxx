@@ -0,0 +1,291 @@
+/** \copyright
+ * Copyright (c) 2026, agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are  permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file CachedFileMemorySpace.cxx
+ * File memory space with a write-back cache of the file contents.
+ *
+ * @author agent
+ * @date 17 Oct 2026
+ */
+
+#include "openlcb/CachedFileMemorySpace.hxx"
+
+#include <unistd.h>
+
+namespace openlcb
+{
+
+constexpr unsigned CachedFileMemorySpace::BLOCK_SIZE;
+
+CachedFileMemorySpace::CachedFileMemorySpace(
+    int fd, address_t len, Service *service, long long idle_delay)
+    : FileMemorySpace(fd, len)
+    , idleDelay_(idle_delay)
+{
+    if (service)
+    {
+        idleTimer_.reset(new IdleTimer(this, service));
+    }
+}
+
+CachedFileMemorySpace::CachedFileMemorySpace(
+    const char *name, address_t len, Service *service, long long idle_delay)
+    : FileMemorySpace(name, len)
+    , idleDelay_(idle_delay)
+{
+    if (service)
+    {
+        idleTimer_.reset(new IdleTimer(this, service));
+    }
+}
+
+CachedFileMemorySpace::~CachedFileMemorySpace()
+{
+    sync();
+    if (timerRunning_)
+    {
+        // The scheduled timer deletes itself when it expires.
+        idleTimer_->parent_ = nullptr;
+        idleTimer_.release();
+    }
+}
+
+long long CachedFileMemorySpace::IdleTimer::timeout()
+{
+    if (!parent_)
+    {
+        // The memory space was destroyed.
+        return DELETE;
+    }
+    long long idle = os_get_time_monotonic() - parent_->lastWrite_;
+    if (idle < parent_->idleDelay_)
+    {
+        // There were writes since the timer was started.
+        return parent_->idleDelay_ - idle;
+    }
+    parent_->timerRunning_ = false;
+    parent_->sync();
+    return NONE;
+}
+
+bool CachedFileMemorySpace::ensure_cache()
+{
+    if (!data_.empty())
+    {
+        return true;
+    }
+    ensure_file_open();
+    if (fd_ < 0 || fileSize_ == UNLIMITED_LEN || fileSize_ == 0)
+    {
+        return false;
+    }
+    struct stat buf;
+    if (fstat(fd_, &buf) < 0)
+    {
+        return false;
+    }
+    fileEnd_ = std::min((address_t)buf.st_size, fileSize_);
+    data_.resize(fileSize_);
+    blockState_.resize((fileSize_ + BLOCK_SIZE - 1) / BLOCK_SIZE, MISSING);
+    return true;
+}
+
+CachedFileMemorySpace::errorcode_t CachedFileMemorySpace::load(
+    address_t begin, address_t end)
+{
+    unsigned b = begin / BLOCK_SIZE;
+    unsigned b_end = (end + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    while (b < b_end)
+    {
+        if (blockState_[b] != MISSING)
+        {
+            ++b;
+            continue;
+        }
+        // Reads the entire run of missing blocks with one call.
+        unsigned run_end = b + 1;
+        while (run_end < b_end && blockState_[run_end] == MISSING)
+        {
+            ++run_end;
+        }
+        address_t ofs = b * BLOCK_SIZE;
+        address_t len =
+            std::min((address_t)(run_end * BLOCK_SIZE), fileSize_) - ofs;
+        // Above the end of the file there is nothing to read.
+        address_t rd_len = ofs < fileEnd_ ? std::min(len, fileEnd_ - ofs) : 0;
+        ssize_t ret = 0;
+        if (rd_len)
+        {
+            ++numFileReads_;
+            ret = ::pread(fd_, &data_[ofs], rd_len, ofs);
+            if (ret < 0)
+            {
+                LOG(INFO, "Error reading from fd %d: %s", fd_,
+                    strerror(errno));
+                return Defs::ERROR_PERMANENT;
+            }
+        }
+        memset(&data_[ofs + ret], 0, len - ret);
+        for (unsigned i = b; i < run_end; ++i)
+        {
+            blockState_[i] = CLEAN;
+        }
+        b = run_end;
+    }
+    return 0;
+}
+
+size_t CachedFileMemorySpace::read(address_t source, uint8_t *dst, size_t len,
+    errorcode_t *error, Notifiable *again)
+{
+    if (!ensure_cache())
+    {
+        return FileMemorySpace::read(source, dst, len, error, again);
+    }
+    if (source >= fileEnd_)
+    {
+        *error = MemoryConfigDefs::ERROR_OUT_OF_BOUNDS;
+        return 0;
+    }
+    if (source + len > fileEnd_)
+    {
+        len = fileEnd_ - source;
+    }
+    errorcode_t err = load(source, source + len);
+    if (err)
+    {
+        *error = err;
+        return 0;
+    }
+    memcpy(dst, &data_[source], len);
+    return len;
+}
+
+size_t CachedFileMemorySpace::write(address_t destination,
+    const uint8_t *data, size_t len, errorcode_t *error, Notifiable *again)
+{
+    if (!ensure_cache())
+    {
+        return FileMemorySpace::write(destination, data, len, error, again);
+    }
+    if (destination >= fileSize_)
+    {
+        *error = MemoryConfigDefs::ERROR_OUT_OF_BOUNDS;
+        return 0;
+    }
+    if (destination + len > fileSize_)
+    {
+        len = fileSize_ - destination;
+    }
+    address_t end = destination + len;
+    // Partially written blocks need their other bytes from the file.
+    errorcode_t err = 0;
+    if (destination % BLOCK_SIZE)
+    {
+        err = load(destination, destination + 1);
+    }
+    if (!err && end % BLOCK_SIZE && end < fileSize_)
+    {
+        err = load(end - 1, end);
+    }
+    if (err)
+    {
+        *error = err;
+        return 0;
+    }
+    memcpy(&data_[destination], data, len);
+    for (address_t b = destination / BLOCK_SIZE; b * BLOCK_SIZE < end; ++b)
+    {
+        blockState_[b] = DIRTY;
+    }
+    fileEnd_ = std::max(fileEnd_, end);
+    if (idleTimer_)
+    {
+        lastWrite_ = os_get_time_monotonic();
+        if (!timerRunning_)
+        {
+            timerRunning_ = true;
+            idleTimer_->start(idleDelay_);
+        }
+    }
+    return len;
+}
+
+CachedFileMemorySpace::errorcode_t CachedFileMemorySpace::sync()
+{
+    for (unsigned b = 0; b < blockState_.size(); ++b)
+    {
+        if (blockState_[b] != DIRTY)
+        {
+            continue;
+        }
+        unsigned run_end = b + 1;
+        while (run_end < blockState_.size() && blockState_[run_end] == DIRTY)
+        {
+            ++run_end;
+        }
+        // Dirty blocks are fully loaded, so writing the entire run is
+        // correct. Does not extend the file beyond what was written.
+        address_t ofs = b * BLOCK_SIZE;
+        address_t len =
+            std::min((address_t)(run_end * BLOCK_SIZE), fileEnd_) - ofs;
+        ++numFileWrites_;
+        ssize_t ret = ::pwrite(fd_, &data_[ofs], len, ofs);
+        if (ret < (ssize_t)len)
+        {
+            LOG(INFO, "Error writing to fd %d: %s", fd_, strerror(errno));
+            return Defs::ERROR_PERMANENT;
+        }
+        for (unsigned i = b; i < run_end; ++i)
+        {
+            blockState_[i] = CLEAN;
+        }
+        b = run_end;
+    }
+    return 0;
+}
+
+void CachedFileMemorySpace::invalidate()
+{
+    for (auto &st : blockState_)
+    {
+        if (st == CLEAN)
+        {
+            st = MISSING;
+        }
+    }
+    if (!data_.empty())
+    {
+        struct stat buf;
+        if (fstat(fd_, &buf) == 0)
+        {
+            fileEnd_ = std::max(fileEnd_,
+                std::min((address_t)buf.st_size, fileSize_));
+        }
+    }
+}
+
+} // namespace openlcb
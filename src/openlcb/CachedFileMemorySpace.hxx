@@ -0,0 +1,196 @@
+/** \copyright
+ * Copyright (c) 2026, agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are  permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file CachedFileMemorySpace.hxx
+ * File memory space with a write-back cache of the file contents.
+ *
+ * @author agent
+ * @date 17 Oct 2026
+ */
+
+#ifndef _OPENLCB_CACHEDFILEMEMORYSPACE_HXX_
+#define _OPENLCB_CACHEDFILEMEMORYSPACE_HXX_
+
+#include <vector>
+
+#include "executor/Timer.hxx"
+#include "openlcb/MemoryConfig.hxx"
+
+namespace openlcb
+{
+
+/// Memory space implementation that exports the contents of a file, like
+/// FileMemorySpace, but keeps a copy of the file contents in RAM.
+///
+/// Reads are served from the copy. The file is read in blocks of BLOCK_SIZE
+/// bytes on the first access, coalescing adjacent missing blocks into a
+/// single pread. Writes only modify the copy and mark the touched blocks
+/// dirty. Runs of adjacent dirty blocks are written back to the file with a
+/// single pwrite each, when
+/// - sync() is called,
+/// - the ConfigUpdateFlow this cache is attached to (see
+///   ConfigUpdateFlow::set_file_cache()) calls the update listeners,
+/// - there were no writes for the idle delay, if a service was given.
+///
+/// Writes to the file that bypass this object (e.g. a factory reset done by
+/// the config update listeners) must be followed by a call to invalidate().
+///
+/// The RAM use is the size of the memory space, so this is meant for
+/// configuration files of hosts, e.g. Linux nodes booting from SD cards. The
+/// length must be known; with UNLIMITED_LEN the calls go to the file
+/// directly. All calls must come from the same executor (the one of the
+/// service given).
+class CachedFileMemorySpace : public FileMemorySpace
+{
+public:
+    /// Granularity of reading and dirty tracking.
+    static constexpr unsigned BLOCK_SIZE = 256;
+
+    /** Creates a memory space based on an fd.
+     *
+     * @param fd is an open file descriptor with the data.
+     * @param len tells how many bytes there are in the memory space. If
+     * specified as AUTO_LEN, then uses fstat to figure out the size of the
+     * file.
+     * @param service if not null, dirty data is written back on the executor
+     * of this service after there were no writes for idle_delay.
+     * @param idle_delay nanoseconds of no writes before writing back.
+     */
+    CachedFileMemorySpace(int fd, address_t len = AUTO_LEN,
+        Service *service = nullptr, long long idle_delay = SEC_TO_NSEC(1));
+
+    /** Creates a memory space based on a file name. Opens the file at the
+     * first use, and never closes it.
+     *
+     * @param name is the file name to open. The pointer must stay alive so
+     * long as *this is around.
+     * @param len tells how many bytes there are in the memory space. If
+     * specified as AUTO_LEN, then uses fstat to figure out the size of the
+     * file.
+     * @param service if not null, dirty data is written back on the executor
+     * of this service after there were no writes for idle_delay.
+     * @param idle_delay nanoseconds of no writes before writing back.
+     */
+    CachedFileMemorySpace(const char *name, address_t len = AUTO_LEN,
+        Service *service = nullptr, long long idle_delay = SEC_TO_NSEC(1));
+
+    /// Destructor. Writes back the dirty data. Must be called on the executor
+    /// of the service, or when that executor is not running anymore.
+    ~CachedFileMemorySpace();
+
+    size_t write(address_t destination, const uint8_t *data, size_t len,
+        errorcode_t *error, Notifiable *again) override;
+
+    size_t read(address_t source, uint8_t *dst, size_t len, errorcode_t *error,
+        Notifiable *again) override;
+
+    /// Writes all dirty data back to the file. Does not call fsync.
+    /// @return 0 on success, or an error code.
+    errorcode_t sync();
+
+    /// Drops the cached contents that are the same as in the file. Dirty
+    /// data is kept.
+    void invalidate();
+
+    /// @return the number of pread calls done so far.
+    unsigned num_file_reads()
+    {
+        return numFileReads_;
+    }
+
+    /// @return the number of pwrite calls done so far.
+    unsigned num_file_writes()
+    {
+        return numFileWrites_;
+    }
+
+private:
+    /// State of a cached block.
+    enum BlockState : uint8_t
+    {
+        /// Not read from the file yet.
+        MISSING = 0,
+        /// Same content as the file.
+        CLEAN,
+        /// Modified, needs to be written back.
+        DIRTY
+    };
+
+    /// Writes back dirty data when there were no writes for a while. If the
+    /// memory space is destroyed while the timer is scheduled, the timer
+    /// outlives it and deletes itself when it expires.
+    class IdleTimer : public ::Timer
+    {
+    public:
+        /// Constructor.
+        /// @param parent the memory space to write back.
+        /// @param service whose executor to run on.
+        IdleTimer(CachedFileMemorySpace *parent, Service *service)
+            : ::Timer(service->executor()->active_timers())
+            , parent_(parent)
+        {
+        }
+
+        long long timeout() override;
+
+        /// Memory space to write back, or nullptr if it was destroyed.
+        CachedFileMemorySpace *parent_;
+    };
+
+    /// Allocates the cache on the first use.
+    /// @return false if the cache cannot be used.
+    bool ensure_cache();
+
+    /// Reads all missing blocks in a range from the file.
+    /// @param begin first byte of the range.
+    /// @param end one past the last byte of the range.
+    /// @return 0 on success, or an error code.
+    errorcode_t load(address_t begin, address_t end);
+
+    /// Contents of the memory space.
+    std::vector<uint8_t> data_;
+    /// BlockState for each block of data_.
+    std::vector<uint8_t> blockState_;
+    /// Number of bytes that exist in the file or were written. Reads above
+    /// this return end of file, like the file does.
+    address_t fileEnd_ {0};
+    /// Nanoseconds of no writes before writing back.
+    long long idleDelay_;
+    /// When was the last write call.
+    long long lastWrite_ {0};
+    /// Timer for the idle write-back, null if none.
+    std::unique_ptr<IdleTimer> idleTimer_;
+    /// True if idleTimer_ is scheduled.
+    bool timerRunning_ {false};
+    /// Statistics: number of pread calls.
+    unsigned numFileReads_ {0};
+    /// Statistics: number of pwrite calls.
+    unsigned numFileWrites_ {0};
+};
+
+} // namespace openlcb
+
+#endif // _OPENLCB_CACHEDFILEMEMORYSPACE_HXX_
@@ -36,6 +36,7 @@
 #ifndef _OPENLCB_CANROUTNGHUB_HXX_
 #define _OPENLCB_CANROUTNGHUB_HXX_
 
+#include "nmranet_config.h"
 #include "openlcb/RoutingLogic.hxx"
 #include "openlcb/CanDefs.hxx"
 #include "openlcb/Defs.hxx"
@@ -62,9 +63,27 @@ public:
     typedef Buffer<value_type> buffer_type;
     typedef FlowInterface<buffer_type> port_type;
 
-    GcCanRoutingHub(Service *s)
+    /// Constructor. @param s service whose executor to run on. @param
+    /// max_age_sec the routes to node addresses that have not sent any frame
+    /// for this many seconds are forgotten. 0 disables aging.
+    GcCanRoutingHub(Service *s,
+        unsigned max_age_sec = config_routing_hub_address_max_age_sec())
         : deliveryFlow_(s, this)
     {
+        if (max_age_sec)
+        {
+            ageTimer_ = new AgingTimer(s, this, max_age_sec);
+        }
+    }
+
+    ~GcCanRoutingHub()
+    {
+        if (ageTimer_)
+        {
+            // The timer deletes itself when it next expires.
+            OSMutexLock l(&ageTimer_->lock_);
+            ageTimer_->parent_ = nullptr;
+        }
     }
 
     void send(Buffer<HubData> *b, unsigned priority = UINT_MAX) override
@@ -81,17 +100,18 @@ public:
             return;
         }
         const string &p = *b->data();
-        for (unsigned i = 0; i < p.size(); ++i)
+        const char *data = p.data();
+        size_t len = p.size();
+        struct can_frame frames[8];
+        while (len)
         {
-            if (it->second.segmenter_.consume_byte(p[i]))
+            unsigned num = it->second.segmenter_.consume_data(
+                &data, &len, frames, ARRAYSIZE(frames));
+            for (unsigned i = 0; i < num; ++i)
             {
                 // We have a frame.
-                string ret;
-                it->second.segmenter_.frame_buffer(&ret);
-                LOG(VERBOSE, "sending frame: %s", ret.c_str());
                 auto *cb = deliveryFlow_.alloc();
-                HASSERT(it->second.segmenter_.parse_frame_to_output(
-                    cb->data()->mutable_frame()));
+                *cb->data()->mutable_frame() = frames[i];
                 cb->data()->skipMember_ = reinterpret_cast<
                     FlowInterface<Buffer<HubContainer<CanFrameContainer>>> *>(
                     b->data()->skipMember_);
@@ -113,7 +133,10 @@ public:
     {
         OSMutexLock l(&lock_);
         HASSERT(port);
-        ports_[port].hubPort_ = port;
+        auto &p = ports_[port];
+        p.hubPort_ = port;
+        p.eventBit_ = routingTable_.port_bit(
+            reinterpret_cast<CanHubPortInterface *>(port));
     }
 
     void unregister_port(HubPortInterface *port)
@@ -132,6 +155,8 @@ public:
 private:
     class PortParser;
     typedef std::map<void *, PortParser> PortsMap;
+    /// Set of ports in the event routing decisions.
+    typedef RoutingLogic<CanHubPortInterface, NodeAlias>::PortMask PortMask;
     /**
        Computes the desired priority of a CAN frame.
 
@@ -166,6 +191,8 @@ private:
             for (void *p : parent_->pendingRemove_)
             {
                 parent_->ports_.erase(p);
+                parent_->routingTable_.remove_port(
+                    static_cast<CanHubPortInterface *>(p));
             }
             parent_->pendingRemove_.clear();
 
@@ -203,6 +230,11 @@ private:
                 }
             }
 
+            if (forwardType_ == EVENT)
+            {
+                eventPorts_ = parent_->routingTable_.lookup_pcer(event_);
+            }
+
             nextIt_ = parent_->ports_.begin();
 
             return call_immediately(STATE(try_next_entry));
@@ -322,9 +354,8 @@ private:
 
             if (forwardType_ == EVENT)
             {
-                if (parent_->routingTable_.check_pcer(
-                        static_cast<CanHubPortInterface *>(nextIt_->first),
-                        event_))
+                PortMask bit = nextIt_->second.eventBit_;
+                if (!bit || (eventPorts_ & bit))
                 {
                     forward_to_port();
                 }
@@ -406,6 +437,8 @@ private:
         NodeAlias srcAddress_;      //< for all OpenLCB frames
         NodeAlias dstAddress_;      //< for addressed frames
         EventId event_;             //< for PCER messages
+        /// for PCER messages: which ports have a consumer.
+        PortMask eventPorts_;
         PortsMap::iterator nextIt_; //< which port to consider next
         GcCanRoutingHub *parent_;
         /// Gridconnect-rendered frame.
@@ -416,6 +449,48 @@ private:
 
     friend class DeliveryFlow;
 
+    /// Periodically removes the node addresses that were not seen for a
+    /// while from the routing table. Allocated separately, because it may
+    /// outlive the hub.
+    class AgingTimer : public ::Timer
+    {
+    public:
+        /// @param s service whose executor to run on. @param parent owning
+        /// hub. @param max_age_sec maximum age of the addresses in seconds.
+        AgingTimer(Service *s, GcCanRoutingHub *parent, unsigned max_age_sec)
+            : ::Timer(s->executor()->active_timers())
+            , parent_(parent)
+            , maxAge_(max_age_sec)
+        {
+            // An address gets removed at most a quarter of its maximum age
+            // late.
+            start(SEC_TO_NSEC(std::max(1u, max_age_sec / 4)));
+        }
+
+        long long timeout() override
+        {
+            {
+                OSMutexLock l(&lock_);
+                if (parent_)
+                {
+                    parent_->routingTable_.age_addresses(maxAge_);
+                    return RESTART;
+                }
+            }
+            return DELETE;
+        }
+
+        /// Protects parent_.
+        OSMutex lock_;
+        /// Owning hub, or nullptr if it was destroyed.
+        GcCanRoutingHub *parent_;
+        /// Maximum age of the addresses in seconds.
+        unsigned maxAge_;
+    };
+
+    /// Timer for the address aging, or nullptr if aging is disabled.
+    AgingTimer *ageTimer_ {nullptr};
+
     /// Data and objects we keep for each port.
     struct PortParser
     {
@@ -425,6 +500,9 @@ private:
         GcStreamParser segmenter_;
         CanHubPortInterface *canPort_{nullptr};
         HubPortInterface *hubPort_{nullptr};
+        /// Bit of this port in the routing table's event masks. 0 if the
+        /// port gets all event reports.
+        PortMask eventBit_{0};
     };
     /// Keyed by the skipMember_ value of the incoming data from a given port.
     std::map<void *, PortParser> ports_;
@@ -35,6 +35,7 @@
  */
 
 #include "openlcb/ConfigUpdateFlow.hxx"
+#include "openlcb/CachedFileMemorySpace.hxx"
 #include <fcntl.h>
 
 namespace openlcb
@@ -56,6 +57,7 @@ void ConfigUpdateFlow::init_flow()
 
 void ConfigUpdateFlow::factory_reset()
 {
+    write_back_cache();
     for (auto it = listeners_.begin(); it != listeners_.end(); ++it) {
         it->factory_reset(fd_);
     }
@@ -64,6 +66,23 @@ void ConfigUpdateFlow::factory_reset()
     {
         it->factory_reset(fd_);
     }
+    invalidate_cache();
+}
+
+void ConfigUpdateFlow::write_back_cache()
+{
+    if (fileCache_)
+    {
+        fileCache_->sync();
+    }
+}
+
+void ConfigUpdateFlow::invalidate_cache()
+{
+    if (fileCache_)
+    {
+        fileCache_->invalidate();
+    }
 }
 
 void ConfigUpdateFlow::register_update_listener(ConfigUpdateListener *listener)
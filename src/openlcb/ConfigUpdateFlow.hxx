@@ -53,6 +53,8 @@ extern void reboot();
 namespace openlcb
 {
 
+class CachedFileMemorySpace;
+
 /// Implementation of the ConfigUpdateService: state flow issuing all the calls
 /// to the registered ConfigUpdateListener descendants. This flow also handles
 /// any necessary action such as reboot or factory reset. This flow keeps the
@@ -86,6 +88,16 @@ public:
         return fd_;
     }
 
+    /// Sets the memory space that caches the contents of the configuration
+    /// file. Its dirty data is written back before the listeners read the
+    /// file, and its clean data is dropped after the listeners (or a factory
+    /// reset) might have written the file.
+    /// @param cache memory space on the configuration file, or nullptr.
+    void set_file_cache(CachedFileMemorySpace *cache)
+    {
+        fileCache_ = cache;
+    }
+
 #ifdef GTEST
     void TEST_set_fd(int fd)
     {
@@ -142,6 +154,7 @@ private:
             DIE("CONFIG_FILENAME not specified, or init() was not called, but "
                 "there are configuration listeners.");
         }
+        write_back_cache();
         ConfigUpdateListener::UpdateAction action =
             l->apply_configuration(fd_, is_initial, n_.reset(this));
         switch (action)
@@ -184,6 +197,7 @@ private:
 
     Action apply_action()
     {
+        invalidate_cache();
         /// TODO(balazs.racz) apply the changes reported.
         if (needsReboot_)
         {
@@ -199,6 +213,11 @@ private:
         return exit();
     }
 
+    /// Writes back the dirty data of fileCache_, if any.
+    void write_back_cache();
+    /// Drops the clean data of fileCache_, if any.
+    void invalidate_cache();
+
     typedef TypedQueue<ConfigUpdateListener> queue_type;
     /// All registered update listeners. Protected by Atomic *this.
     queue_type listeners_;
@@ -212,6 +231,8 @@ private:
     /// did anybody request a node reinit to happen?
     unsigned needsReInit_ : 1;
     int fd_;
+    /// Memory space caching the contents of the file, or nullptr.
+    CachedFileMemorySpace *fileCache_ {nullptr};
     BarrierNotifiable n_;
 };
 
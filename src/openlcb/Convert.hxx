@@ -121,7 +121,7 @@ extern void buffer_to_error(const Payload &payload, uint16_t *error_code,
 extern Payload error_payload(uint16_t error_code, Defs::MTI incoming_mti);
 
 /** A global class / variable for empty or not-yet-initialized payloads. */
-extern string EMPTY_PAYLOAD;
+extern Payload EMPTY_PAYLOAD;
 
 /// @return the high 4 bytes of a node ID. @param id is the node ID.
 inline unsigned node_high(NodeID id)
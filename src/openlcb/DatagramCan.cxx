@@ -108,7 +108,7 @@ private:
             }
         }
 
-        memcpy(f->data, &nmsg()->payload[dataOffset_], len);
+        memcpy(f->data, nmsg()->payload.data() + dataOffset_, len);
         dataOffset_ += len;
         f->can_dlc = len;
 
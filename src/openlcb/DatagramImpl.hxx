@@ -177,9 +177,12 @@ private:
         hasResponse_ = 0;
         isSleeping_ = 0;
         sendPending_ = 1;
-        iface()->dispatcher()->register_handler(&listener_, MTI_1, MASK_1);
-        iface()->dispatcher()->register_handler(&listener_, MTI_2, MASK_2);
-        iface()->dispatcher()->register_handler(&listener_, MTI_3, MASK_3);
+        iface()->dispatcher()->register_shared_handler(
+            &listener_, MTI_1, MASK_1);
+        iface()->dispatcher()->register_shared_handler(
+            &listener_, MTI_2, MASK_2);
+        iface()->dispatcher()->register_shared_handler(
+            &listener_, MTI_3, MASK_3);
     }
 
     /// @todo In IfCanImpl.hxx there is a timeout_looking_for_dst action. It
@@ -0,0 +1,101 @@
+/** \copyright
+ * Copyright (c) 2026, agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file DirectHubTcp.cxx
+ *
+ * OpenLCB-TCP binary protocol support for DirectHub.
+ *
+ * @author agent
+ * @date 17 Oct 2026
+ */
+
+#include "openlcb/DirectHubTcp.hxx"
+
+#include "openlcb/IfTcpImpl.hxx"
+
+namespace openlcb
+{
+
+/// Message segmenter that chops an incoming byte stream into OpenLCB-TCP
+/// messages using the size field of the message header.
+class DirectHubTcpSegmenter : public MessageSegmenter
+{
+public:
+    DirectHubTcpSegmenter()
+    {
+        clear();
+    }
+
+    ssize_t segment_message(const void *d, size_t size) override
+    {
+        const uint8_t *data = static_cast<const uint8_t *>(d);
+        packetLen_ += size;
+        // The size field might be split between reads.
+        for (size_t ofs = 0;
+             hdrLen_ < TcpDefs::HDR_SIZE_END && ofs < size; ++ofs)
+        {
+            hdr_[hdrLen_++] = data[ofs];
+        }
+        if (hdrLen_ < TcpDefs::HDR_SIZE_END)
+        {
+            return 0;
+        }
+        int expected = TcpDefs::get_tcp_message_len(hdr_, hdrLen_);
+        if (packetLen_ < (size_t)expected)
+        {
+            return 0;
+        }
+        return expected;
+    }
+
+    /// Resets internal state machine. The next call to segment_message()
+    /// assumes no previous data present.
+    void clear() override
+    {
+        hdrLen_ = 0;
+        packetLen_ = 0;
+    }
+
+private:
+    /// Prefix of the message header, up to and including the size field.
+    uint8_t hdr_[TcpDefs::HDR_SIZE_END];
+    /// How many bytes of hdr_ are filled in.
+    uint8_t hdrLen_;
+    /// How many bytes we have seen since the beginning of this packet.
+    size_t packetLen_;
+};
+
+MessageSegmenter *create_openlcb_tcp_message_segmenter()
+{
+    return new DirectHubTcpSegmenter();
+}
+
+void create_direct_openlcb_tcp_hub(ByteDirectHubInterface *hub, int port)
+{
+    create_direct_tcp_hub(hub, port, &create_openlcb_tcp_message_segmenter);
+}
+
+} // namespace openlcb
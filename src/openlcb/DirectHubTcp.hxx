@@ -0,0 +1,61 @@
+/** \copyright
+ * Copyright (c) 2026, agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file DirectHubTcp.hxx
+ *
+ * OpenLCB-TCP binary protocol support for DirectHub.
+ *
+ * @author agent
+ * @date 17 Oct 2026
+ */
+
+#ifndef _OPENLCB_DIRECTHUBTCP_HXX_
+#define _OPENLCB_DIRECTHUBTCP_HXX_
+
+#include "utils/DirectHub.hxx"
+
+namespace openlcb
+{
+
+/// Creates a message segmenter for the OpenLCB-TCP binary protocol. Each
+/// message is cut by the length field of its header, so the messages are
+/// forwarded byte for byte between the ports of an OpenLCB-TCP hub without
+/// being parsed.
+/// @return a newly allocated message segmenter that chops OpenLCB-TCP messages
+/// off of a data stream.
+MessageSegmenter *create_openlcb_tcp_message_segmenter();
+
+/// Creates a new OpenLCB-TCP listener on a given TCP port. The object is
+/// leaked (never destroyed).
+/// @param hub incoming and outgoing OpenLCB-TCP messages will be multiplexed
+/// through this hub instance. This must not be the same hub as the
+/// gridconnect hub.
+/// @param port the TCP port to listen on.
+void create_direct_openlcb_tcp_hub(ByteDirectHubInterface *hub, int port);
+
+} // namespace openlcb
+
+#endif // _OPENLCB_DIRECTHUBTCP_HXX_
@@ -287,6 +287,16 @@ public:
     /// Creates a new event iterator. Caller takes ownership of object.
     virtual EventIterator *create_iterator() = 0;
 
+    /// Fast check before iterating for a single event ID. May return false
+    /// positives, but never false negatives.
+    /// @param event the event ID of an incoming message.
+    /// @return false if it is certain that no registered handler would be
+    /// returned by an iteration for this event.
+    virtual bool may_match(EventId event)
+    {
+        return true;
+    }
+
     /// Returns a monotonically increasing number that will change every time
     /// the set of registered event handlers change. Whenever this number
     /// changes, the iterators are invalidated and must be cleared.
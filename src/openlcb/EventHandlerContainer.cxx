@@ -46,6 +46,10 @@ void TreeEventHandlers::register_handler(const EventRegistryEntry &entry,
     LOG(VERBOSE, "%p: register %p", this, entry.handler);
     set_dirty();
     handlers_[mask].insert(EventRegistryEntry(entry));
+    if (!filterStale_)
+    {
+        filter_.add(entry.event, mask);
+    }
 }
 
 void TreeEventHandlers::unregister_handler(
@@ -69,6 +73,9 @@ void TreeEventHandlers::unregister_handler(
             r->second.erase(erase_it, end_it);
         }
     }
+    // Bits cannot be removed from the filter. It gets rebuilt at the next
+    // lookup, so that unregistering many handlers costs one rebuild.
+    filterStale_ = true;
 }
 
 void TreeEventHandlers::reserve(size_t count)
@@ -156,8 +163,303 @@ EventIterator *TreeEventHandlers::create_iterator()
     return new Iterator(this);
 }
 
+bool TreeEventHandlers::may_match(EventId event)
+{
+    AtomicHolder h(this);
+    if (filterStale_)
+    {
+        filterStale_ = false;
+        filter_.clear();
+        for (auto r = handlers_.begin(); r != handlers_.end(); ++r)
+        {
+            for (const auto &e : r->second)
+            {
+                filter_.add(e.event, r->first);
+            }
+        }
+    }
+    return filter_.may_match(event);
+}
+
 TreeEventHandlers::TreeEventHandlers()
 {
 }
 
+FlatEventHandlers::FlatEventHandlers()
+{
+}
+
+void FlatEventHandlers::register_handler(
+    const EventRegistryEntry &entry, unsigned mask)
+{
+    AtomicHolder h(this);
+    LOG(VERBOSE, "%p: register %p", this, entry.handler);
+    set_dirty();
+    entries_.emplace_back(entry, mask);
+    if (!filterStale_)
+    {
+        filter_.add(entry.event, mask);
+    }
+    indexStale_ = true;
+}
+
+void FlatEventHandlers::unregister_handler(
+    EventHandler *handler, uint32_t user_arg, uint32_t user_arg_mask)
+{
+    AtomicHolder h(this);
+    set_dirty();
+    LOG(VERBOSE, "%p: unregister %p", this, handler);
+    auto erase_it = std::remove_if(entries_.begin(), entries_.end(),
+        [handler, user_arg, user_arg_mask](const Entry &e) {
+            return e.entry.handler == handler &&
+                ((e.entry.user_arg & user_arg_mask) ==
+                    (user_arg & user_arg_mask));
+        });
+    entries_.erase(erase_it, entries_.end());
+    filterStale_ = true;
+    indexStale_ = true;
+}
+
+void FlatEventHandlers::reserve(size_t count)
+{
+    AtomicHolder h(this);
+    entries_.reserve(entries_.size() + count);
+}
+
+bool FlatEventHandlers::may_match(EventId event)
+{
+    AtomicHolder h(this);
+    if (filterStale_)
+    {
+        filterStale_ = false;
+        filter_.clear();
+        for (const auto &e : entries_)
+        {
+            filter_.add(e.first, e.mask);
+        }
+    }
+    return filter_.may_match(event);
+}
+
+void FlatEventHandlers::build_index()
+{
+    indexStale_ = false;
+    std::stable_sort(entries_.begin(), entries_.end(),
+        [](const Entry &a, const Entry &b) { return a.first < b.first; });
+    size_t n = entries_.size();
+    if (!n)
+    {
+        rootLevel_ = -1;
+        return;
+    }
+    // Leaves are at the even indexes.
+    size_t last_i = 0;
+    uint64_t last = 0;
+    for (size_t i = 0; i < n; i += 2)
+    {
+        last_i = i;
+        last = entries_[i].maxLast = entries_[i].last;
+    }
+    // Level k nodes are at the indexes with exactly k trailing one bits. Their
+    // children are at +- 2^(k-1). The rightmost subtree may be incomplete; for
+    // missing children we use the max of the last node of the level below.
+    int k;
+    for (k = 1; ((size_t)1 << k) <= n; ++k)
+    {
+        size_t x = (size_t)1 << (k - 1);
+        size_t step = x << 2;
+        for (size_t i = (x << 1) - 1; i < n; i += step)
+        {
+            uint64_t e = entries_[i].last;
+            e = std::max(e, entries_[i - x].maxLast);
+            e = std::max(e, i + x < n ? entries_[i + x].maxLast : last);
+            entries_[i].maxLast = e;
+        }
+        last_i = ((last_i >> k) & 1) ? last_i - x : last_i + x;
+        if (last_i < n && entries_[last_i].maxLast > last)
+        {
+            last = entries_[last_i].maxLast;
+        }
+    }
+    rootLevel_ = k - 1;
+}
+
+template <class Fn>
+void FlatEventHandlers::query(uint64_t first, uint64_t last, Fn fn)
+{
+    if (indexStale_)
+    {
+        build_index();
+    }
+    if (rootLevel_ < 0)
+    {
+        return;
+    }
+    size_t n = entries_.size();
+    struct StackEntry
+    {
+        /// Index of the node.
+        size_t x;
+        /// Level of the node.
+        int k;
+        /// True if the left subtree was already processed.
+        bool left_done;
+    } stack[64];
+    unsigned t = 0;
+    stack[t++] = {((size_t)1 << rootLevel_) - 1, rootLevel_, false};
+    while (t)
+    {
+        StackEntry z = stack[--t];
+        if (z.k <= 3)
+        {
+            // Small subtree: linear scan.
+            size_t i0 = z.x >> z.k << z.k;
+            size_t i1 = std::min(i0 + ((size_t)1 << (z.k + 1)) - 1, n);
+            for (size_t i = i0; i < i1 && entries_[i].first <= last; ++i)
+            {
+                if (first <= entries_[i].last)
+                {
+                    fn(entries_[i]);
+                }
+            }
+        }
+        else if (!z.left_done)
+        {
+            size_t y = z.x - ((size_t)1 << (z.k - 1));
+            stack[t++] = {z.x, z.k, true};
+            // The left child may be out of range if the tree is incomplete.
+            if (y >= n || entries_[y].maxLast >= first)
+            {
+                stack[t++] = {y, z.k - 1, false};
+            }
+        }
+        else if (z.x < n && entries_[z.x].first <= last)
+        {
+            if (first <= entries_[z.x].last)
+            {
+                fn(entries_[z.x]);
+            }
+            stack[t++] = {z.x + ((size_t)1 << (z.k - 1)), z.k - 1, false};
+        }
+    }
+}
+
+/// Class representing the iteration state on the flat event handler
+/// registry. Lookups of a single event are done at once in
+/// init_iteration. Ranges (including the global identify) may match a large
+/// part of the registry, so these scan the sorted entries step by step
+/// instead of copying the results.
+class FlatEventHandlers::Iterator : public EventIterator
+{
+public:
+    Iterator(FlatEventHandlers *parent)
+        : parent_(parent)
+    {
+        clear_iteration();
+    }
+
+    EventRegistryEntry *next_entry() OVERRIDE
+    {
+        if (scanning_)
+        {
+            return next_scan();
+        }
+        if (pos_ >= count_)
+        {
+            return nullptr;
+        }
+        unsigned p = pos_++;
+        if (p < INLINE_SIZE)
+        {
+            return results_[p];
+        }
+        return overflow_[p - INLINE_SIZE];
+    }
+
+    void clear_iteration() OVERRIDE
+    {
+        scanning_ = false;
+        pos_ = 0;
+        count_ = 0;
+        overflow_.clear();
+    }
+
+    void init_iteration(EventReport *r) OVERRIDE
+    {
+        clear_iteration();
+        first_ = r->event;
+        last_ = r->event + r->mask;
+        if (last_ < first_)
+        {
+            last_ = ~0ULL;
+        }
+        AtomicHolder h(parent_);
+        if (r->mask)
+        {
+            if (parent_->indexStale_)
+            {
+                parent_->build_index();
+            }
+            scanning_ = true;
+            return;
+        }
+        parent_->query(first_, last_, [this](Entry &e) { add(&e.entry); });
+    }
+
+private:
+    /// Appends a result of a single event lookup.
+    void add(EventRegistryEntry *e)
+    {
+        if (count_ < INLINE_SIZE)
+        {
+            results_[count_] = e;
+        }
+        else
+        {
+            overflow_.push_back(e);
+        }
+        ++count_;
+    }
+
+    /// @return the next entry overlapping the range in the sorted entries.
+    EventRegistryEntry *next_scan()
+    {
+        AtomicHolder h(parent_);
+        auto &entries = parent_->entries_;
+        while (pos_ < entries.size() && entries[pos_].first <= last_)
+        {
+            Entry &e = entries[pos_++];
+            if (first_ <= e.last)
+            {
+                return &e.entry;
+            }
+        }
+        return nullptr;
+    }
+
+    /// How many results we store without allocating memory.
+    static constexpr unsigned INLINE_SIZE = 8;
+
+    FlatEventHandlers *parent_;
+    /// First event ID of the lookup.
+    uint64_t first_;
+    /// Last event ID of the lookup.
+    uint64_t last_;
+    /// Results of a single event lookup.
+    EventRegistryEntry *results_[INLINE_SIZE];
+    /// Results that did not fit into results_.
+    std::vector<EventRegistryEntry *> overflow_;
+    /// Next result to return, or next entry to scan.
+    size_t pos_;
+    /// Number of results of a single event lookup.
+    unsigned count_;
+    /// True if we are scanning the entries for a range lookup.
+    bool scanning_;
+};
+
+EventIterator *FlatEventHandlers::create_iterator()
+{
+    return new Iterator(this);
+}
+
 } // namespace openlcb
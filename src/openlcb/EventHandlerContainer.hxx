@@ -41,6 +41,7 @@
 #include <vector>
 #include <forward_list>
 #include <stdint.h>
+#include <string.h>
 #include <endian.h>
 
 #ifndef LOGLEVEL
@@ -108,6 +109,94 @@ private:
     C* container_;
 };
 
+/// Compact prefilter for the event registry. Keeps a bloom filter over the
+/// registered event IDs, separately for each registration mask, so that event
+/// ranges are represented by a single entry. A lookup checks one bucket pair
+/// for every mask value in use.
+class EventIdFilter
+{
+public:
+    /// Number of bits in the bloom filter.
+    static constexpr unsigned NUM_BITS = 1024;
+
+    EventIdFilter()
+    {
+        clear();
+    }
+
+    /// Removes all entries.
+    void clear()
+    {
+        memset(bits_, 0, sizeof(bits_));
+        masks_ = 0;
+        matchAll_ = false;
+    }
+
+    /// Adds a registration.
+    /// @param event the registered event ID.
+    /// @param mask number of low bits of the event ID that are wildcards.
+    void add(EventId event, unsigned mask)
+    {
+        if (mask >= 64)
+        {
+            matchAll_ = true;
+            return;
+        }
+        masks_ |= 1ULL << mask;
+        uint32_t h = hash(event >> mask, mask);
+        set_bit(h);
+        set_bit(h >> 16);
+    }
+
+    /// @param event the event ID of an incoming message.
+    /// @return false if there is no registration matching the event ID.
+    bool may_match(EventId event) const
+    {
+        if (matchAll_)
+        {
+            return true;
+        }
+        for (uint64_t m = masks_; m; m &= m - 1)
+        {
+            unsigned mask = __builtin_ctzll(m);
+            uint32_t h = hash(event >> mask, mask);
+            if (get_bit(h) && get_bit(h >> 16))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    /// @return a 32-bit hash of a key, two bucket numbers in the low and high
+    /// halves.
+    static uint32_t hash(uint64_t key, unsigned mask)
+    {
+        key = (key ^ mask) * 0x9E3779B97F4A7C15ULL;
+        return key >> 32;
+    }
+
+    void set_bit(uint32_t h)
+    {
+        h %= NUM_BITS;
+        bits_[h >> 5] |= 1u << (h & 31);
+    }
+
+    bool get_bit(uint32_t h) const
+    {
+        h %= NUM_BITS;
+        return bits_[h >> 5] & (1u << (h & 31));
+    }
+
+    /// The bloom filter.
+    uint32_t bits_[NUM_BITS / 32];
+    /// Bit N is set if there is a registration with mask N.
+    uint64_t masks_;
+    /// True if there is a registration matching every event.
+    bool matchAll_;
+};
+
 /// EventRegistry implementation that keeps all event handlers in a vector and
 /// forwards every single call to each event handler.
 class VectorEventHandlers : public EventRegistry, private Atomic
@@ -157,6 +246,7 @@ public:
     void unregister_handler(EventHandler *handler, uint32_t user_arg = 0,
         uint32_t user_arg_mask = 0) OVERRIDE;
     void reserve(size_t count) OVERRIDE;
+    bool may_match(EventId event) OVERRIDE;
 
 private:
     class Iterator;
@@ -185,6 +275,86 @@ private:
      * bits wide the registration is (it is the mask value in the register
      * call).*/
     MaskLookupMap handlers_;
+    /// Prefilter for the incoming events. Bits cannot be removed from it, so
+    /// it gets rebuilt at the next lookup after handlers were unregistered.
+    EventIdFilter filter_;
+    /// True if handlers were unregistered since filter_ was built.
+    bool filterStale_ {false};
+};
+
+/// EventRegistry implementation that keeps all registrations in a single
+/// sorted vector, indexed as an implicit interval tree: the vector is sorted
+/// by the first event of each registered range, every element is a node of a
+/// balanced binary tree laid out in-order, and stores the largest last event
+/// of its subtree. An iteration runs the stabbing query once, under a single
+/// lock, and hands out the results from a buffer.
+///
+/// Registering and unregistering handlers only marks the index stale; it is
+/// rebuilt (sort and one linear pass) at the next lookup.
+class FlatEventHandlers : public EventRegistry, private Atomic
+{
+public:
+    FlatEventHandlers();
+
+    EventIterator *create_iterator() OVERRIDE;
+    void register_handler(const EventRegistryEntry &entry,
+                          unsigned mask) OVERRIDE;
+    void unregister_handler(EventHandler *handler, uint32_t user_arg = 0,
+        uint32_t user_arg_mask = 0) OVERRIDE;
+    void reserve(size_t count) OVERRIDE;
+    bool may_match(EventId event) OVERRIDE;
+
+private:
+    class Iterator;
+    friend class Iterator;
+
+    /// One registration.
+    struct Entry
+    {
+        Entry(const EventRegistryEntry &e, unsigned _mask)
+            : entry(e)
+            , mask(_mask)
+        {
+            uint64_t low = mask >= 64 ? ~0ULL : (1ULL << mask) - 1;
+            first = e.event & ~low;
+            last = first | low;
+            maxLast = last;
+        }
+
+        /// Registration arguments.
+        EventRegistryEntry entry;
+        /// First event ID of the registered range.
+        uint64_t first;
+        /// Last event ID of the registered range (inclusive).
+        uint64_t last;
+        /// Largest last event ID in the subtree of this node.
+        uint64_t maxLast;
+        /// Mask argument of the registration.
+        uint8_t mask;
+    };
+
+    /// Sorts the entries and computes maxLast for every node. Called with the
+    /// lock held.
+    void build_index();
+
+    /// Finds all registrations that overlap with an event range. Called with
+    /// the lock held.
+    /// @param first first event ID of the query.
+    /// @param last last event ID of the query (inclusive).
+    /// @param fn will be called with every matching entry.
+    template <class Fn> void query(uint64_t first, uint64_t last, Fn fn);
+
+    /// All registrations.
+    std::vector<Entry> entries_;
+    /// Height of the implicit tree; the root is at index (1 << level) - 1.
+    int rootLevel_ {-1};
+    /// True if entries_ changed since the index was built.
+    bool indexStale_ {false};
+    /// Prefilter for the incoming events. Rebuilt at the next lookup after
+    /// handlers were unregistered.
+    EventIdFilter filter_;
+    /// True if handlers were unregistered since filter_ was built.
+    bool filterStale_ {false};
 };
 
 }; /* namespace openlcb */
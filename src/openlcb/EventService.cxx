@@ -13,6 +13,8 @@
 #include "openlcb/EventHandlerContainer.hxx"
 #include "openlcb/Defs.hxx"
 #include "openlcb/EndianHelper.hxx"
+#include "openlcb/Node.hxx"
+#include "nmranet_config.h"
 
 namespace openlcb
 {
@@ -46,10 +48,10 @@ void EventService::register_interface(If *iface)
     impl()->ownedFlows_.emplace_back(new InlineEventIteratorFlow(
         iface, this, EventService::Impl::MTI_VALUE_EVENT,
         EventService::Impl::MTI_MASK_EVENT));
-    impl()->ownedFlows_.emplace_back(new EventIteratorFlow(
+    impl()->ownedFlows_.emplace_back(new IdentifyEventsFlow(
         iface, this, EventService::Impl::MTI_VALUE_GLOBAL,
         EventService::Impl::MTI_MASK_GLOBAL));
-    impl()->ownedFlows_.emplace_back(new EventIteratorFlow(
+    impl()->ownedFlows_.emplace_back(new IdentifyEventsFlow(
         iface, this, EventService::Impl::MTI_VALUE_ADDRESSED_ALL,
         EventService::Impl::MTI_MASK_ADDRESSED_ALL));
 }
@@ -59,7 +61,14 @@ EventService::Impl::Impl(EventService *service) : callerFlow_(service)
 #ifdef TARGET_LPC11Cxx
     registry.reset(new VectorEventHandlers());
 #else
-    registry.reset(new TreeEventHandlers());
+    if (config_event_registry_flat() == CONSTANT_TRUE)
+    {
+        registry.reset(new FlatEventHandlers());
+    }
+    else
+    {
+        registry.reset(new TreeEventHandlers());
+    }
 #endif
 }
 
@@ -114,6 +123,17 @@ bool EventService::event_processing_pending()
     return false;
 }
 
+const EventService::IdentifyStats &EventService::identify_stats()
+{
+    return impl()->identifyStats_;
+}
+
+void EventService::clear_identify_cache()
+{
+    impl()->identifyCache_.clear();
+    ++impl()->identifyCacheGeneration_;
+}
+
 void DecodeRange(EventReport *r)
 {
     uint64_t e = r->event;
@@ -228,12 +248,23 @@ StateFlowBase::Action EventIteratorFlow::entry()
                 "Unexpected message arrived at the global event handler.");
             return release_and_exit();
     } //    case
+    if (rep->mask == 0 &&
+        !eventService_->impl()->registry->may_match(rep->event))
+    {
+        // No event handler is registered for this event.
+        return release_and_exit();
+    }
     // The incoming message is not needed anymore.
     incomingDone_ = message()->new_child();
     release();
 
+    return start_iteration();
+}
+
+StateFlowBase::Action EventIteratorFlow::start_iteration()
+{
     eventRegistryEpoch_ = eventService_->impl()->registry->get_epoch();
-    iterator_->init_iteration(rep);
+    iterator_->init_iteration(&eventReport_);
     return yield_and_call(STATE(iterate_next));
 }
 
@@ -251,30 +282,35 @@ StateFlowBase::Action EventIteratorFlow::iterate_next()
     EventRegistryEntry *entry = iterator_->next_entry();
     if (!entry)
     {
-        if (incomingDone_)
-        {
-            incomingDone_->notify();
-            incomingDone_ = nullptr;
-        }
+        return iteration_done();
+    }
+    return dispatch_event(entry);
+}
+
+StateFlowBase::Action EventIteratorFlow::iteration_done()
+{
+    if (incomingDone_)
+    {
+        incomingDone_->notify();
+        incomingDone_ = nullptr;
+    }
 
 #ifdef DEBUG_EVENT_PERFORMANCE
-        long long len = os_get_time_monotonic() - currentProcessStart_;
-        numProcessNsec_ += len;
-        countEvents_++;
-        if (countEvents_ >= REPORT_COUNT)
-        {
-            //long msec = numProcessNsec_ / 1000000;
-            //printf("event perf for mti %04x: %ld msec for %d events\n",
-            //       mtiValue_, msec, REPORT_COUNT);
-            countEvents_ = 0;
-            numProcessNsec_ = 0;
-        }
+    long long len = os_get_time_monotonic() - currentProcessStart_;
+    numProcessNsec_ += len;
+    countEvents_++;
+    if (countEvents_ >= REPORT_COUNT)
+    {
+        //long msec = numProcessNsec_ / 1000000;
+        //printf("event perf for mti %04x: %ld msec for %d events\n",
+        //       mtiValue_, msec, REPORT_COUNT);
+        countEvents_ = 0;
+        numProcessNsec_ = 0;
+    }
 
 #endif
 
-        return exit();
-    }
-    return dispatch_event(entry);
+    return exit();
 }
 
 StateFlowBase::Action EventIteratorFlow::dispatch_event(const EventRegistryEntry *entry)
@@ -316,4 +352,234 @@ InlineEventIteratorFlow::dispatch_event(const EventRegistryEntry *entry)
     }
 }
 
+/// Orders registry entries for looking up the handlers that already replied.
+static bool replayed_less(
+    const EventRegistryEntry &a, const EventRegistryEntry &b)
+{
+    if (a.handler != b.handler)
+    {
+        return a.handler < b.handler;
+    }
+    if (a.event != b.event)
+    {
+        return a.event < b.event;
+    }
+    return a.user_arg < b.user_arg;
+}
+
+StateFlowBase::Action IdentifyEventsFlow::start_iteration()
+{
+    auto *impl = eventService_->impl();
+    bool use_cache = config_event_identify_cache() == CONSTANT_TRUE;
+    startTime_ = os_get_time_monotonic();
+    numHandlers_ = 0;
+    numResponders_ = 0;
+    responders_.clear();
+    replayed_.clear();
+    eventRegistryEpoch_ = impl->registry->get_epoch();
+    learnEpoch_ = eventRegistryEpoch_;
+    int idx = use_cache ? find_cache() : -1;
+    if (idx >= 0)
+    {
+        replaying_ = true;
+        learning_ = false;
+        cacheIndex_ = idx;
+        cacheGeneration_ = impl->identifyCacheGeneration_;
+        nextResponder_ = 0;
+        ++impl->identifyStats_.numCacheHits;
+        return yield_and_call(STATE(replay_next));
+    }
+    replaying_ = false;
+    learning_ = use_cache && can_learn();
+    return EventIteratorFlow::start_iteration();
+}
+
+StateFlowBase::Action IdentifyEventsFlow::replay_next()
+{
+    auto *impl = eventService_->impl();
+    if (eventRegistryEpoch_ != impl->registry->get_epoch() ||
+        cacheGeneration_ != impl->identifyCacheGeneration_)
+    {
+        // The cache entry is not valid anymore. We fall back to calling every
+        // handler, except those that already replied.
+        replaying_ = false;
+        learning_ = false;
+        std::sort(replayed_.begin(), replayed_.end(), &replayed_less);
+        return EventIteratorFlow::start_iteration();
+    }
+    auto &r = impl->identifyCache_[cacheIndex_].responders;
+    if (nextResponder_ >= r.size())
+    {
+        return iteration_done();
+    }
+    return call_handler(r[nextResponder_++]);
+}
+
+StateFlowBase::Action IdentifyEventsFlow::dispatch_event(
+    const EventRegistryEntry *entry)
+{
+    if (eventRegistryEpoch_ != eventService_->impl()->registry->get_epoch())
+    {
+        // Will restart iteration.
+        return call_immediately(STATE(iterate_next));
+    }
+    if (!replayed_.empty() &&
+        std::binary_search(
+            replayed_.begin(), replayed_.end(), *entry, &replayed_less))
+    {
+        // Already replied from the identify cache.
+        return call_immediately(STATE(iterate_next));
+    }
+    return call_handler(entry);
+}
+
+StateFlowBase::Action IdentifyEventsFlow::call_handler(
+    const EventRegistryEntry *entry)
+{
+    ++numHandlers_;
+    n_.reset(this);
+    // It is required to hold on to a child to call abort_if_almost_done.
+    auto *c = n_.new_child();
+    (entry->handler->*(fn_))(*entry, &eventReport_, &n_);
+    if (n_.abort_if_almost_done())
+    {
+        // Event handler did not send anything.
+        return next_handler();
+    }
+    ++numResponders_;
+    if (learning_)
+    {
+        responders_.push_back(entry);
+    }
+    if (replaying_)
+    {
+        // The entry might go away if the replay gets interrupted.
+        replayed_.push_back(*entry);
+    }
+    c->notify();
+    return wait_and_call(STATE(call_done));
+}
+
+StateFlowBase::Action IdentifyEventsFlow::call_done()
+{
+    long long pace = USEC_TO_NSEC(config_event_identify_pace_usec());
+    if (pace <= 0)
+    {
+        return next_handler();
+    }
+    if (replaying_)
+    {
+        return sleep_and_call(&timer_, pace, STATE(replay_next));
+    }
+    return sleep_and_call(&timer_, pace, STATE(iterate_next));
+}
+
+StateFlowBase::Action IdentifyEventsFlow::next_handler()
+{
+    if (replaying_)
+    {
+        return call_immediately(STATE(replay_next));
+    }
+    return call_immediately(STATE(iterate_next));
+}
+
+StateFlowBase::Action IdentifyEventsFlow::iteration_done()
+{
+    auto *impl = eventService_->impl();
+    if (learning_ && learnEpoch_ == impl->registry->get_epoch() &&
+        can_learn())
+    {
+        store_cache();
+    }
+    responders_.clear();
+    replayed_.clear();
+
+    auto &st = impl->identifyStats_;
+    long long len = os_get_time_monotonic() - startTime_;
+    ++st.numIdentify;
+    st.lastHandlers = numHandlers_;
+    st.lastResponders = numResponders_;
+    st.lastNsec = len;
+    if (len > st.maxNsec)
+    {
+        st.maxNsec = len;
+    }
+    LOG(VERBOSE, "Identify events: called %u handlers, %u replied, %u usec%s",
+        numHandlers_, numResponders_, (unsigned)(len / 1000),
+        replaying_ ? " (cached)" : "");
+    return EventIteratorFlow::iteration_done();
+}
+
+unsigned IdentifyEventsFlow::count_local_nodes(bool *all_initialized)
+{
+    unsigned n = 0;
+    *all_initialized = true;
+    for (Node *node = iface()->first_local_node(); node;
+         node = iface()->next_local_node(node->node_id()))
+    {
+        ++n;
+        if (!node->is_initialized())
+        {
+            *all_initialized = false;
+        }
+    }
+    return n;
+}
+
+bool IdentifyEventsFlow::can_learn()
+{
+    if (eventReport_.dst_node)
+    {
+        return eventReport_.dst_node->is_initialized();
+    }
+    bool all_initialized;
+    count_local_nodes(&all_initialized);
+    return all_initialized;
+}
+
+int IdentifyEventsFlow::find_cache()
+{
+    bool all_initialized;
+    unsigned num_nodes = count_local_nodes(&all_initialized);
+    auto &cache = eventService_->impl()->identifyCache_;
+    for (unsigned i = 0; i < cache.size(); ++i)
+    {
+        if (cache[i].iface == iface() &&
+            cache[i].dstNode == eventReport_.dst_node &&
+            cache[i].epoch == eventRegistryEpoch_ &&
+            cache[i].numLocalNodes == num_nodes)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void IdentifyEventsFlow::store_cache()
+{
+    auto *impl = eventService_->impl();
+    bool all_initialized;
+    EventService::Impl::IdentifyCache *e = nullptr;
+    for (auto &c : impl->identifyCache_)
+    {
+        if (c.iface == iface() && c.dstNode == eventReport_.dst_node)
+        {
+            // Someone might be replaying this entry.
+            ++impl->identifyCacheGeneration_;
+            e = &c;
+            break;
+        }
+    }
+    if (!e)
+    {
+        impl->identifyCache_.emplace_back();
+        e = &impl->identifyCache_.back();
+        e->iface = iface();
+        e->dstNode = eventReport_.dst_node;
+    }
+    e->epoch = learnEpoch_;
+    e->numLocalNodes = count_local_nodes(&all_initialized);
+    e->responders = std::move(responders_);
+}
+
 } /* namespace openlcb */
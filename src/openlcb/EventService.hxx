@@ -88,6 +88,35 @@ public:
      * handled. */
     bool event_processing_pending();
 
+    /// Statistics about processing identify events messages (global and
+    /// addressed).
+    struct IdentifyStats
+    {
+        /// Number of identify events messages processed.
+        unsigned numIdentify {0};
+        /// How many of these were answered from the responder cache.
+        unsigned numCacheHits {0};
+        /// How many event handlers were called for the last identify.
+        unsigned lastHandlers {0};
+        /// How many event handlers sent replies for the last identify.
+        unsigned lastResponders {0};
+        /// Time it took to process the last identify, including sending out
+        /// all the replies.
+        long long lastNsec {0};
+        /// Longest time it took to process an identify.
+        long long maxNsec {0};
+    };
+
+    /// @return statistics about the identify events messages processed.
+    const IdentifyStats &identify_stats();
+
+    /// Forgets which event handlers reply to identify events messages. The
+    /// next identify events message will call every registered event
+    /// handler. When config_event_identify_cache() is enabled, event handlers
+    /// that start replying to identify messages without registering or
+    /// unregistering anything need to call this.
+    void clear_identify_cache();
+
     static EventService *instance;
 
 private:
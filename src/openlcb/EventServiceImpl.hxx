@@ -107,6 +107,31 @@ public:
     /// calls need to be sent to this flow.
     EventCallerFlow callerFlow_;
 
+    /// Remembers which event handlers reply to an identify events message. An
+    /// entry is valid as long as the event registry's epoch has not changed.
+    struct IdentifyCache
+    {
+        /// Interface on which the identify message arrived.
+        If *iface;
+        /// Destination of the addressed identify, or nullptr for the global
+        /// identify.
+        Node *dstNode;
+        /// Event registry epoch when the responders were collected.
+        unsigned epoch;
+        /// Number of local nodes of the interface at that time.
+        unsigned numLocalNodes;
+        /// Registry entries whose handler replied, in iteration order.
+        std::vector<const EventRegistryEntry *> responders;
+    };
+
+    /// Responder lists, one per interface and identify destination.
+    std::vector<IdentifyCache> identifyCache_;
+    /// Incremented every time an existing identifyCache_ entry is overwritten
+    /// or removed.
+    unsigned identifyCacheGeneration_ {0};
+    /// Statistics about the identify events messages.
+    EventService::IdentifyStats identifyStats_;
+
     enum
     {
         // These address/mask should match all the messages carrying an event
@@ -135,6 +160,14 @@ protected:
     Action entry() OVERRIDE;
     Action iterate_next();
 
+    /// Called after the incoming message is parsed into eventReport_ and
+    /// released. Starts iterating through the event registry.
+    virtual Action start_iteration();
+
+    /// Called when all event handlers were called. Releases the incoming
+    /// message and terminates the flow.
+    virtual Action iteration_done();
+
 private:
     virtual Action dispatch_event(const EventRegistryEntry *entry);
 
@@ -190,6 +223,90 @@ private:
     const EventRegistryEntry *currentEntry_{nullptr};
 };
 
+/** Flow to handle the identify events messages (global and addressed). The
+ * handlers are called inline, one at a time, waiting for each handler's
+ * replies to be sent before calling the next, so the outgoing buffers in use
+ * are bounded by the four write helpers in the event report. Between two
+ * replying handlers the flow waits at least config_event_identify_pace_usec().
+ *
+ * If config_event_identify_cache() is CONSTANT_TRUE, the first time an
+ * identify arrives the flow iterates through all event handlers, and
+ * remembers which of them replied, i.e. did not finish synchronously. Later
+ * identify messages with the same destination only call these handlers,
+ * until the event registry changes. Responders are only learned when the
+ * nodes addressed are all initialized. This relies on event handlers that do
+ * not reply to an identify message continuing not to reply until the
+ * registry changes or EventService::clear_identify_cache() is called. */
+class IdentifyEventsFlow : public EventIteratorFlow
+{
+public:
+    IdentifyEventsFlow(If *iface, EventService *event_service,
+        unsigned mti_value, unsigned mti_mask)
+        : EventIteratorFlow(iface, event_service, mti_value, mti_mask)
+    {
+    }
+
+private:
+    Action start_iteration() override;
+    Action iteration_done() override;
+    Action dispatch_event(const EventRegistryEntry *entry) override;
+
+    /// Calls the next handler from the responder cache.
+    Action replay_next();
+
+    /// Called when an event handler has sent its replies.
+    Action call_done();
+
+    /// Moves on to the next handler.
+    Action next_handler();
+
+    /// Calls an event handler for the current identify message.
+    Action call_handler(const EventRegistryEntry *entry);
+
+    /// Counts the local nodes of the interface.
+    /// @param all_initialized will be set to false if some of the local nodes
+    /// are not initialized.
+    /// @return number of local nodes.
+    unsigned count_local_nodes(bool *all_initialized);
+
+    /// @return true if the replies of the event handlers can be learned for
+    /// the current message.
+    bool can_learn();
+
+    /// @return index of the valid cache entry for the current message in the
+    /// identify cache, or -1 if none.
+    int find_cache();
+
+    /// Stores responders_ in the identify cache.
+    void store_cache();
+
+    /// Handlers that replied in the current iteration.
+    std::vector<const EventRegistryEntry *> responders_;
+    /// Copies of the entries that replied while replaying the cache. Sorted
+    /// if the replay was interrupted, to skip them when calling every handler.
+    std::vector<EventRegistryEntry> replayed_;
+    /// Helper for pacing.
+    StateFlowTimer timer_ {this};
+    /// When the processing of the current identify started.
+    long long startTime_;
+    /// Generation of the identify cache when we started replaying it.
+    unsigned cacheGeneration_;
+    /// Index in the identify cache that is being replayed.
+    unsigned cacheIndex_;
+    /// Next responder to call from the cache entry.
+    unsigned nextResponder_;
+    /// Number of handlers called in the current iteration.
+    unsigned numHandlers_;
+    /// Number of handlers that replied in the current iteration.
+    unsigned numResponders_;
+    /// Event registry epoch when the current iteration started.
+    unsigned learnEpoch_;
+    /// True if we are calling handlers from the cache.
+    bool replaying_ : 1;
+    /// True if we are collecting the responders for the cache.
+    bool learning_ : 1;
+};
+
 } // namespace openlcb
 
 #endif // _OPENLCB_EVENTSERVICEIMPL_HXX_
@@ -0,0 +1,407 @@
+/** \copyright
+ * Copyright (c) 2026, agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are  permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file HashAliasCache.cxx
+ * Alias cache using open addressing hash tables, for large networks.
+ *
+ * @author agent
+ * @date 17 Oct 2026
+ */
+
+#include "openlcb/HashAliasCache.hxx"
+
+#include "utils/logging.h"
+
+namespace openlcb
+{
+
+#define CONSTANT 0x1B0CA37ABA9 /**< constant for random number generation */
+
+constexpr uint16_t HashAliasCache::NONE_ENTRY;
+
+HashAliasCache::HashAliasCache(NodeID seed, size_t entries,
+    void (*remove_callback)(NodeID id, NodeAlias alias, void *), void *context)
+    : pool(new Metadata[entries])
+    , referenced(new uint32_t[(entries + 31) / 32])
+    , seed(seed)
+    , entries(entries)
+    , removeCallback(remove_callback)
+    , context(context)
+{
+    HASSERT(entries < NONE_ENTRY);
+    // Keeps the load factor at or below 50%.
+    unsigned bits = 1;
+    while ((1u << bits) < 2 * entries)
+    {
+        ++bits;
+    }
+    tableMask = (1u << bits) - 1;
+    hashShift = 32 - bits;
+    aliasTable = new uint16_t[tableMask + 1];
+    idTable = new uint16_t[tableMask + 1];
+    clear();
+}
+
+HashAliasCache::~HashAliasCache()
+{
+    delete[] idTable;
+    delete[] aliasTable;
+    delete[] referenced;
+    delete[] pool;
+}
+
+void HashAliasCache::clear()
+{
+    for (unsigned i = 0; i <= tableMask; ++i)
+    {
+        aliasTable[i] = NONE_ENTRY;
+        idTable[i] = NONE_ENTRY;
+    }
+    for (unsigned i = 0; i < (entries + 31) / 32; ++i)
+    {
+        referenced[i] = 0;
+    }
+    freeList = NONE_ENTRY;
+    for (size_t i = entries; i > 0; --i)
+    {
+        pool[i - 1].alias_ = 0;
+        pool[i - 1].nodeIdHigh_ = 0;
+        pool[i - 1].nodeIdLow_ = freeList;
+        freeList = i - 1;
+    }
+    clockHand = 0;
+}
+
+void HashAliasCache::erase_slot(uint16_t *table, unsigned slot, HomeFn home)
+{
+    unsigned hole = slot;
+    for (unsigned s = (hole + 1) & tableMask; table[s] != NONE_ENTRY;
+         s = (s + 1) & tableMask)
+    {
+        // The entry in s may move back into the hole only if that does not
+        // put it before its home slot.
+        unsigned h = (this->*home)(table[s]);
+        if (((s - h) & tableMask) >= ((s - hole) & tableMask))
+        {
+            table[hole] = table[s];
+            hole = s;
+        }
+    }
+    table[hole] = NONE_ENTRY;
+}
+
+void HashAliasCache::unlink(uint16_t idx)
+{
+    Metadata *m = pool + idx;
+    if (m->alias_ != NOT_RESPONDING)
+    {
+        erase_slot(aliasTable, find_alias_slot(m->alias_),
+            &HashAliasCache::alias_home);
+    }
+    erase_slot(idTable, find_id_slot(m->get_node_id()),
+        &HashAliasCache::id_home);
+    referenced[idx >> 5] &= ~(1u << (idx & 31));
+    m->alias_ = 0;
+    m->nodeIdHigh_ = 0;
+    m->nodeIdLow_ = freeList;
+    freeList = idx;
+}
+
+uint16_t HashAliasCache::clock_victim()
+{
+    while (true)
+    {
+        uint16_t idx = clockHand;
+        if (++clockHand >= entries)
+        {
+            clockHand = 0;
+        }
+        uint32_t bit = 1u << (idx & 31);
+        if (referenced[idx >> 5] & bit)
+        {
+            // Second chance.
+            referenced[idx >> 5] &= ~bit;
+            continue;
+        }
+        return idx;
+    }
+}
+
+void HashAliasCache::add(NodeID id, NodeAlias alias)
+{
+    HASSERT(id != 0);
+    HASSERT(alias != 0);
+
+    if (alias != NOT_RESPONDING)
+    {
+        uint16_t idx = aliasTable[find_alias_slot(alias)];
+        if (idx != NONE_ENTRY)
+        {
+            /* we already have a mapping for this alias, so lets remove it */
+            NodeID nid = pool[idx].get_node_id();
+            unlink(idx);
+            if (removeCallback)
+            {
+                /* tell the interface layer that we removed this mapping */
+                (*removeCallback)(nid, alias, context);
+            }
+        }
+    }
+    uint16_t idx = idTable[find_id_slot(id)];
+    if (idx != NONE_ENTRY)
+    {
+        /* we already have a mapping for this id, so lets remove it */
+        NodeAlias old_alias = pool[idx].alias_;
+        unlink(idx);
+        if (removeCallback)
+        {
+            /* tell the interface layer that we removed this mapping */
+            (*removeCallback)(id, old_alias, context);
+        }
+    }
+
+    if (freeList == NONE_ENTRY)
+    {
+        HASSERT(entries);
+        /* kick out an entry that was not used recently */
+        idx = clock_victim();
+        NodeID nid = pool[idx].get_node_id();
+        NodeAlias old_alias = pool[idx].alias_;
+        unlink(idx);
+        if (removeCallback)
+        {
+            /* tell the interface layer that we removed this mapping */
+            (*removeCallback)(nid, old_alias, context);
+        }
+    }
+
+    idx = freeList;
+    Metadata *m = pool + idx;
+    freeList = m->nodeIdLow_;
+    m->set_node_id(id);
+    m->alias_ = alias;
+    if (alias != NOT_RESPONDING)
+    {
+        aliasTable[find_alias_slot(alias)] = idx;
+    }
+    idTable[find_id_slot(id)] = idx;
+    touch(idx);
+}
+
+void HashAliasCache::remove(NodeAlias alias)
+{
+    if (alias == 0 || alias == NOT_RESPONDING)
+    {
+        return;
+    }
+    uint16_t idx = aliasTable[find_alias_slot(alias)];
+    if (idx != NONE_ENTRY)
+    {
+        unlink(idx);
+    }
+}
+
+bool HashAliasCache::retrieve(unsigned entry, NodeID *node, NodeAlias *alias)
+{
+    HASSERT(entry < size());
+    Metadata *md = pool + entry;
+    if (!md->alias_)
+    {
+        return false;
+    }
+    if (node)
+    {
+        *node = md->get_node_id();
+    }
+    if (alias)
+    {
+        *alias = md->alias_;
+    }
+    return true;
+}
+
+bool HashAliasCache::next_entry(NodeID bound, NodeID *node, NodeAlias *alias)
+{
+    Metadata *found = nullptr;
+    NodeID found_id = 0;
+    for (size_t i = 0; i < entries; ++i)
+    {
+        if (!pool[i].alias_)
+        {
+            continue;
+        }
+        NodeID id = pool[i].get_node_id();
+        if (id > bound && (!found || id < found_id))
+        {
+            found = pool + i;
+            found_id = id;
+        }
+    }
+    if (!found)
+    {
+        return false;
+    }
+    if (node)
+    {
+        *node = found_id;
+    }
+    if (alias)
+    {
+        *alias = found->alias_;
+    }
+    return true;
+}
+
+NodeAlias HashAliasCache::lookup(NodeID id)
+{
+    HASSERT(id != 0);
+    uint16_t idx = idTable[find_id_slot(id)];
+    if (idx == NONE_ENTRY)
+    {
+        return 0;
+    }
+    touch(idx);
+    return pool[idx].alias_;
+}
+
+NodeID HashAliasCache::lookup(NodeAlias alias)
+{
+    if (alias == 0 || alias == NOT_RESPONDING)
+    {
+        return 0;
+    }
+    uint16_t idx = aliasTable[find_alias_slot(alias)];
+    if (idx == NONE_ENTRY)
+    {
+        return 0;
+    }
+    touch(idx);
+    return pool[idx].get_node_id();
+}
+
+void HashAliasCache::for_each(
+    void (*callback)(void *, NodeID, NodeAlias), void *context)
+{
+    HASSERT(callback != NULL);
+    for (size_t i = 0; i < entries; ++i)
+    {
+        if (pool[i].alias_)
+        {
+            (*callback)(context, pool[i].get_node_id(), pool[i].alias_);
+        }
+    }
+}
+
+NodeAlias HashAliasCache::generate()
+{
+    NodeAlias alias;
+
+    do
+    {
+        /* calculate the alias given the current seed */
+        alias = (seed ^ (seed >> 12) ^ (seed >> 24) ^ (seed >> 36)) & 0xfff;
+
+        /* calculate the next seed */
+        seed = ((((1 << 9) + 1) * (seed) + CONSTANT)) & 0xffffffffffff;
+    } while (alias == 0 || lookup(alias) != 0);
+
+    /* new random alias */
+    return alias;
+}
+
+#ifdef GTEST
+
+int HashAliasCache::check_consistency()
+{
+    unsigned num_free = 0;
+    for (uint16_t p = freeList; p != NONE_ENTRY; p = pool[p].nodeIdLow_)
+    {
+        if (p >= entries || pool[p].alias_ != 0)
+        {
+            LOG(INFO, "Freelist points to a used entry.");
+            return 1;
+        }
+        if (++num_free > entries)
+        {
+            LOG(INFO, "Loop in the freelist.");
+            return 2;
+        }
+    }
+    unsigned num_used = 0;
+    unsigned num_aliases = 0;
+    for (unsigned i = 0; i < entries; ++i)
+    {
+        Metadata *m = pool + i;
+        if (!m->alias_)
+        {
+            continue;
+        }
+        ++num_used;
+        if (idTable[find_id_slot(m->get_node_id())] != i)
+        {
+            LOG(INFO, "Entry is not found in the id table.");
+            return 3;
+        }
+        if (m->alias_ == NOT_RESPONDING)
+        {
+            continue;
+        }
+        ++num_aliases;
+        if (aliasTable[find_alias_slot(m->alias_)] != i)
+        {
+            LOG(INFO, "Entry is not found in the alias table.");
+            return 4;
+        }
+    }
+    if (num_used + num_free != entries)
+    {
+        LOG(INFO, "Lost some metadata entries.");
+        return 5;
+    }
+    unsigned id_slots = 0;
+    unsigned alias_slots = 0;
+    for (unsigned s = 0; s <= tableMask; ++s)
+    {
+        if (idTable[s] != NONE_ENTRY)
+        {
+            ++id_slots;
+        }
+        if (aliasTable[s] != NONE_ENTRY)
+        {
+            ++alias_slots;
+        }
+    }
+    if (id_slots != num_used || alias_slots != num_aliases)
+    {
+        LOG(INFO, "Stale entries in the hash tables.");
+        return 6;
+    }
+    return 0;
+}
+
+#endif
+
+} // namespace openlcb
@@ -0,0 +1,318 @@
+/** \copyright
+ * Copyright (c) 2026, agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are  permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file HashAliasCache.hxx
+ * Alias cache using open addressing hash tables, for large networks.
+ *
+ * @author agent
+ * @date 17 Oct 2026
+ */
+
+#ifndef _OPENLCB_HASHALIASCACHE_HXX_
+#define _OPENLCB_HASHALIASCACHE_HXX_
+
+#include "openlcb/Defs.hxx"
+#include "utils/macros.h"
+
+namespace openlcb
+{
+
+/** Cache of alias to node id mappings, with the same interface as
+ * AliasCache. The cache is limited to a fixed number of entries at
+ * construction, and all memory is allocated by the constructor. There is no
+ * locking inside; mutual exclusion must be handled by the user.
+ *
+ * This implementation is meant for the remote alias cache of large networks
+ * (thousands of nodes), where the sorted vectors of AliasCache make inserts
+ * O(n) and every lookup a binary search through an indirection.
+ *
+ * Theory of operation:
+ *
+ * The NodeID and alias values are stored in the `pool` array of Metadata
+ * entries, same as in AliasCache. Unused entries have alias zero and are
+ * linked into a freelist.
+ *
+ * Lookup by alias and lookup by node ID each use a hash table with linear
+ * probing. The tables store 2-byte indexes into `pool`, and are sized to a
+ * power of two at least twice the number of entries, so the probe sequences
+ * stay short. Removal uses backward shift deletion, so there are no
+ * tombstones and lookups never degrade with churn.
+ *
+ * Instead of an LRU list, eviction uses the CLOCK algorithm: every lookup
+ * sets a referenced bit for the entry, and when a new entry needs space, a
+ * hand sweeps around the pool, clearing referenced bits until it finds an
+ * entry that was not used since the last sweep. This costs one bit per entry
+ * instead of two list links, and lookups do not write to the pool.
+ *
+ * Differences from AliasCache:
+ * - for_each() iterates in pool order, not in last touched order.
+ * - next_entry() scans the entire pool.
+ * - NOT_RESPONDING entries are only indexed by node ID; looking up the
+ *   NOT_RESPONDING alias returns 0.
+ */
+class HashAliasCache
+{
+public:
+    /** Constructor.
+     * @param seed starting seed for generation of aliases
+     * @param entries maximum number of entries in this cache
+     * @param remove_callback callback to call when we remove a mapping from
+     *        the cache however it will not be called in the remove() method
+     * @param context context pointer to pass to remove_callback
+     */
+    HashAliasCache(NodeID seed, size_t entries,
+        void (*remove_callback)(NodeID id, NodeAlias alias, void *) = NULL,
+        void *context = NULL);
+
+    ~HashAliasCache();
+
+    /// Sentinel entry for empty hash table slots and lists.
+    static constexpr uint16_t NONE_ENTRY = 0xFFFFu;
+
+    /** Reinitializes the entire map. */
+    void clear();
+
+    /** Add an alias to an alias cache.
+     * @param id 48-bit NMRAnet Node ID to associate alias with
+     * @param alias 12-bit alias associated with Node ID
+     */
+    void add(NodeID id, NodeAlias alias);
+
+    /** Remove an alias from an alias cache.  This method does not call the
+     * remove_callback method passed in at construction since it is a
+     * deliberate call not requiring notification.
+     * @param alias 12-bit alias associated with Node ID
+     */
+    void remove(NodeAlias alias);
+
+    /** Lookup a node's alias based on its Node ID.
+     * @param id Node ID to look for
+     * @return alias that matches the Node ID, else 0 if not found
+     */
+    NodeAlias lookup(NodeID id);
+
+    /** Lookup a node's ID based on its alias.
+     * @param alias alias to look for
+     * @return Node ID that matches the alias, else 0 if not found
+     */
+    NodeID lookup(NodeAlias alias);
+
+    /** Call the given callback function once for each alias tracked. The
+     * order is unspecified.
+     * @param callback method to call
+     * @param context context pointer to pass to callback
+     */
+    void for_each(void (*callback)(void *, NodeID, NodeAlias), void *context);
+
+    /** Returns the total number of aliases that can be cached. */
+    size_t size()
+    {
+        return entries;
+    }
+
+    /** Retrieves an entry by index. Allows stable iteration in the face of
+     * changes.
+     * @param entry is between 0 and size() - 1.
+     * @param node will be filled with the node ID. May be null.
+     * @param alias will be filled with the alias. May be null.
+     * @return true if the entry is valid, and node and alias were filled,
+     * otherwise false if the entry is not allocated.
+     */
+    bool retrieve(unsigned entry, NodeID *node, NodeAlias *alias);
+
+    /** Retrieves the next entry by increasing node ID. This is a linear scan
+     * of the cache.
+     * @param bound is a Node ID. Will search for the next largest node ID
+     * (upper bound of this key).
+     * @param node will be filled with the node ID. May be null.
+     * @param alias will be filled with the alias. May be null.
+     * @return true if a larger element is found and node and alias were
+     * filled, otherwise false if bound is >= the largest node ID in the cache.
+     */
+    bool next_entry(NodeID bound, NodeID *node, NodeAlias *alias);
+
+    /** Generate a 12-bit pseudo-random alias for a given alias cache.
+     * @return pseudo-random 12-bit alias, an alias of zero is invalid
+     */
+    NodeAlias generate();
+
+    /** Visible for testing. Check internal consistency. */
+    int check_consistency();
+
+private:
+    /** Interesting information about a given cache entry. */
+    struct Metadata
+    {
+        /// Sets the node ID field.
+        /// @param id the node ID to set.
+        void set_node_id(NodeID id)
+        {
+            nodeIdLow_ = id & 0xFFFFFFFFu;
+            nodeIdHigh_ = (id >> 32) & 0xFFFFu;
+        }
+
+        /// @return the node ID field.
+        NodeID get_node_id()
+        {
+            uint64_t h = nodeIdHigh_;
+            h <<= 32;
+            h |= nodeIdLow_;
+            return h;
+        }
+
+        /// OpenLCB Node ID low 32 bits. For free entries, the index of the
+        /// next free entry.
+        uint32_t nodeIdLow_;
+        /// OpenLCB Node ID high 16 bits.
+        uint16_t nodeIdHigh_;
+        /// OpenLCB-CAN alias. Zero if this entry is free.
+        NodeAlias alias_;
+    };
+
+    /// Pointer to a member function computing the home slot of a pool entry
+    /// in one of the hash tables.
+    typedef unsigned (HashAliasCache::*HomeFn)(uint16_t idx);
+
+    /// @param alias an alias
+    /// @return the home slot of this alias in aliasTable.
+    unsigned hash_alias(NodeAlias alias)
+    {
+        return (uint32_t(alias) * 0x9E3779B1u) >> hashShift;
+    }
+
+    /// @param id a node ID
+    /// @return the home slot of this node ID in idTable.
+    unsigned hash_id(NodeID id)
+    {
+        uint32_t h = uint32_t(id) ^ (uint32_t(id >> 32) * 0x85EBCA6Bu);
+        return (h * 0x9E3779B1u) >> hashShift;
+    }
+
+    /// @param idx pool index of a used entry @return its home slot in
+    /// aliasTable.
+    unsigned alias_home(uint16_t idx)
+    {
+        return hash_alias(pool[idx].alias_);
+    }
+
+    /// @param idx pool index of a used entry @return its home slot in
+    /// idTable.
+    unsigned id_home(uint16_t idx)
+    {
+        return hash_id(pool[idx].get_node_id());
+    }
+
+    /// Finds where an alias is or would be in aliasTable.
+    /// @param alias the alias to look for
+    /// @return slot that holds alias, or the empty slot where it would go.
+    unsigned find_alias_slot(NodeAlias alias)
+    {
+        unsigned s = hash_alias(alias);
+        while (aliasTable[s] != NONE_ENTRY &&
+            pool[aliasTable[s]].alias_ != alias)
+        {
+            s = (s + 1) & tableMask;
+        }
+        return s;
+    }
+
+    /// Finds where a node ID is or would be in idTable.
+    /// @param id the node ID to look for
+    /// @return slot that holds id, or the empty slot where it would go.
+    unsigned find_id_slot(NodeID id)
+    {
+        unsigned s = hash_id(id);
+        while (idTable[s] != NONE_ENTRY && pool[idTable[s]].get_node_id() != id)
+        {
+            s = (s + 1) & tableMask;
+        }
+        return s;
+    }
+
+    /// Sets the referenced bit for the CLOCK eviction.
+    /// @param idx pool index of the entry that was used.
+    void touch(uint16_t idx)
+    {
+        referenced[idx >> 5] |= 1u << (idx & 31);
+    }
+
+    /// Removes a slot from a hash table and closes the gap in the probe
+    /// sequence behind it.
+    /// @param table aliasTable or idTable
+    /// @param slot the slot to clear
+    /// @param home function computing the home slot of entries in table.
+    void erase_slot(uint16_t *table, unsigned slot, HomeFn home);
+
+    /// Removes an entry from the hash tables and puts it on the freelist.
+    /// @param idx pool index of the entry.
+    void unlink(uint16_t idx);
+
+    /// Finds an entry to evict with the CLOCK algorithm.
+    /// @return pool index of an entry that was not used in the last sweep.
+    uint16_t clock_victim();
+
+    /** pointer to allocated Metadata pool */
+    Metadata *pool;
+
+    /// Hash table of pool indexes keyed by alias.
+    uint16_t *aliasTable;
+
+    /// Hash table of pool indexes keyed by node ID.
+    uint16_t *idTable;
+
+    /// One bit per pool entry, set when the entry was used.
+    uint32_t *referenced;
+
+    /// Number of slots in the hash tables minus one.
+    unsigned tableMask;
+
+    /// 32 - log2(number of slots in the hash tables).
+    unsigned hashShift;
+
+    /// Head of the list of unused pool entries.
+    uint16_t freeList;
+
+    /// Next pool entry to consider for eviction.
+    uint16_t clockHand;
+
+    /** Seed for the generation of the next alias */
+    NodeID seed;
+
+    /** How many metadata entries have we allocated. */
+    size_t entries;
+
+    /** callback function to be used when we remove an entry from the cache */
+    void (*removeCallback)(NodeID id, NodeAlias alias, void *);
+
+    /** context pointer to pass in with remove_callback */
+    void *context;
+
+    DISALLOW_COPY_AND_ASSIGN(HashAliasCache);
+};
+
+} /* namespace openlcb */
+
+#endif // _OPENLCB_HASHALIASCACHE_HXX_
@@ -156,7 +156,7 @@ void send_event(Node* src_node, uint64_t event_id)
 }
 
 
-string EMPTY_PAYLOAD;
+Payload EMPTY_PAYLOAD;
 
 /*Buffer *node_id_to_buffer(NodeID id)
 {
@@ -78,7 +78,7 @@ struct GenMessage
         reset((Defs::MTI)0, 0, EMPTY_PAYLOAD);
     }
 
-    void reset(Defs::MTI mti, NodeID src, NodeHandle dst, string payload)
+    void reset(Defs::MTI mti, NodeID src, NodeHandle dst, Payload payload)
     {
         this->mti = mti;
         this->src = {src, 0};
@@ -89,7 +89,7 @@ struct GenMessage
         this->flagsDst = 0;
     }
 
-    void reset(Defs::MTI mti, NodeID src, string payload)
+    void reset(Defs::MTI mti, NodeID src, Payload payload)
     {
         this->mti = mti;
         this->src = {src, 0};
@@ -109,8 +109,7 @@ struct GenMessage
     /// If the destination node is local, this value is non-NULL.
     Node *dstNode;
     /// Data content in the message body. Owned by the dispatcher.
-    /// @todo(balazs.racz) figure out a better container.
-    string payload;
+    Payload payload;
 
     unsigned flagsSrc : 4;
     unsigned flagsDst : 4;
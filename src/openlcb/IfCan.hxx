@@ -40,8 +40,10 @@
 #include "executor/StateFlow.hxx"
 #include "openlcb/If.hxx"
 #include "openlcb/AliasCache.hxx"
+#include "openlcb/HashAliasCache.hxx"
 #include "openlcb/Defs.hxx"
 #include "utils/CanIf.hxx"
+#include "openmrn_features.h"
 
 namespace openlcb
 {
@@ -55,6 +57,14 @@ extern size_t g_alias_use_conflicts;
 class AliasAllocator;
 class IfCan;
 
+#if OPENMRN_FEATURE_HASH_ALIAS_CACHE
+/// Alias cache implementation used for the remote nodes of an IfCan.
+typedef HashAliasCache RemoteAliasCache;
+#else
+/// Alias cache implementation used for the remote nodes of an IfCan.
+typedef AliasCache RemoteAliasCache;
+#endif
+
 /// Implementation of the OpenLCB interface abstraction for the CAN-bus
 /// interface standard. This contains the parsers for CAN frames, dispatcher
 /// for the different frame types, the alias mapping tables (both local and
@@ -100,7 +110,7 @@ public:
     }
 
     /// @returns the alias cache for remote nodes on this IF
-    AliasCache *remote_aliases()
+    RemoteAliasCache *remote_aliases()
     {
         executor()->assert_current();
         return &remoteAliases_;
@@ -148,7 +158,7 @@ private:
      *
      *  This member must only be accessed from the If's executor.
      */
-    AliasCache remoteAliases_;
+    RemoteAliasCache remoteAliases_;
 
     /// Various implementation control flows that this interface owns.
     std::vector<std::unique_ptr<Executable>> ownedFlows_;
@@ -278,7 +288,7 @@ private:
         ReplyHandler(NodeIdLookupFlow *parent)
             : parent_(parent)
         {
-            parent_->iface()->dispatcher()->register_handler(
+            parent_->iface()->dispatcher()->register_shared_handler(
                 this, Defs::MTI_VERIFIED_NODE_ID_NUMBER, Defs::MTI_EXACT);
         }
 
@@ -329,7 +329,7 @@ public:
     size_t read(address_t source, uint8_t *dst, size_t len, errorcode_t *error,
                 Notifiable *again) OVERRIDE;
 
-private:
+protected:
     /** Makes fd a valid parameter, and ensures fileSize is filled in. */
     void ensure_file_open();
 
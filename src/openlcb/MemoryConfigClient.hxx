@@ -298,6 +298,10 @@ public:
         : CallableFlow<MemoryConfigClientRequest>(memcfg->dg_service())
         , node_(node)
         , memoryConfigHandler_(memcfg)
+        , isWaitingForTimer_(0)
+        , isWindowed_(0)
+        , isQueryingOptions_(0)
+        , haveOptions_(0)
     { }
 
     /// These result codes are written into request()->resultCode during and as
@@ -324,6 +328,30 @@ public:
         return memoryConfigHandler_;
     }
 
+    /// Largest window accepted by set_window().
+    static constexpr unsigned MAX_WINDOW = 16;
+
+    /// How many times a datagram is sent in the pipelined mode before the
+    /// request fails.
+    static constexpr unsigned MAX_SENDS = 3;
+
+    /// Sets how many read or write datagrams may be outstanding at the same
+    /// time. With a window of 1 (the default) each datagram is sent after the
+    /// reply to the previous one arrived, so the throughput is bound by the
+    /// round-trip time. With a larger window (pipelined mode) the next
+    /// requests are sent while the target is still working on the earlier
+    /// ones, the replies are reassembled by address, and datagrams whose
+    /// reply does not arrive in time are sent again. The window shrinks when
+    /// the target rejects a datagram for lack of buffers.
+    ///
+    /// Must not be called while a request is being processed.
+    /// @param window number of outstanding requests, 1 to MAX_WINDOW.
+    void set_window(unsigned window)
+    {
+        HASSERT(window >= 1 && window <= MAX_WINDOW);
+        chunks_.resize(window > 1 ? window : 0);
+    }
+
 protected:
     Action entry() override
     {
@@ -332,9 +360,17 @@ protected:
         {
             case MemoryConfigClientRequest::CMD_READ:
             case MemoryConfigClientRequest::CMD_READ_PART:
+                if (pipelined())
+                {
+                    return call_immediately(STATE(do_window));
+                }
                 return allocate_and_call(
                     STATE(do_read), dg_service()->client_allocator());
             case MemoryConfigClientRequest::CMD_WRITE:
+                if (pipelined())
+                {
+                    return call_immediately(STATE(do_window));
+                }
                 return allocate_and_call(
                     STATE(do_write), dg_service()->client_allocator());
             case MemoryConfigClientRequest::CMD_META_REQUEST:
@@ -712,6 +748,460 @@ private:
             STATE(do_meta_request), dg_service()->client_allocator());
     }
 
+    /// One read or write datagram of the pipelined mode.
+    struct Chunk
+    {
+        enum State : uint8_t
+        {
+            /// Slot is unused.
+            FREE,
+            /// Needs to be sent (again).
+            QUEUED,
+            /// Datagram is being sent.
+            SENT,
+            /// Target accepted the datagram, reply is pending.
+            WAIT_REPLY,
+            /// Reply arrived.
+            DONE
+        };
+
+        /// Address of the first byte.
+        uint32_t address;
+        /// Number of bytes to read or write.
+        uint8_t length;
+        /// One of the State enums.
+        uint8_t state {FREE};
+        /// How many times the datagram was sent.
+        uint8_t sendCount;
+        /// Error code from the reply, 0 on success.
+        uint16_t error;
+        /// When to give up waiting for the reply.
+        long long deadline;
+        /// Data from a read reply.
+        string data;
+    };
+
+    /// @return true if the current pipelined request is a read.
+    bool is_window_read()
+    {
+        return request()->cmd != MemoryConfigClientRequest::CMD_WRITE;
+    }
+
+    /// @param address the first byte of a chunk.
+    /// @return the used chunk starting at address, or nullptr.
+    Chunk *find_chunk(uint32_t address)
+    {
+        for (auto &c : chunks_)
+        {
+            if (c.state != Chunk::FREE && c.address == address)
+            {
+                return &c;
+            }
+        }
+        return nullptr;
+    }
+
+    /// Starts a read or write request in the pipelined mode.
+    Action do_window()
+    {
+        offset_ = request()->address;
+        deliverOffset_ = request()->address;
+        if (!is_window_read())
+        {
+            endOffset_ = request()->address + request()->payload.size();
+        }
+        else if (request()->size == 0xffffffffu)
+        {
+            endOffset_ = 0xffffffffu;
+        }
+        else
+        {
+            endOffset_ = request()->address + request()->size;
+        }
+        for (auto &c : chunks_)
+        {
+            c.state = Chunk::FREE;
+        }
+        windowLimit_ = chunks_.size();
+        isWindowed_ = 1;
+        isWaitingForTimer_ = 0;
+        memoryConfigHandler_->set_client(&responseFlow_);
+        return call_immediately(STATE(window_pump));
+    }
+
+    /// Processes the arrived replies, then sends the next datagram or waits
+    /// for a reply.
+    Action window_pump()
+    {
+        if (is_window_read())
+        {
+            // Hands over the read data in address order.
+            Chunk *c;
+            while (deliverOffset_ < endOffset_ &&
+                (c = find_chunk(deliverOffset_)) != nullptr &&
+                c->state == Chunk::DONE)
+            {
+                c->state = Chunk::FREE;
+                if (c->error == MemoryConfigDefs::ERROR_OUT_OF_BOUNDS)
+                {
+                    endOffset_ = deliverOffset_;
+                    break;
+                }
+                if (c->error)
+                {
+                    return window_error(c->error);
+                }
+                request()->payload.append(c->data);
+                deliverOffset_ += c->data.size();
+                if (c->data.size() < c->length)
+                {
+                    // Short read: end of the memory space.
+                    endOffset_ = deliverOffset_;
+                }
+                if (request()->progressCb)
+                {
+                    request()->progressCb(request());
+                }
+            }
+        }
+        else
+        {
+            for (auto &c : chunks_)
+            {
+                if (c.state != Chunk::DONE)
+                {
+                    continue;
+                }
+                c.state = Chunk::FREE;
+                if (c.error == MemoryConfigDefs::ERROR_OUT_OF_BOUNDS)
+                {
+                    // Nothing more to write after this.
+                    if (c.address < endOffset_)
+                    {
+                        endOffset_ = c.address;
+                    }
+                }
+                else if (c.error)
+                {
+                    return window_error(c.error);
+                }
+            }
+        }
+        long long now = os_get_time_monotonic();
+        long long next_deadline = 0;
+        unsigned busy = 0;
+        Chunk *send = nullptr;
+        for (auto &c : chunks_)
+        {
+            if (c.state == Chunk::FREE)
+            {
+                continue;
+            }
+            if (c.address >= endOffset_)
+            {
+                // Beyond the end of the memory space. A reply that is still
+                // in flight will be ignored.
+                c.state = Chunk::FREE;
+                continue;
+            }
+            if (c.state == Chunk::WAIT_REPLY && c.deadline <= now)
+            {
+                if (c.sendCount >= MAX_SENDS)
+                {
+                    return window_error(Defs::OPENMRN_TIMEOUT);
+                }
+                LOG(VERBOSE, "memcfg client: resending address %u",
+                    (unsigned)c.address);
+                c.state = Chunk::QUEUED;
+            }
+            ++busy;
+            if (c.state == Chunk::QUEUED &&
+                (!send || c.address < send->address))
+            {
+                send = &c;
+            }
+            if (c.state == Chunk::WAIT_REPLY &&
+                (!next_deadline || c.deadline < next_deadline))
+            {
+                next_deadline = c.deadline;
+            }
+        }
+        if (!send && busy < windowLimit_ && offset_ < endOffset_)
+        {
+            for (auto &c : chunks_)
+            {
+                if (c.state == Chunk::FREE)
+                {
+                    send = &c;
+                    break;
+                }
+            }
+            HASSERT(send);
+            send->address = offset_;
+            send->length = std::min(endOffset_ - offset_,
+                (uint32_t)MemoryConfigDefs::MAX_DATAGRAM_RW_BYTES);
+            send->sendCount = 0;
+            send->state = Chunk::QUEUED;
+            offset_ += send->length;
+        }
+        if (send)
+        {
+            sendChunk_ = send;
+            return allocate_and_call(
+                STATE(window_send), dg_service()->client_allocator());
+        }
+        if (!busy)
+        {
+            return window_finish();
+        }
+        HASSERT(next_deadline);
+        isWaitingForTimer_ = 1;
+        return sleep_and_call(
+            &timer_, next_deadline - now, STATE(window_wakeup));
+    }
+
+    /// Called when a reply arrived or the earliest reply timed out.
+    Action window_wakeup()
+    {
+        isWaitingForTimer_ = 0;
+        return call_immediately(STATE(window_pump));
+    }
+
+    /// Got a datagram client for sending sendChunk_.
+    Action window_send()
+    {
+        dgClient_ = full_allocation_result(dg_service()->client_allocator());
+        return allocate_and_call(
+            dg_service()->iface()->dispatcher(), STATE(window_send_datagram));
+    }
+
+    Action window_send_datagram()
+    {
+        auto *b = get_allocation_result(dg_service()->iface()->dispatcher());
+        b->set_done(bn_.reset(this));
+        Chunk *c = sendChunk_;
+        if (is_window_read())
+        {
+            b->data()->reset(Defs::MTI_DATAGRAM, node_->node_id(),
+                request()->dst,
+                MemoryConfigDefs::read_datagram(
+                    request()->memory_space, c->address, c->length));
+        }
+        else
+        {
+            b->data()->reset(Defs::MTI_DATAGRAM, node_->node_id(),
+                request()->dst,
+                MemoryConfigDefs::write_datagram(request()->memory_space,
+                    c->address,
+                    request()->payload.substr(
+                        c->address - request()->address, c->length)));
+        }
+        c->state = Chunk::SENT;
+        ++c->sendCount;
+        dgClient_->write_datagram(b);
+        return wait_and_call(STATE(window_sent));
+    }
+
+    /// The target acknowledged or rejected the datagram of sendChunk_.
+    Action window_sent()
+    {
+        uint32_t result = dgClient_->result();
+        dg_service()->client_allocator()->typed_insert(dgClient_);
+        dgClient_ = nullptr;
+        Chunk *c = sendChunk_;
+        if (c->state != Chunk::SENT)
+        {
+            // The reply has already arrived.
+            return call_immediately(STATE(window_pump));
+        }
+        if (!(result & DatagramClient::OPERATION_SUCCESS))
+        {
+            bool retry = (result & DatagramClient::RESEND_OK) ||
+                (result & DatagramClient::TIMEOUT);
+            if (!retry || c->sendCount >= MAX_SENDS)
+            {
+                return window_error(result);
+            }
+            if (result & DatagramClient::RESEND_OK)
+            {
+                // The target ran out of buffers. Keeps fewer datagrams
+                // outstanding from now on.
+                unsigned outstanding = 0;
+                for (auto &o : chunks_)
+                {
+                    if (o.state == Chunk::WAIT_REPLY)
+                    {
+                        ++outstanding;
+                    }
+                }
+                windowLimit_ = std::max(1u, outstanding);
+            }
+            c->state = Chunk::QUEUED;
+            return call_immediately(STATE(window_pump));
+        }
+        if (!is_window_read() &&
+            !(result & DatagramClient::OK_REPLY_PENDING))
+        {
+            // Write accepted with no reply to come.
+            c->error = 0;
+            c->state = Chunk::DONE;
+        }
+        else
+        {
+            c->state = Chunk::WAIT_REPLY;
+            c->deadline = os_get_time_monotonic() +
+                DatagramDefs::timeout_from_flags_nsec(
+                    result >> DatagramClient::RESPONSE_FLAGS_SHIFT);
+        }
+        return call_immediately(STATE(window_pump));
+    }
+
+    /// Stores a reply datagram of the pipelined mode in its chunk. Called by
+    /// the response flow.
+    /// @param p payload of the reply datagram.
+    void window_reply(const Payload &p)
+    {
+        if (!MemoryConfigDefs::payload_min_length_check(p, 0) ||
+            MemoryConfigDefs::get_space(p) != request()->memory_space)
+        {
+            return;
+        }
+        Chunk *c = find_chunk(MemoryConfigDefs::get_address(p));
+        if (!c || c->state == Chunk::DONE)
+        {
+            LOG(VERBOSE, "memcfg client: unexpected or duplicate reply");
+            return;
+        }
+        const uint8_t *bytes = MemoryConfigDefs::payload_bytes(p);
+        unsigned ofs = MemoryConfigDefs::get_payload_offset(p);
+        unsigned len = p.size();
+        uint8_t cmd = bytes[1] & MemoryConfigDefs::COMMAND_MASK;
+        c->error = 0;
+        c->data.clear();
+        if (cmd == MemoryConfigDefs::COMMAND_READ_FAILED ||
+            cmd == MemoryConfigDefs::COMMAND_WRITE_FAILED)
+        {
+            if (len < ofs + 2)
+            {
+                c->error = Defs::ERROR_INVALID_ARGS_MESSAGE_TOO_SHORT;
+            }
+            else
+            {
+                c->error = (bytes[ofs] << 8) | bytes[ofs + 1];
+            }
+        }
+        else if (cmd == MemoryConfigDefs::COMMAND_READ_REPLY)
+        {
+            unsigned dlen = std::min(len - ofs, (unsigned)c->length);
+            c->data.assign((const char *)bytes + ofs, dlen);
+        }
+        c->state = Chunk::DONE;
+        if (isWaitingForTimer_)
+        {
+            timer_.trigger();
+        }
+    }
+
+    Action window_error(int error)
+    {
+        if (error == MemoryConfigDefs::ERROR_OUT_OF_BOUNDS)
+        {
+            return window_finish();
+        }
+        window_cleanup();
+        return return_with_error(error);
+    }
+
+    Action window_finish()
+    {
+        window_cleanup();
+        return return_ok();
+    }
+
+    void window_cleanup()
+    {
+        isWindowed_ = 0;
+        isWaitingForTimer_ = 0;
+        memoryConfigHandler_->clear_client(&responseFlow_);
+    }
+
+protected:
+    /// @return true if the pipelined mode is enabled.
+    bool pipelined()
+    {
+        return !chunks_.empty();
+    }
+
+    /// @return true if the options of request()->dst are known from an
+    /// earlier query.
+    bool have_options()
+    {
+        return haveOptions_ &&
+            node_->iface()->matching_node(optionsDst_, request()->dst);
+    }
+
+    /// Asks the target node which memory config commands it supports. Sets
+    /// optionsAvailable_ (zero if the target did not answer), then restarts
+    /// the request from entry().
+    Action do_options_query()
+    {
+        dgClient_ = full_allocation_result(dg_service()->client_allocator());
+        isQueryingOptions_ = 1;
+        memoryConfigHandler_->set_client(&responseFlow_);
+        return allocate_and_call(
+            dg_service()->iface()->dispatcher(), STATE(send_options_datagram));
+    }
+
+    Action send_options_datagram()
+    {
+        auto *b = get_allocation_result(dg_service()->iface()->dispatcher());
+        b->set_done(bn_.reset(this));
+        DatagramPayload p;
+        p.push_back(DatagramDefs::CONFIGURATION);
+        p.push_back(MemoryConfigDefs::COMMAND_OPTIONS);
+        b->data()->reset(
+            Defs::MTI_DATAGRAM, node_->node_id(), request()->dst, p);
+        isWaitingForTimer_ = 0;
+        responseCode_ = DatagramClient::OPERATION_PENDING;
+        dgClient_->write_datagram(b);
+        return wait_and_call(STATE(options_dg_complete));
+    }
+
+    Action options_dg_complete()
+    {
+        if ((dgClient_->result() & DatagramClient::OPERATION_SUCCESS) &&
+            (responseCode_ & DatagramClient::OPERATION_PENDING))
+        {
+            isWaitingForTimer_ = 1;
+            long long timeout = DatagramDefs::timeout_from_flags_nsec(
+                dgClient_->result() >> DatagramClient::RESPONSE_FLAGS_SHIFT);
+            return sleep_and_call(&timer_, timeout, STATE(options_done));
+        }
+        return call_immediately(STATE(options_done));
+    }
+
+    Action options_done()
+    {
+        optionsAvailable_ = 0;
+        if (!(responseCode_ & DatagramClient::OPERATION_PENDING) &&
+            responsePayload_.size() >= 4)
+        {
+            const uint8_t *bytes =
+                MemoryConfigDefs::payload_bytes(responsePayload_);
+            optionsAvailable_ = (bytes[2] << 8) | bytes[3];
+        }
+        optionsDst_ = request()->dst;
+        haveOptions_ = 1;
+        isQueryingOptions_ = 0;
+        isWaitingForTimer_ = 0;
+        responsePayload_.clear();
+        dg_service()->client_allocator()->typed_insert(dgClient_);
+        dgClient_ = nullptr;
+        memoryConfigHandler_->clear_client(&responseFlow_);
+        return call_immediately(STATE(entry));
+    }
+
+private:
     class ResponseFlow : public DefaultDatagramHandler
     {
     public:
@@ -738,6 +1228,20 @@ private:
                     Defs::ERROR_INVALID_ARGS_MESSAGE_TOO_SHORT);
             }
             auto *bytes = payload();
+            if (bytes[1] == MemoryConfigDefs::COMMAND_OPTIONS_REPLY)
+            {
+                if (!parent_->isQueryingOptions_)
+                {
+                    return respond_reject(Defs::ERROR_UNIMPLEMENTED_SUBCMD);
+                }
+                parent_->responseCode_ = 0;
+                message()->data()->payload.swap(parent_->responsePayload_);
+                if (parent_->isWaitingForTimer_)
+                {
+                    parent_->timer_.trigger();
+                }
+                return respond_ok(0);
+            }
             uint8_t cmd = bytes[1] & ~3;
             switch (cmd)
             {
@@ -751,6 +1255,11 @@ private:
                     {
                         break;
                     }
+                    if (parent_->isWindowed_)
+                    {
+                        parent_->window_reply(message()->data()->payload);
+                        return respond_ok(0);
+                    }
                     parent_->responseCode_ = 0;
                     message()->data()->payload.swap(parent_->responsePayload_);
                     if (parent_->isWaitingForTimer_)
@@ -788,6 +1297,11 @@ private:
                     {
                         break;
                     }
+                    if (parent_->isWindowed_)
+                    {
+                        parent_->window_reply(message()->data()->payload);
+                        return respond_ok(0);
+                    }
                     parent_->responseCode_ = 0;
                     message()->data()->payload.swap(parent_->responsePayload_);
                     if (parent_->isWaitingForTimer_)
@@ -831,11 +1345,32 @@ protected:
     /// timing helper
     StateFlowTimer timer_ {this};
     /// The data that came back from reading.
-    string responsePayload_;
+    Payload responsePayload_;
     /// error code that came with the response. 0 for success.
     int responseCode_;
+    /// Slots of the outstanding datagrams in the pipelined mode. Empty if the
+    /// pipelined mode is disabled.
+    std::vector<Chunk> chunks_;
+    /// The chunk being sent.
+    Chunk *sendChunk_ {nullptr};
+    /// Next address to hand over from a pipelined read.
+    uint32_t deliverOffset_;
+    /// One past the last address to read or write in the pipelined mode.
+    uint32_t endOffset_;
+    /// How many chunks may be outstanding now. At most chunks_.size().
+    unsigned windowLimit_;
+    /// Node for which optionsAvailable_ is valid.
+    NodeHandle optionsDst_;
+    /// Available commands bits (MemoryConfigDefs::AVAIL_*) of optionsDst_.
+    uint16_t optionsAvailable_ {0};
     /// 1 if we are pending on the timer.
     uint8_t isWaitingForTimer_ : 1;
+    /// 1 if the current request runs in the pipelined mode.
+    uint8_t isWindowed_ : 1;
+    /// 1 if an options query is outstanding.
+    uint8_t isQueryingOptions_ : 1;
+    /// 1 if optionsDst_ and optionsAvailable_ are valid.
+    uint8_t haveOptions_ : 1;
 }; // class MemoryConfigClient
 
 class MemoryConfigClientWithStream : public MemoryConfigClient
@@ -857,6 +1392,20 @@ public:
 protected:
     Action entry() override
     {
+        if (!request()->use_stream && pipelined() &&
+            (request()->cmd == MemoryConfigClientRequest::CMD_READ ||
+                request()->cmd == MemoryConfigClientRequest::CMD_READ_PART))
+        {
+            // In the pipelined mode reads go over a stream if the target
+            // supports it.
+            if (!have_options())
+            {
+                return allocate_and_call(STATE(do_options_query),
+                    dg_service()->client_allocator());
+            }
+            request()->use_stream =
+                (optionsAvailable_ & MemoryConfigDefs::AVAIL_SR) != 0;
+        }
         if (!request()->use_stream)
         {
             return MemoryConfigClient::entry();
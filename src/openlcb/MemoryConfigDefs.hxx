@@ -46,7 +46,7 @@ namespace openlcb
 /// Protocol.
 struct MemoryConfigDefs
 {
-    using DatagramPayload = string;
+    using DatagramPayload = Payload;
 
     /** Possible Commands for a configuration datagram.
      */
@@ -135,9 +135,9 @@ private:
         b->data()->reset(Defs::MTI_PROTOCOL_SUPPORT_INQUIRY, src_->node_id(),
             dst_, EMPTY_PAYLOAD);
 
-        iface()->dispatcher()->register_handler(
+        iface()->dispatcher()->register_shared_handler(
             &responseHandler_, MTI_1, MASK_1);
-        iface()->dispatcher()->register_handler(
+        iface()->dispatcher()->register_shared_handler(
             &responseHandler_, MTI_2, MASK_2);
 
         iface()->addressed_message_write_flow()->send(b);
@@ -0,0 +1,147 @@
+/** \copyright
+ * Copyright (c) 2026, agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * \file Payload.cxx
+ *
+ * Storage management of the OpenLCB message payload container.
+ *
+ * @author agent
+ * @date 17 Oct 2026
+ */
+
+#include "openlcb/Payload.hxx"
+
+#include <algorithm>
+#include <ostream>
+
+namespace openlcb
+{
+
+constexpr size_t Payload::npos;
+constexpr unsigned Payload::INLINE_SIZE;
+
+#ifdef GTEST
+/// Number of buffers allocated for payloads.
+static std::atomic<unsigned> g_payload_allocations {0};
+
+unsigned Payload::num_buffer_allocations()
+{
+    return g_payload_allocations;
+}
+#endif
+
+/// Allocates a buffer for storing a long payload.
+/// @param n how many bytes the buffer needs to hold.
+/// @param capacity will be set to the number of bytes that fit into the
+/// buffer (not counting the terminating zero).
+/// @return the allocated buffer.
+static DataBuffer *alloc_payload_buffer(size_t n, uint32_t *capacity)
+{
+    /// Pools for power of two allocation sizes (including the buffer header)
+    /// from 64 bytes to 32 kbytes, then the largest possible buffer.
+    static DataBufferPool pools[] = {{64 - sizeof(BufferBase)},
+        {128 - sizeof(BufferBase)}, {256 - sizeof(BufferBase)},
+        {512 - sizeof(BufferBase)}, {1024 - sizeof(BufferBase)},
+        {2048 - sizeof(BufferBase)}, {4096 - sizeof(BufferBase)},
+        {8192 - sizeof(BufferBase)}, {16384 - sizeof(BufferBase)},
+        {32768 - sizeof(BufferBase)}, {65535 - sizeof(BufferBase)}};
+    // Payloads may be created before any Service.
+    init_main_buffer_pool();
+    // Space for the terminating zero.
+    ++n;
+    unsigned idx = 0;
+    while (idx < ARRAYSIZE(pools) - 1 &&
+        n > (64u << idx) - sizeof(BufferBase))
+    {
+        ++idx;
+    }
+    DataBufferPool *pool = &pools[idx];
+    DataBuffer *b;
+    pool->alloc(&b);
+    HASSERT(b && n <= b->size());
+    *capacity = b->size() - 1;
+#ifdef GTEST
+    ++g_payload_allocations;
+#endif
+    return b;
+}
+
+void Payload::realloc(size_t n)
+{
+    Payload p;
+    if (n > INLINE_SIZE)
+    {
+        p.buffer_ = alloc_payload_buffer(n, &p.capacity_);
+    }
+    size_t len = std::min(size_t(size_), size_t(p.capacity_));
+    char *dst = p.is_large() ? (char *)p.buffer_->data() : p.inline_;
+    memcpy(dst, data(), len);
+    dst[len] = 0;
+    p.size_ = len;
+    swap(p);
+}
+
+Payload &Payload::append(const char *s, size_t n)
+{
+    size_t need = size_ + n;
+    if (need > capacity_ || is_shared())
+    {
+        if (s >= data() && s < data() + size_)
+        {
+            // Appending a part of ourselves; the storage is about to go away.
+            string tmp(s, n);
+            return append(tmp.data(), n);
+        }
+        realloc(need > capacity_ ? std::max(need, 2 * size_t(size_)) : need);
+    }
+    char *p = mutable_data();
+    memmove(p + size_, s, n);
+    size_ = need;
+    p[size_] = 0;
+    return *this;
+}
+
+Payload &Payload::append(size_t n, char c)
+{
+    size_t need = size_ + n;
+    if (need > capacity_ || is_shared())
+    {
+        realloc(need > capacity_ ? std::max(need, 2 * size_t(size_)) : need);
+    }
+    char *p = mutable_data();
+    memset(p + size_, c, n);
+    size_ = need;
+    p[size_] = 0;
+    return *this;
+}
+
+std::ostream &operator<<(std::ostream &o, const Payload &p)
+{
+    return o.write(p.data(), p.size());
+}
+
+} // namespace openlcb
@@ -26,8 +26,7 @@
  *
  * \file Payload.hxx
  *
- * Forward declaration of the class storing the payload value in an NMRAnet
- * message object.
+ * Container storing the payload value in an NMRAnet message object.
  *
  * @author Balazs Racz
  * @date 18 May 2014
@@ -36,11 +35,545 @@
 #ifndef _OPENLCB_PAYLOAD_HXX_
 #define _OPENLCB_PAYLOAD_HXX_
 
+#include <string.h>
+#include <iosfwd>
 #include <string>
 
+#include "utils/DataBuffer.hxx"
+#include "utils/macros.h"
+
 namespace openlcb {
 
-typedef string Payload;
+/// Container that carries the data bytes in an NMRAnet message.
+///
+/// Payloads of up to INLINE_SIZE bytes (which covers events, node IDs and most
+/// addressed messages) are stored inside the object. Longer payloads are
+/// stored in a DataBuffer allocated from the mainBufferPool. Copying a long
+/// payload only takes a new reference to the same buffer; the bytes are
+/// copied when one of the owners modifies its copy. Pointers obtained from
+/// the non-const accessors are invalidated when the payload is copied.
+///
+/// The interface is a subset of std::string, and the payload converts
+/// implicitly to and from string, so that code written for string payloads
+/// keeps working.
+class Payload
+{
+public:
+    typedef char value_type;
+    typedef size_t size_type;
+    typedef char *iterator;
+    typedef const char *const_iterator;
+
+    /// Returned by find when nothing was found.
+    static constexpr size_t npos = string::npos;
+    /// How many bytes can be stored without allocating a buffer.
+    static constexpr unsigned INLINE_SIZE = 15;
+
+    /// Creates an empty payload.
+    Payload()
+        : size_(0)
+        , capacity_(INLINE_SIZE)
+    {
+        inline_[0] = 0;
+    }
+
+    /// Creates a payload from a zero-terminated string.
+    /// @param s string to copy.
+    Payload(const char *s)
+        : Payload()
+    {
+        append(s, strlen(s));
+    }
+
+    /// Creates a payload from a byte array.
+    /// @param s bytes to copy.
+    /// @param n number of bytes.
+    Payload(const char *s, size_t n)
+        : Payload()
+    {
+        append(s, n);
+    }
+
+    /// Creates a payload with repeated bytes.
+    /// @param n number of bytes.
+    /// @param c value of each byte.
+    Payload(size_t n, char c)
+        : Payload()
+    {
+        append(n, c);
+    }
+
+    /// Creates a payload from a string.
+    /// @param s string to copy.
+    Payload(const string &s)
+        : Payload()
+    {
+        append(s.data(), s.size());
+    }
+
+    /// Copy constructor. Shares the buffer of long payloads.
+    /// @param o payload to copy.
+    Payload(const Payload &o)
+        : size_(o.size_)
+        , capacity_(o.capacity_)
+    {
+        if (o.is_large())
+        {
+            buffer_ = o.buffer_->ref();
+        }
+        else
+        {
+            memcpy(inline_, o.inline_, size_ + 1);
+        }
+    }
+
+    /// Move constructor. Leaves o empty.
+    /// @param o payload to take the contents of.
+    Payload(Payload &&o)
+        : size_(o.size_)
+        , capacity_(o.capacity_)
+    {
+        if (o.is_large())
+        {
+            buffer_ = o.buffer_;
+        }
+        else
+        {
+            memcpy(inline_, o.inline_, size_ + 1);
+        }
+        o.size_ = 0;
+        o.capacity_ = INLINE_SIZE;
+        o.inline_[0] = 0;
+    }
+
+    ~Payload()
+    {
+        if (is_large())
+        {
+            buffer_->unref();
+        }
+    }
+
+    /// Copy assignment. Shares the buffer of long payloads.
+    /// @param o payload to copy.
+    /// @return *this
+    Payload &operator=(const Payload &o)
+    {
+        if (this != &o)
+        {
+            Payload(o).swap(*this);
+        }
+        return *this;
+    }
+
+    /// Move assignment.
+    /// @param o payload to take the contents of.
+    /// @return *this
+    Payload &operator=(Payload &&o)
+    {
+        Payload(std::move(o)).swap(*this);
+        return *this;
+    }
+
+    /// Assignment from a string. @param s string to copy. @return *this
+    Payload &operator=(const string &s)
+    {
+        return assign(s.data(), s.size());
+    }
+
+    /// Assignment from a C string. @param s string to copy. @return *this
+    Payload &operator=(const char *s)
+    {
+        return assign(s, strlen(s));
+    }
+
+    /// @return a string with a copy of the payload bytes.
+    operator string() const
+    {
+        return string(data(), size_);
+    }
+
+    /// @return number of bytes in the payload.
+    size_t size() const
+    {
+        return size_;
+    }
+
+    /// @return number of bytes in the payload.
+    size_t length() const
+    {
+        return size_;
+    }
+
+    /// @return true if the payload has no bytes.
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    /// @return how many bytes fit into the current storage.
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    /// @return pointer to the payload bytes. The bytes are followed by a
+    /// zero.
+    const char *data() const
+    {
+        return is_large() ? (const char *)buffer_->data() : inline_;
+    }
+
+    /// @return pointer to the zero-terminated payload bytes.
+    const char *c_str() const
+    {
+        return data();
+    }
+
+    /// @param i index of a byte. @return the byte at index i.
+    const char &operator[](size_t i) const
+    {
+        return data()[i];
+    }
+
+    /// @param i index of a byte. @return reference to the byte at index i.
+    /// Unshares the storage.
+    char &operator[](size_t i)
+    {
+        return mutable_data()[i];
+    }
+
+    const char *begin() const
+    {
+        return data();
+    }
+
+    const char *end() const
+    {
+        return data() + size_;
+    }
+
+    char *begin()
+    {
+        return mutable_data();
+    }
+
+    char *end()
+    {
+        return mutable_data() + size_;
+    }
+
+    /// @return true if the bytes are shared with another payload.
+    bool is_shared() const
+    {
+        return is_large() && buffer_->references() > 1;
+    }
+
+    /// Removes all bytes.
+    void clear()
+    {
+        if (is_shared())
+        {
+            Payload().swap(*this);
+            return;
+        }
+        size_ = 0;
+        mutable_data()[0] = 0;
+    }
+
+    /// Changes the number of bytes in the payload.
+    /// @param n new size.
+    /// @param c value of the added bytes, if the payload grows.
+    void resize(size_t n, char c = 0)
+    {
+        if (n > size_)
+        {
+            append(n - size_, c);
+        }
+        else
+        {
+            reserve(n);
+            size_ = n;
+            mutable_data()[n] = 0;
+        }
+    }
+
+    /// Ensures that n bytes fit into the storage without reallocation.
+    /// @param n number of bytes.
+    void reserve(size_t n)
+    {
+        if (n > capacity_ || is_shared())
+        {
+            realloc(n);
+        }
+    }
+
+    /// Appends a single byte. @param c the byte to append.
+    void push_back(char c)
+    {
+        reserve(size_ + 1);
+        char *p = mutable_data();
+        p[size_++] = c;
+        p[size_] = 0;
+    }
+
+    /// Removes the last byte.
+    void pop_back()
+    {
+        HASSERT(size_);
+        resize(size_ - 1);
+    }
+
+    /// Appends bytes. @param s bytes to append. @param n how many bytes.
+    /// @return *this
+    Payload &append(const char *s, size_t n);
+
+    /// Appends repeated bytes. @param n how many bytes. @param c the value
+    /// of the bytes. @return *this
+    Payload &append(size_t n, char c);
+
+    /// Appends a zero-terminated string. @param s string to append.
+    /// @return *this
+    Payload &append(const char *s)
+    {
+        return append(s, strlen(s));
+    }
+
+    /// Appends a string. @param s string to append. @return *this
+    Payload &append(const string &s)
+    {
+        return append(s.data(), s.size());
+    }
+
+    /// Appends another payload. @param p payload to append. @return *this
+    Payload &append(const Payload &p)
+    {
+        return append(p.data(), p.size());
+    }
+
+    /// Appends part of a string.
+    /// @param s string to append from
+    /// @param pos first byte to append
+    /// @param n max number of bytes to append
+    /// @return *this
+    Payload &append(const string &s, size_t pos, size_t n = npos)
+    {
+        HASSERT(pos <= s.size());
+        return append(s.data() + pos, std::min(n, s.size() - pos));
+    }
+
+    /// Appends a byte. @param c byte to append. @return *this
+    Payload &operator+=(char c)
+    {
+        push_back(c);
+        return *this;
+    }
+
+    /// Appends a string. @param s string to append. @return *this
+    Payload &operator+=(const string &s)
+    {
+        return append(s.data(), s.size());
+    }
+
+    /// Appends a string. @param s string to append. @return *this
+    Payload &operator+=(const char *s)
+    {
+        return append(s, strlen(s));
+    }
+
+    /// Appends a payload. @param p payload to append. @return *this
+    Payload &operator+=(const Payload &p)
+    {
+        return append(p.data(), p.size());
+    }
+
+    /// Replaces the contents. @param s bytes to copy. @param n how many
+    /// bytes. @return *this
+    Payload &assign(const char *s, size_t n)
+    {
+        clear();
+        return append(s, n);
+    }
+
+    /// Replaces the contents. @param n how many bytes. @param c value of the
+    /// bytes. @return *this
+    Payload &assign(size_t n, char c)
+    {
+        clear();
+        return append(n, c);
+    }
+
+    /// Replaces the contents. @param s string to copy. @return *this
+    Payload &assign(const string &s)
+    {
+        return assign(s.data(), s.size());
+    }
+
+    /// Replaces the contents with part of a string.
+    /// @param s string to copy from
+    /// @param pos first byte to copy
+    /// @param n max number of bytes to copy
+    /// @return *this
+    Payload &assign(const string &s, size_t pos, size_t n = npos)
+    {
+        clear();
+        return append(s, pos, n);
+    }
+
+    /// @param pos first byte
+    /// @param n max number of bytes
+    /// @return a copy of a range of bytes.
+    string substr(size_t pos = 0, size_t n = npos) const
+    {
+        HASSERT(pos <= size_);
+        return string(data() + pos, std::min(n, size_ - pos));
+    }
+
+    /// Searches for a byte.
+    /// @param c byte to look for
+    /// @param pos where to start the search
+    /// @return index of the first c at or after pos, or npos if not found.
+    size_t find(char c, size_t pos = 0) const
+    {
+        if (pos >= size_)
+        {
+            return npos;
+        }
+        const void *p = memchr(data() + pos, c, size_ - pos);
+        return p ? (const char *)p - data() : npos;
+    }
+
+    /// Compares the bytes to a byte array.
+    /// @param s bytes to compare to
+    /// @param n number of bytes in s
+    /// @return true if the payload equals the bytes.
+    bool equals(const char *s, size_t n) const
+    {
+        return n == size_ && memcmp(data(), s, n) == 0;
+    }
+
+    /// Exchanges the contents of two payloads. @param o other payload.
+    void swap(Payload &o)
+    {
+        // The union members are trivially copyable.
+        Payload *a = this;
+        char tmp[sizeof(Payload)];
+        memcpy(tmp, (void *)a, sizeof(Payload));
+        memcpy((void *)a, (void *)&o, sizeof(Payload));
+        memcpy((void *)&o, tmp, sizeof(Payload));
+    }
+
+#ifdef GTEST
+    /// @return how many buffers were allocated for payloads so far.
+    static unsigned num_buffer_allocations();
+#endif
+
+private:
+    /// @return true if the bytes are in buffer_.
+    bool is_large() const
+    {
+        return capacity_ > INLINE_SIZE;
+    }
+
+    /// @return writable pointer to the payload bytes. Unshares the storage.
+    char *mutable_data()
+    {
+        if (!is_large())
+        {
+            return inline_;
+        }
+        if (buffer_->references() > 1)
+        {
+            realloc(size_);
+        }
+        return (char *)buffer_->data();
+    }
+
+    /// Moves the contents into a newly allocated, unshared buffer.
+    /// @param n the new buffer will fit at least this many bytes.
+    void realloc(size_t n);
+
+    /// Number of bytes in the payload.
+    uint32_t size_;
+    /// Number of bytes that fit into the current storage, not counting the
+    /// terminating zero. INLINE_SIZE means inline_ is in use.
+    uint32_t capacity_;
+    union
+    {
+        /// Storage for short payloads.
+        char inline_[INLINE_SIZE + 1];
+        /// Storage for long payloads. The data is terminated by a zero.
+        DataBuffer *buffer_;
+    };
+};
+
+inline bool operator==(const Payload &a, const Payload &b)
+{
+    return a.equals(b.data(), b.size());
+}
+
+inline bool operator==(const Payload &a, const string &b)
+{
+    return a.equals(b.data(), b.size());
+}
+
+inline bool operator==(const string &a, const Payload &b)
+{
+    return b.equals(a.data(), a.size());
+}
+
+inline bool operator==(const Payload &a, const char *b)
+{
+    return a.equals(b, strlen(b));
+}
+
+inline bool operator==(const char *a, const Payload &b)
+{
+    return b.equals(a, strlen(a));
+}
+
+template <class T> bool operator!=(const Payload &a, const T &b)
+{
+    return !(a == b);
+}
+
+inline bool operator!=(const string &a, const Payload &b)
+{
+    return !(b == a);
+}
+
+inline bool operator!=(const char *a, const Payload &b)
+{
+    return !(b == a);
+}
+
+/// Orders payloads bytewise, like string. @param a left side @param b right
+/// side. @return true if a < b.
+inline bool operator<(const Payload &a, const Payload &b)
+{
+    int r = memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+    return r < 0 || (r == 0 && a.size() < b.size());
+}
+
+/// Concatenates a payload and a string. @param a first part. @param b second
+/// part. @return the concatenation.
+inline string operator+(const Payload &a, const string &b)
+{
+    return string(a) + b;
+}
+
+/// Concatenates a string and a payload. @param a first part. @param b second
+/// part. @return the concatenation.
+inline string operator+(const string &a, const Payload &b)
+{
+    return a + string(b);
+}
+
+/// Prints the payload bytes to a stream, like a string.
+/// @param o stream to print to.
+/// @param p payload to print.
+/// @return o
+std::ostream &operator<<(std::ostream &o, const Payload &p);
 
 } // namespace openlcb
 
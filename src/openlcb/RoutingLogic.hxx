@@ -36,12 +36,16 @@
 #ifndef _OPENLCB_ROUTNGLOGIC_HXX_
 #define _OPENLCB_ROUTNGLOGIC_HXX_
 
-#include <set>
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <sched.h>
 #include <unordered_map>
+#include <vector>
 
 #include "os/OS.hxx"
 #include "openlcb/EventHandler.hxx"
+#include "utils/logging.h"
 
 namespace openlcb
 {
@@ -57,15 +61,433 @@ namespace openlcb
  */
 uint8_t event_range_to_bit_count(EventId *event);
 
+/** Concurrent map from node addresses to ports.
+ *
+ * Lookups are wait-free: they never take a lock and finish in a bounded
+ * number of steps even while the table is being modified. Writers take a
+ * per-shard mutex. The common case of a writer, refreshing an address that is
+ * already mapped to the same port, is lock-free as well.
+ *
+ * Each shard is an open-addressed hash table. Slots are filled once and never
+ * reused, therefore a reader that found its key in a slot sees either the
+ * current port or nullptr. When a shard needs to grow or drop its deleted
+ * slots, a new table is built and published, and the old one is freed after
+ * all readers that could see it have left (a grace period, tracked by two
+ * reader counters per shard). The same grace period is used when a port is
+ * removed, so that no lookup in flight returns a removed port
+ * after clear_value() returns.
+ *
+ * Entries carry the time they were last refreshed, for aging and for
+ * least-recently-seen eviction when the table is full.
+ *
+ * @param Address is an integer type of at most 63 bits of actual value.
+ * @param Port is the value type; the map stores pointers to it.
+ */
+template <typename Address, class Port> class ConcurrentAddressMap
+{
+public:
+    /// Constructor. @param max_entries limit on the number of live entries.
+    /// Each shard gets an equal part of it, thus an insert may evict an entry
+    /// before the whole map is full. The limit is at least one entry per
+    /// shard.
+    ConcurrentAddressMap(unsigned max_entries)
+    {
+        for (unsigned i = 0; i < NUM_SHARDS; ++i)
+        {
+            shards_[i].table_ = new Table(MIN_SLOTS);
+            // The shard limits add up to max_entries.
+            shards_[i].maxLive_ =
+                std::max(1u, (max_entries + NUM_SHARDS - 1 - i) / NUM_SHARDS);
+        }
+    }
+
+    ~ConcurrentAddressMap()
+    {
+        for (auto &s : shards_)
+        {
+            delete s.table_.load();
+        }
+    }
+
+    /// Looks up an address. Wait-free. @param address key to look up.
+    /// @return the port the address was last seen on, or nullptr.
+    Port *lookup(Address address)
+    {
+        uint64_t hash = hash_of(address);
+        Shard *s = shard_for(hash);
+        ReadGuard g(s);
+        Slot *slot = find(s->table_.load(), key_of(address), hash);
+        return slot ? slot->port_.load() : nullptr;
+    }
+
+    /// Maps an address to a port, and marks it as recently seen.
+    /// @param address key. @param port value.
+    void insert(Address address, Port *port)
+    {
+        uint64_t key = key_of(address);
+        uint64_t hash = hash_of(address);
+        Shard *s = shard_for(hash);
+        uint32_t now = now_sec();
+        {
+            ReadGuard g(s);
+            Slot *slot = find(s->table_.load(), key, hash);
+            if (slot && slot->port_.load(std::memory_order_relaxed) == port)
+            {
+                if (slot->seen_.load(std::memory_order_relaxed) != now)
+                {
+                    slot->seen_.store(now, std::memory_order_relaxed);
+                }
+                return;
+            }
+        }
+        OSMutexLock l(&s->lock_);
+        Table *t = s->table_.load();
+        Slot *slot = find(t, key, hash);
+        if (slot)
+        {
+            slot->port_.store(port);
+            slot->seen_.store(now, std::memory_order_relaxed);
+            return;
+        }
+        if (t->live_ >= s->maxLive_)
+        {
+            evict_oldest_locked(t);
+        }
+        if ((t->used_ + 1) * 4 > (t->mask_ + 1) * 3)
+        {
+            // Too full: rebuild, growing if there are many live entries.
+            unsigned slots = t->mask_ + 1;
+            while ((t->live_ + 1) * 2 > slots)
+            {
+                slots *= 2;
+            }
+            t = rebuild_locked(s, slots);
+        }
+        // We are the only writer; find the first empty slot in the chain.
+        // Deleted slots are not reused, so that a key of a slot never changes
+        // under a reader, except to DELETED. They get dropped by the next
+        // rebuild.
+        for (unsigned i = hash & t->mask_;; i = (i + 1) & t->mask_)
+        {
+            uint64_t k = t->slots_[i].key_.load(std::memory_order_relaxed);
+            if (k == EMPTY)
+            {
+                ++t->used_;
+                ++t->live_;
+                t->slots_[i].seen_.store(now, std::memory_order_relaxed);
+                t->slots_[i].key_.store(key);
+                t->slots_[i].port_.store(port);
+                return;
+            }
+        }
+    }
+
+    /// Replaces a port with nullptr in all entries. When this function
+    /// returns, no lookup will return the port any more. @param port the
+    /// port to remove.
+    void clear_value(Port *port)
+    {
+        for (auto &s : shards_)
+        {
+            OSMutexLock l(&s.lock_);
+            Table *t = s.table_.load();
+            for (unsigned i = 0; i <= t->mask_; ++i)
+            {
+                Slot &slot = t->slots_[i];
+                if (slot.port_.load(std::memory_order_relaxed) == port)
+                {
+                    slot.port_.store(nullptr);
+                }
+            }
+            wait_for_readers_locked(&s);
+        }
+    }
+
+    /// Removes entries that have not been seen for a given time.
+    /// @param max_age_sec maximum age in seconds.
+    void age(unsigned max_age_sec)
+    {
+        uint32_t now = now_sec();
+        for (auto &s : shards_)
+        {
+            OSMutexLock l(&s.lock_);
+            Table *t = s.table_.load();
+            for (unsigned i = 0; i <= t->mask_; ++i)
+            {
+                Slot &slot = t->slots_[i];
+                uint64_t k = slot.key_.load(std::memory_order_relaxed);
+                if (k != EMPTY && k != DELETED &&
+                    now - slot.seen_.load(std::memory_order_relaxed) >
+                        max_age_sec)
+                {
+                    remove_slot_locked(t, &slot);
+                }
+            }
+        }
+    }
+
+    /// @return the number of live entries. Only for tests and statistics.
+    unsigned size()
+    {
+        unsigned ret = 0;
+        for (auto &s : shards_)
+        {
+            OSMutexLock l(&s.lock_);
+            ret += s.table_.load()->live_;
+        }
+        return ret;
+    }
+
+private:
+    /// Number of independent shards. Must be a power of two.
+    static constexpr unsigned NUM_SHARDS = 16;
+    /// Initial number of slots in a shard's table.
+    static constexpr unsigned MIN_SLOTS = 16;
+    /// Key of a slot that was never used. Terminates a probe chain.
+    static constexpr uint64_t EMPTY = 0;
+    /// Key of a slot whose entry was removed. Does not terminate a probe
+    /// chain.
+    static constexpr uint64_t DELETED = ~UINT64_C(0);
+
+    /// One entry of the hash table.
+    struct Slot
+    {
+        /// Encoded address, or EMPTY or DELETED.
+        std::atomic<uint64_t> key_ {EMPTY};
+        /// Where the address was seen.
+        std::atomic<Port *> port_ {nullptr};
+        /// When the address was seen last, in now_sec() units.
+        std::atomic<uint32_t> seen_ {0};
+    };
+
+    /// Open-addressed hash table with linear probing.
+    struct Table
+    {
+        /// @param slots number of slots, a power of two.
+        Table(unsigned slots)
+            : mask_(slots - 1)
+            , slots_(new Slot[slots])
+        {
+        }
+
+        /// Number of slots - 1.
+        unsigned mask_;
+        /// Number of slots that are not EMPTY. Written under the shard lock.
+        unsigned used_ {0};
+        /// Number of slots with a live entry. Written under the shard lock.
+        unsigned live_ {0};
+        /// The slots.
+        std::unique_ptr<Slot[]> slots_;
+    };
+
+    /// A part of the map that has its own table and writer lock.
+    struct Shard
+    {
+        /// Current table.
+        std::atomic<Table *> table_ {nullptr};
+        /// Which reader counter new readers use.
+        std::atomic<unsigned> epoch_ {0};
+        /// Number of readers inside the shard, per epoch parity.
+        std::atomic<unsigned> readers_[2];
+        /// Serializes the writers.
+        OSMutex lock_;
+        /// Limit of the live entries in this shard.
+        unsigned maxLive_ {1};
+
+        Shard()
+        {
+            readers_[0] = 0;
+            readers_[1] = 0;
+        }
+    };
+
+    /// Marks a reader as active in a shard for the scope of this object.
+    class ReadGuard
+    {
+    public:
+        /// @param s shard to read from.
+        ReadGuard(Shard *s)
+            : counter_(&s->readers_[s->epoch_.load() & 1])
+        {
+            counter_->fetch_add(1);
+        }
+
+        ~ReadGuard()
+        {
+            counter_->fetch_sub(1);
+        }
+
+    private:
+        /// The counter we incremented.
+        std::atomic<unsigned> *counter_;
+    };
+
+    /// @return the encoded key. @param address node address.
+    static uint64_t key_of(Address address)
+    {
+        return static_cast<uint64_t>(address) + 1;
+    }
+
+    /// @return a well-mixed hash of the address. @param address node
+    /// address.
+    static uint64_t hash_of(Address address)
+    {
+        uint64_t h = static_cast<uint64_t>(address) * UINT64_C(0x9E3779B97F4A7C15);
+        return h ^ (h >> 29);
+    }
+
+    /// @return the shard for a hash value. @param hash from hash_of().
+    Shard *shard_for(uint64_t hash)
+    {
+        return &shards_[hash >> 60 & (NUM_SHARDS - 1)];
+    }
+
+    /// @return the current time in coarse units of about a second.
+    static uint32_t now_sec()
+    {
+        return static_cast<uint32_t>(os_get_time_monotonic() >> 30);
+    }
+
+    /// Finds the slot of a key. @param t table. @param key encoded key.
+    /// @param hash hash of the key. @return the slot, or nullptr if not
+    /// found.
+    static Slot *find(Table *t, uint64_t key, uint64_t hash)
+    {
+        unsigned mask = t->mask_;
+        for (unsigned i = hash & mask, n = 0; n <= mask; i = (i + 1) & mask, ++n)
+        {
+            uint64_t k = t->slots_[i].key_.load();
+            if (k == key)
+            {
+                return &t->slots_[i];
+            }
+            if (k == EMPTY)
+            {
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    /// Removes an entry. @param t table. @param slot a live slot of t.
+    void remove_slot_locked(Table *t, Slot *slot)
+    {
+        slot->port_.store(nullptr);
+        slot->key_.store(DELETED);
+        --t->live_;
+    }
+
+    /// Removes the least recently seen entry of a table. @param t table.
+    void evict_oldest_locked(Table *t)
+    {
+        uint32_t now = now_sec();
+        Slot *oldest = nullptr;
+        uint32_t oldest_age = 0;
+        for (unsigned i = 0; i <= t->mask_; ++i)
+        {
+            Slot &slot = t->slots_[i];
+            uint64_t k = slot.key_.load(std::memory_order_relaxed);
+            if (k == EMPTY || k == DELETED)
+            {
+                continue;
+            }
+            uint32_t age = now - slot.seen_.load(std::memory_order_relaxed);
+            if (!oldest || age > oldest_age)
+            {
+                oldest = &slot;
+                oldest_age = age;
+            }
+        }
+        if (oldest)
+        {
+            remove_slot_locked(t, oldest);
+        }
+    }
+
+    /// Replaces the table of a shard with a new one that has only the live
+    /// entries. @param s shard. @param slots size of the new table. @return
+    /// the new table.
+    Table *rebuild_locked(Shard *s, unsigned slots)
+    {
+        Table *old = s->table_.load();
+        Table *t = new Table(slots);
+        for (unsigned i = 0; i <= old->mask_; ++i)
+        {
+            Slot &from = old->slots_[i];
+            uint64_t k = from.key_.load(std::memory_order_relaxed);
+            if (k == EMPTY || k == DELETED)
+            {
+                continue;
+            }
+            unsigned j = hash_of(static_cast<Address>(k - 1)) & t->mask_;
+            while (t->slots_[j].key_.load(std::memory_order_relaxed) != EMPTY)
+            {
+                j = (j + 1) & t->mask_;
+            }
+            Slot &to = t->slots_[j];
+            to.key_.store(k, std::memory_order_relaxed);
+            to.port_.store(from.port_.load(), std::memory_order_relaxed);
+            to.seen_.store(from.seen_.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+            ++t->used_;
+            ++t->live_;
+        }
+        s->table_.store(t);
+        wait_for_readers_locked(s);
+        delete old;
+        return t;
+    }
+
+    /// Waits until every reader that might have seen the state before the
+    /// call has left the shard. @param s shard, locked by the caller.
+    static void wait_for_readers_locked(Shard *s)
+    {
+        // Two flips, so that a reader that picked up the epoch just before a
+        // flip is still waited for.
+        for (int i = 0; i < 2; ++i)
+        {
+            unsigned old = s->epoch_.fetch_add(1) & 1;
+            while (s->readers_[old].load() != 0)
+            {
+                sched_yield();
+            }
+        }
+    }
+
+    /// The shards.
+    Shard shards_[NUM_SHARDS];
+
+    DISALLOW_COPY_AND_ASSIGN(ConcurrentAddressMap);
+};
+
 /** Routing table for gateways and routers in OpenLCB.
  *
  * The routing table contains which direction to send addressed packets as well
  * as filters for the event IDs that have listeners in a given port.
+ *
+ * The event filters of all ports are kept in one index. Each port gets a bit
+ * in a PortMask; the index maps every registered event ID or event range to
+ * the mask of ports that are interested in it. A routing decision for an event
+ * report is then a single lookup that returns the set of destination ports:
+ * one binary search in the sorted array of individual events, and one binary
+ * search for each distinct range size that is registered.
  */
 template <class Port, typename Address> class RoutingLogic
 {
 public:
-    RoutingLogic()
+    /// Set of ports, one bit per port.
+    typedef uint64_t PortMask;
+
+    /// How many ports can have a bit in the PortMask. Ports beyond this limit
+    /// get no filtering; all event reports are forwarded to them.
+    static constexpr unsigned MAX_FILTERED_PORTS = 64;
+
+    /// Constructor.
+    /// @param max_addresses limit on how many node addresses to
+    /// remember. When the table is full, the least recently seen addresses
+    /// are evicted.
+    RoutingLogic(unsigned max_addresses = 4096)
+        : addressRoutingTable_(max_addresses)
     {
     }
     ~RoutingLogic()
@@ -79,20 +501,25 @@ public:
      */
     void remove_port(Port *port)
     {
-        OSMutexLock l(&lock_);
-        eventRoutingTable_.erase(port);
-        // Removing entries from a hashmap invalidates an iterator, thus it is
-        // safer to null them out than actually remove. Having a null value
-        // will cause address lookup to return null for a node that has not
-        // been seen since then elsewhere, which is exactly the behavior we
-        // want.
-        for (auto &it : addressRoutingTable_)
-        {
-            if (it.second == port)
+        {
+            OSMutexLock l(&lock_);
+            auto pit = portBits_.find(port);
+            if (pit != portBits_.end())
             {
-                it.second = nullptr;
+                unsigned bit = pit->second;
+                portBits_.erase(pit);
+                if (bit < MAX_FILTERED_PORTS)
+                {
+                    freeBits_ |= PortMask(1) << bit;
+                    clear_port_bit(~(PortMask(1) << bit));
+                }
             }
         }
+        // The address entries are nulled out rather than removed. Having a
+        // null value will cause address lookup to return null for a node that
+        // has not been seen since then elsewhere, which is exactly the
+        // behavior we want. Aging will clean them up eventually.
+        addressRoutingTable_.clear_value(port);
     }
 
     /** Declares that a given node ID is reachable via a specific port. Used
@@ -104,8 +531,7 @@ public:
      */
     void add_node_id_to_route(Port *port, Address source)
     {
-        OSMutexLock l(&lock_);
-        addressRoutingTable_[source] = port;
+        addressRoutingTable_.insert(source, port);
     }
 
     /** Looks up which port an addressed packet should be sent to.
@@ -117,11 +543,17 @@ public:
      */
     Port *lookup_port_for_address(Address dest)
     {
-        OSMutexLock l(&lock_);
-        auto it = addressRoutingTable_.find(dest);
-        if (it == addressRoutingTable_.end())
-            return nullptr;
-        return it->second;
+        return addressRoutingTable_.lookup(dest);
+    }
+
+    /** Removes the addresses that have not been seen for a while. Should be
+     * called periodically to keep the routing table small on large layouts.
+     *
+     * @param max_age_sec entries that were not refreshed by
+     * add_node_id_to_route in this many seconds are removed. */
+    void age_addresses(unsigned max_age_sec)
+    {
+        addressRoutingTable_.age(max_age_sec);
     }
 
     /** Declares that there is a consumer for the given event ID on the given
@@ -133,7 +565,11 @@ public:
     void register_consumer(Port *port, EventId event)
     {
         OSMutexLock l(&lock_);
-        eventRoutingTable_[port].registeredConsumers_[0].insert(event);
+        PortMask bit = port_bit_locked(port);
+        if (bit)
+        {
+            add_to_array(&events_, event, bit);
+        }
     }
 
     /** Declares that there is a consumer for the given event ID range on the
@@ -146,8 +582,18 @@ public:
     {
         OSMutexLock l(&lock_);
         uint8_t bit_count = event_range_to_bit_count(&encoded_range);
-        eventRoutingTable_[port].registeredConsumers_[bit_count].insert(
-            encoded_range);
+        PortMask bit = port_bit_locked(port);
+        if (!bit)
+        {
+            return;
+        }
+        if (bit_count >= 64)
+        {
+            allEventsPorts_ |= bit;
+            return;
+        }
+        add_to_array(&ranges_[bit_count], encoded_range, bit);
+        rangeSizes_ |= UINT64_C(1) << bit_count;
     }
 
     /** Declares that there is a producer for the given event ID on the given
@@ -176,6 +622,62 @@ public:
         register_consumer_range(port, encoded_range);
     }
 
+    /** Computes which ports a PCER message should be forwarded to.
+     *
+     * @param event is the event ID from the PCER message.
+     *
+     * @return the set of ports that have a consumer for the given event. Use
+     * port_in_mask() to test individual ports. */
+    PortMask lookup_pcer(EventId event)
+    {
+        OSMutexLock l(&lock_);
+        PortMask ret = allEventsPorts_ | find_in_array(events_, event);
+        uint64_t sizes = rangeSizes_;
+        while (sizes)
+        {
+            unsigned bit_count = __builtin_ctzll(sizes);
+            sizes &= sizes - 1;
+            EventId masked_range = event & ~((UINT64_C(1) << bit_count) - 1);
+            ret |= find_in_array(ranges_[bit_count], masked_range);
+        }
+        return ret;
+    }
+
+    /** Returns the bit of a port in the PortMask, allocating one if this is a
+     * new port. The bit stays the same until remove_port() is called.
+     *
+     * @param port is the port to query.
+     *
+     * @return the port's bit, or 0 if the port has no bit because there are
+     * too many ports; such ports get all event reports. */
+    PortMask port_bit(Port *port)
+    {
+        OSMutexLock l(&lock_);
+        return port_bit_locked(port);
+    }
+
+    /** Checks if a port is in the result of lookup_pcer().
+     *
+     * @param port is the port to query.
+     * @param mask is the return value of lookup_pcer().
+     *
+     * @return true if the event should be forwarded to the given port. */
+    bool port_in_mask(Port *port, PortMask mask)
+    {
+        OSMutexLock l(&lock_);
+        auto it = portBits_.find(port);
+        if (it == portBits_.end())
+        {
+            return false;
+        }
+        if (it->second >= MAX_FILTERED_PORTS)
+        {
+            // No filtering for this port.
+            return true;
+        }
+        return (mask >> it->second) & 1;
+    }
+
     /** Checks if a given PCER message should be forwarded to the given port.
      *
      * @param port is the port to query.
@@ -184,53 +686,143 @@ public:
      * @return true if the given event has a consumer on the given port. */
     bool check_pcer(Port *port, EventId event)
     {
-        OSMutexLock l(&lock_);
-        auto ip = eventRoutingTable_.find(port);
-        if (ip == eventRoutingTable_.end())
+        return port_in_mask(port, lookup_pcer(event));
+    }
+
+private:
+    /// One entry of the event index.
+    struct EventEntry
+    {
+        /// Event ID, or the base of the range (with the mask bits cleared).
+        EventId event;
+        /// Ports that have registered this event or range.
+        PortMask ports;
+
+        /// Sort order. @param e event to compare to.
+        bool operator<(EventId e) const
         {
-            return false;
+            return event < e;
+        }
+    };
+
+    /// Sorted by event ID.
+    typedef std::vector<EventEntry> EventArray;
+
+    /// @return the bit for a given port, allocating one if this is a new
+    /// port. Returns 0 if the port has no bit (too many ports).
+    /// @param port the port to look up.
+    PortMask port_bit_locked(Port *port)
+    {
+        auto it = portBits_.find(port);
+        unsigned bit;
+        if (it != portBits_.end())
+        {
+            bit = it->second;
         }
-        for (auto im = ip->second.registeredConsumers_.begin();
-             im != ip->second.registeredConsumers_.end(); ++im)
+        else if (freeBits_)
         {
-            if (im->first == 0)
-            {
-                if (im->second.find(event) != im->second.end())
-                    return true;
-            }
-            else if (im->first == 64)
+            bit = __builtin_ctzll(freeBits_);
+            freeBits_ &= freeBits_ - 1;
+            portBits_[port] = bit;
+        }
+        else
+        {
+            LOG(WARNING, "RoutingLogic: too many ports, event filtering is "
+                         "disabled for port %p",
+                port);
+            bit = MAX_FILTERED_PORTS;
+            portBits_[port] = bit;
+        }
+        if (bit >= MAX_FILTERED_PORTS)
+        {
+            return 0;
+        }
+        return PortMask(1) << bit;
+    }
+
+    /// Adds a port to an entry in the index. @param array index to modify.
+    /// @param event key of the entry. @param bit port to add.
+    static void add_to_array(EventArray *array, EventId event, PortMask bit)
+    {
+        auto it = std::lower_bound(array->begin(), array->end(), event);
+        if (it != array->end() && it->event == event)
+        {
+            it->ports |= bit;
+        }
+        else
+        {
+            array->insert(it, EventEntry {event, bit});
+        }
+    }
+
+    /// @return the ports for a given key, or 0 if not found. @param array
+    /// index to search. @param event key to search for.
+    static PortMask find_in_array(const EventArray &array, EventId event)
+    {
+        auto it = std::lower_bound(array.begin(), array.end(), event);
+        if (it != array.end() && it->event == event)
+        {
+            return it->ports;
+        }
+        return 0;
+    }
+
+    /// Removes a port from every entry of the index. @param keep mask with
+    /// the port's bit cleared.
+    void clear_port_bit(PortMask keep)
+    {
+        allEventsPorts_ &= keep;
+        clear_port_bit(&events_, keep);
+        for (unsigned i = 0; i < 64; ++i)
+        {
+            if (rangeSizes_ & (UINT64_C(1) << i))
             {
-                if (!im->second.empty())
-                    return true;
+                clear_port_bit(&ranges_[i], keep);
+                if (ranges_[i].empty())
+                {
+                    rangeSizes_ &= ~(UINT64_C(1) << i);
+                }
             }
-            else
+        }
+    }
+
+    /// Removes a port from every entry of an array. @param array index to
+    /// modify. @param keep mask with the port's bit cleared.
+    static void clear_port_bit(EventArray *array, PortMask keep)
+    {
+        auto out = array->begin();
+        for (auto it = array->begin(); it != array->end(); ++it)
+        {
+            it->ports &= keep;
+            if (it->ports)
             {
-                EventId masked_range =
-                    event & ~((UINT64_C(1) << im->first) - 1);
-                if (im->second.find(masked_range) != im->second.end())
-                    return true;
+                *out++ = *it;
             }
         }
-        return false;
+        array->erase(out, array->end());
     }
 
-private:
-    /// Protects all internal data structures.
+    /// Protects the event routing data structures.
     OSMutex lock_;
 
     /// Stores all known addresses and which port they route to.
-    std::unordered_map<Address, Port *> addressRoutingTable_;
+    ConcurrentAddressMap<Address, Port> addressRoutingTable_;
 
-    /// The per-port event information.
-    struct EventSet
-    {
-        /// key: number of bits set in the mask part. Valid values:
-        /// 0..64. Value of 0 means individual event.
-        std::map<uint8_t, std::set<EventId>> registeredConsumers_;
-    };
+    /// Which bit of the PortMask belongs to which port. A value of
+    /// MAX_FILTERED_PORTS means the port has no bit.
+    std::unordered_map<Port *, unsigned> portBits_;
+    /// Bits of the PortMask that are not assigned to any port.
+    PortMask freeBits_ {~PortMask(0)};
 
-    /// Stores per-port event information.
-    std::map<Port *, EventSet> eventRoutingTable_;
+    /// Individual events.
+    EventArray events_;
+    /// Event ranges, indexed by the number of mask bits (1..63). The keys
+    /// have the mask bits cleared.
+    EventArray ranges_[64];
+    /// Bit i is set if ranges_[i] is not empty.
+    uint64_t rangeSizes_ {0};
+    /// Ports that registered the range covering all events.
+    PortMask allEventsPorts_ {0};
 };
 
 } // namespace openlcb
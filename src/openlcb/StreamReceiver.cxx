@@ -72,7 +72,7 @@ void StreamReceiverCan::send(Buffer<StreamReceiveRequest> *msg, unsigned prio)
         request()->localStreamId_ = assignedStreamId_;
     }
 
-    if (!request()->target_)
+    if (!request()->target_ && !request()->linkedTarget_)
     {
         // asking for stream ID.
         request()->localStreamId_ = assignedStreamId_;
@@ -147,8 +147,59 @@ void StreamReceiverCan::handle_stream_initiate(Buffer<GenMessage> *message)
     notify();
 }
 
+void StreamReceiverCan::consume_window(size_t len)
+{
+    totalByteCount_ += len;
+    if (len <= streamWindowRemaining_)
+    {
+        streamWindowRemaining_ -= len;
+    }
+    else
+    {
+        LOG(WARNING, "Unexpected stream bytes, window is negative.");
+        streamWindowRemaining_ = 0;
+    }
+}
+
+void StreamReceiverCan::handle_linked_bytes_received(
+    const uint8_t *data, size_t len)
+{
+    if (!linkedWindow_)
+    {
+        LOG(WARNING, "Unexpected stream bytes, no window buffer.");
+        return;
+    }
+    LinkedDataBufferPtr *p = linkedWindow_->data();
+    while (len > 0)
+    {
+        if (!p->free())
+        {
+            DataBuffer *b;
+            dataBufferPool_.alloc(&b);
+            p->append_empty_buffer(b);
+        }
+        size_t copied = std::min(len, p->free());
+        memcpy(p->data_write_pointer(), data, copied);
+        p->data_write_advance(copied);
+        data += copied;
+        len -= copied;
+        consume_window(copied);
+    }
+    if (!streamWindowRemaining_)
+    {
+        // The entire window goes to the target at once.
+        request()->linkedTarget_->send(linkedWindow_.release());
+        // wake up state flow to send ack to the stream
+        notify();
+    }
+}
+
 void StreamReceiverCan::handle_bytes_received(const uint8_t *data, size_t len)
 {
+    if (is_linked())
+    {
+        return handle_linked_bytes_received(data, len);
+    }
     while (len > 0)
     {
         if (!currentBuffer_)
@@ -172,16 +223,7 @@ void StreamReceiverCan::handle_bytes_received(const uint8_t *data, size_t len)
         size_t copied = currentBuffer_->data()->append(data, len);
         data += copied;
         len -= copied;
-        totalByteCount_ += copied;
-        if (copied <= streamWindowRemaining_)
-        {
-            streamWindowRemaining_ -= copied;
-        }
-        else
-        {
-            LOG(WARNING, "Unexpected stream bytes, window is negative.");
-            streamWindowRemaining_ = 0;
-        }
+        consume_window(copied);
         if (!currentBuffer_->data()->free_space() || !streamWindowRemaining_)
         {
             // Sends off the buffer and clears currentBuffer_.
@@ -338,11 +380,7 @@ StateFlowBase::Action StreamReceiverCan::wakeup()
     if (pendingCancel_)
     {
         unregister_handlers();
-        if (currentBuffer_)
-        {
-            // Sends off the buffer and clears currentBuffer_.
-            request()->target_->send(currentBuffer_.release());
-        }
+        flush_buffers();
         return return_with_error(StreamReceiveRequest::ERROR_CANCELED);
     }
     if (pendingInit_)
@@ -356,11 +394,7 @@ StateFlowBase::Action StreamReceiverCan::wakeup()
         {
             streamClosed_ = 0;
             dataHandler_->stop();
-            if (currentBuffer_)
-            {
-                // Sends off the buffer and clears currentBuffer_.
-                request()->target_->send(currentBuffer_.release());
-            }
+            flush_buffers();
             return return_ok();
         }
         // Need to send an ack.
@@ -369,16 +403,59 @@ StateFlowBase::Action StreamReceiverCan::wakeup()
     return wait();
 }
 
+void StreamReceiverCan::flush_buffers()
+{
+    if (currentBuffer_)
+    {
+        // Sends off the buffer and clears currentBuffer_.
+        request()->target_->send(currentBuffer_.release());
+    }
+    if (linkedWindow_)
+    {
+        if (linkedWindow_->data()->size())
+        {
+            request()->linkedTarget_->send(linkedWindow_.release());
+        }
+        else
+        {
+            // Returns the throttling slot.
+            linkedWindow_.reset();
+        }
+    }
+}
+
+StateFlowBase::Action StreamReceiverCan::allocate_window_buffer(Callback c)
+{
+    if (is_linked())
+    {
+        return allocate_and_call<LinkedDataBufferPtr>(
+            nullptr, c, &linkedBufferPool_);
+    }
+    return allocate_and_call<RawData>(nullptr, c, &lastBufferPool_);
+}
+
+void StreamReceiverCan::take_window_buffer()
+{
+    if (is_linked())
+    {
+        linkedWindow_.reset(
+            get_allocation_result<LinkedDataBufferPtr>(nullptr));
+    }
+    else
+    {
+        lastBuffer_.reset(get_allocation_result<RawData>(nullptr));
+    }
+}
+
 StateFlowBase::Action StreamReceiverCan::init_reply()
 {
     // Initialize the last buffer for the first window.
-    return allocate_and_call<RawData>(
-        nullptr, STATE(init_buffer_ready), &lastBufferPool_);
+    return allocate_window_buffer(STATE(init_buffer_ready));
 }
 
 StateFlowBase::Action StreamReceiverCan::init_buffer_ready()
 {
-    lastBuffer_.reset(get_allocation_result<RawData>(nullptr));
+    take_window_buffer();
 
     node()->iface()->canonicalize_handle(&request()->src_);
     NodeHandle local(node()->node_id());
@@ -394,13 +471,12 @@ StateFlowBase::Action StreamReceiverCan::init_buffer_ready()
 
 StateFlowBase::Action StreamReceiverCan::window_reached()
 {
-    return allocate_and_call<RawData>(
-        nullptr, STATE(have_raw_buffer), &lastBufferPool_);
+    return allocate_window_buffer(STATE(have_raw_buffer));
 }
 
 StateFlowBase::Action StreamReceiverCan::have_raw_buffer()
 {
-    lastBuffer_.reset(get_allocation_result<RawData>(nullptr));
+    take_window_buffer();
     streamWindowRemaining_ = request()->streamWindowSize_;
     send_message(node(), Defs::MTI_STREAM_PROCEED, request()->src_,
         StreamDefs::create_data_proceed(
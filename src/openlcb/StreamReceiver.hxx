@@ -41,6 +41,7 @@
 #include "openlcb/IfCan.hxx"
 #include "openlcb/StreamDefs.hxx"
 #include "utils/ByteBuffer.hxx"
+#include "utils/DataBuffer.hxx"
 #include "utils/LimitedPool.hxx"
 
 namespace openlcb
@@ -103,6 +104,24 @@ private:
     /// the stream proceed message.
     Action have_raw_buffer();
 
+    /// Allocates the buffer that throttles the next stream window: the last
+    /// raw buffer, or the linked buffer holding the entire window.
+    /// @param c state to call when the allocation is complete.
+    Action allocate_window_buffer(Callback c);
+
+    /// Takes the result of allocate_window_buffer().
+    void take_window_buffer();
+
+    /// Sends off the partially filled buffers to the target.
+    void flush_buffers();
+
+    /// @return true if the incoming data is delivered in chains of data
+    /// buffers.
+    bool is_linked()
+    {
+        return request()->linkedTarget_ != nullptr;
+    }
+
     /// Invoked by the GenericHandler when a stream initiate message arrives.
     ///
     /// @param message buffer with stream initiate message.
@@ -112,6 +131,14 @@ private:
     /// Handles data arriving from the network.
     inline void handle_bytes_received(const uint8_t *data, size_t len);
 
+    /// Handles data arriving from the network when the target is a
+    /// LinkedByteSink.
+    void handle_linked_bytes_received(const uint8_t *data, size_t len);
+
+    /// Updates the window after some bytes arrived.
+    /// @param len number of bytes that arrived.
+    void consume_window(size_t len);
+
     /// Invoked by the GenericHandler when a stream complete message arrives.
     ///
     /// @param message buffer with stream complete message.
@@ -157,6 +184,17 @@ private:
     /// comes from the lastBufferPool_ to function as throttling signal.
     RawBufferPtr lastBuffer_;
 
+    /// Same as lastBufferPool_ for linked delivery: one buffer per stream
+    /// window, allowing 2x the stream window size in our RAM.
+    LimitedPool linkedBufferPool_ {sizeof(LinkedByteBuffer), 2};
+
+    /// Data buffers for linked delivery.
+    DataBufferPool dataBufferPool_ {RawData::MAX_SIZE};
+
+    /// The chain of data buffers holding the current stream window, when the
+    /// target is a LinkedByteSink. Allocated from linkedBufferPool_.
+    BufferPtr<LinkedDataBufferPtr> linkedWindow_;
+
     /// Helper object that receives the actual stream CAN frames.
     std::unique_ptr<StreamDataHandler> dataHandler_;
 
@@ -44,6 +44,11 @@ template <class T> class Buffer;
 struct ByteChunk;
 using ByteBuffer = Buffer<ByteChunk>;
 using ByteSink = FlowInterface<ByteBuffer>;
+class LinkedDataBufferPtr;
+/// Buffer carrying stream payload in a chain of data buffers.
+using LinkedByteBuffer = Buffer<LinkedDataBufferPtr>;
+/// Interface for receiving stream payload in chains of data buffers.
+using LinkedByteSink = FlowInterface<LinkedByteBuffer>;
 
 namespace openlcb
 {
@@ -66,6 +71,7 @@ struct StreamReceiveRequest : public CallableFlowRequestBase
     {
         reset_base();
         target_ = nullptr;
+        linkedTarget_ = nullptr;
         localStreamId_ = StreamDefs::INVALID_STREAM_ID;
         resultCode = OPERATION_PENDING;
     }
@@ -93,19 +99,35 @@ struct StreamReceiveRequest : public CallableFlowRequestBase
         uint8_t dst_stream_id = StreamDefs::INVALID_STREAM_ID,
         uint16_t max_window = 0)
     {
-        reset_base();
         HASSERT(target);
+        reset_stream(dst, src, src_stream_id, dst_stream_id, max_window);
         target_ = target;
-        src_ = src;
-        dst_ = dst;
-        srcStreamId_ = src_stream_id;
-        localStreamId_ = dst_stream_id;
-        streamWindowSize_ = max_window;
-        resultCode = OPERATION_PENDING;
+    }
+
+    /// Starts the stream receiver and prepares for an announced stream, with
+    /// the incoming data delivered without copying. Each stream window (and
+    /// the remainder at the stream close) arrives at the target as a single
+    /// chain of data buffers, which the consumer can write out with a
+    /// scatter list (see LinkedDataBufferPtr::fill_iovec). At most two
+    /// windows are held; the stream proceed for the next window is sent when
+    /// the target releases a window buffer.
+    ///
+    /// Arguments are the same as for the ByteSink version.
+    void reset(LinkedByteSink *target, Node *dst, NodeHandle src,
+        uint8_t src_stream_id = StreamDefs::INVALID_STREAM_ID,
+        uint8_t dst_stream_id = StreamDefs::INVALID_STREAM_ID,
+        uint16_t max_window = 0)
+    {
+        HASSERT(target);
+        reset_stream(dst, src, src_stream_id, dst_stream_id, max_window);
+        linkedTarget_ = target;
     }
 
     /// Where to send the incoming stream data.
     ByteSink *target_ {nullptr};
+    /// Where to send the incoming stream data, if it is delivered in chains
+    /// of data buffers. At most one of target_ and linkedTarget_ is set.
+    LinkedByteSink *linkedTarget_ {nullptr};
     /// Remote node that will send us the stream.
     NodeHandle src_ {0, 0};
     /// Local node for receiving the stream.
@@ -118,6 +140,23 @@ struct StreamReceiveRequest : public CallableFlowRequestBase
     /// local side. If zero, the default max window size will be taken from a
     /// linker-time constant.
     uint16_t streamWindowSize_ {0};
+
+private:
+    /// Helper for the reset functions announcing a stream. Clears the
+    /// targets.
+    void reset_stream(Node *dst, NodeHandle src, uint8_t src_stream_id,
+        uint8_t dst_stream_id, uint16_t max_window)
+    {
+        reset_base();
+        target_ = nullptr;
+        linkedTarget_ = nullptr;
+        src_ = src;
+        dst_ = dst;
+        srcStreamId_ = src_stream_id;
+        localStreamId_ = dst_stream_id;
+        streamWindowSize_ = max_window;
+        resultCode = OPERATION_PENDING;
+    }
 };
 
 class StreamReceiverInterface : public CallableFlow<StreamReceiveRequest>
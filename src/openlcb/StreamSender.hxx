@@ -41,6 +41,7 @@
 #include "openlcb/DatagramDefs.hxx"
 #include "openlcb/IfCan.hxx"
 #include "openlcb/StreamDefs.hxx"
+#include "openlcb/StreamWindow.hxx"
 #include "utils/ByteBuffer.hxx"
 #include "utils/LimitedPool.hxx"
 #include "utils/format_utils.hxx"
@@ -77,7 +78,13 @@ public:
 };
 
 /// Helper class for sending stream data to a CAN interface.
-/// @todo add progress report API.
+///
+/// Proceed messages that arrive before the current window is used up are
+/// accumulated, so a destination that sends them ahead of time keeps the
+/// transfer running without stopping at the window boundaries. Unless the
+/// caller sets the window size explicitly, the proposed window size adapts
+/// from stream to stream to the round trip times observed (see
+/// StreamWindow).
 class StreamSenderCan : public StreamSender
 {
 public:
@@ -119,8 +126,7 @@ public:
         trigger();
         streamFlags_ = 0;
         streamAdditionalFlags_ = 0;
-        streamWindowSize_ = StreamDefs::MAX_PAYLOAD;
-        streamWindowRemaining_ = 0;
+        streamWindowSize_ = window_.proposed_window();
         errorCode_ = 0;
         return *this;
     }
@@ -211,6 +217,19 @@ public:
         return dstStreamId_;
     }
 
+    /// @return transfer statistics of the current (or last) stream.
+    const StreamWindow::Stats &get_stats()
+    {
+        return window_.stats();
+    }
+
+    /// @return the window size that the next stream will propose, unless
+    /// overridden by set_proposed_window_size().
+    uint16_t get_next_proposed_window_size()
+    {
+        return window_.proposed_window();
+    }
+
     /// Start of state machine, called when a buffer of data to send arrives
     /// from the application layer.
     Action entry() override
@@ -225,7 +244,7 @@ public:
             return release_and_exit();
         }
         DASSERT(state_ == RUNNING);
-        if (!streamWindowRemaining_)
+        if (!window_.credit())
         {
             // We ran out of the current stream window size.
             return call_immediately(STATE(wait_for_stream_proceed));
@@ -354,7 +373,7 @@ private:
                 "Inconsistency: zero buffer length but "
                 "accepted stream request.");
         }
-        streamWindowRemaining_ = streamWindowSize_;
+        window_.start(streamWindowSize_);
         node_->iface()->dispatcher()->register_handler(
             &streamProceedHandler_, Defs::MTI_STREAM_PROCEED, Defs::MTI_EXACT);
         state_ = RUNNING;
@@ -425,10 +444,10 @@ private:
     }
 
     /// Starts sleeping until a proceed message arrives. Run this state when
-    /// streamWindowRemaining_ == 0.
+    /// we have no more credit in the stream window.
     Action wait_for_stream_proceed()
     {
-        if (streamWindowRemaining_)
+        if (window_.credit())
         {
             // received early stream_proceed response
             return call_immediately(STATE(stream_proceed_timeout));
@@ -457,9 +476,7 @@ private:
             return;
         }
 
-        /// @todo add progress callback API
-
-        streamWindowRemaining_ += streamWindowSize_;
+        window_.proceed();
         if (sleeping_)
         {
             sleeping_ = false;
@@ -469,8 +486,13 @@ private:
 
     Action stream_proceed_timeout()
     {
-        if (!streamWindowRemaining_) // no proceed arrived
+        sleeping_ = false;
+        if (!window_.credit()) // no proceed arrived
         {
+            window_.timeout();
+            node_->iface()->dispatcher()->unregister_handler(
+                &streamProceedHandler_, Defs::MTI_STREAM_PROCEED,
+                Defs::MTI_EXACT);
             /// @todo (balazs.racz) somehow merge these two actions: remember
             /// that we timed out and close the stream.
             return return_error(Defs::ERROR_TEMPORARY,
@@ -492,9 +514,9 @@ private:
             ret = MAX_BYTES_PAYLOAD_PER_CAN_FRAME;
         }
         // Cannot exceed remaining bytes in stream window.
-        if (ret > streamWindowRemaining_)
+        if (ret > window_.credit())
         {
-            ret = streamWindowRemaining_;
+            ret = window_.credit();
         }
         return ret;
     }
@@ -518,7 +540,7 @@ private:
     {
         message()->data()->advance(num_bytes);
         totalByteCount_ += num_bytes;
-        streamWindowRemaining_ -= num_bytes;
+        window_.sent(num_bytes);
     }
 
     Action return_error(uint32_t code, string message)
@@ -583,16 +605,16 @@ private:
     uint8_t streamFlags_ {0};
     /// More flags from the remote node that we got in stream initiate reply
     uint8_t streamAdditionalFlags_ {0};
-    /// Total stream window size. @todo fill in
+    /// Total stream window size.
     uint16_t streamWindowSize_ {StreamDefs::MAX_PAYLOAD};
-    /// Remaining stream window size. @todo fill in
-    uint16_t streamWindowRemaining_ {0};
     /// When the stream process fails, this variable contains an error code.
     uint32_t errorCode_ {0};
     /// Source of buffers for outgoing CAN frames. Limtedpool is allocating and
     /// releasing to the mainBufferPool, but blocks when we exceed a certain
     /// number of allocations until some buffers get freed.
     LimitedPool canFramePool_ {CAN_FRAME_ALLOC_SIZE, MAX_FRAMES_IN_FLIGHT};
+    /// Send credit, window size adaptation and statistics.
+    StreamWindow window_;
     /// Helper object for timeouts.
     StateFlowTimer timer_ {this};
 };
@@ -0,0 +1,223 @@
+/** \copyright
+ * Copyright (c) 2026, agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are  permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file StreamWindow.hxx
+ * Flow control and throughput accounting for the sending side of a stream.
+ *
+ * @author agent
+ * @date 17 Oct 2026
+ */
+
+#ifndef _OPENLCB_STREAMWINDOW_HXX_
+#define _OPENLCB_STREAMWINDOW_HXX_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "openlcb/StreamDefs.hxx"
+#include "os/os.h"
+
+namespace openlcb
+{
+
+/// Keeps track of how many bytes a stream source may send before it needs a
+/// stream proceed message, and measures how well the transfer is going.
+///
+/// The send credit is kept in 32 bits, so a destination may send proceed
+/// messages ahead of time, each granting one more window; these accumulate
+/// and the source does not stop at the window boundary.
+///
+/// The object also learns what window size to propose in the next stream
+/// initiate request. When the source spends a long time waiting for the
+/// proceed message compared to the time it took to send the window, the
+/// round trip dominates the transfer and a larger window is proposed. When
+/// the proceed does not arrive at all, a smaller window is proposed.
+class StreamWindow
+{
+public:
+    /// Statistics about the current (or last) stream.
+    struct Stats
+    {
+        /// How many payload bytes were sent.
+        uint32_t bytes {0};
+        /// Time from the stream being accepted to the last payload byte.
+        long long elapsedNsec {0};
+        /// Total time spent with no credit, waiting for a proceed message.
+        long long stallNsec {0};
+        /// How long the last wait for a proceed message was.
+        long long lastStallNsec {0};
+        /// Moving average of the throughput, updated at each proceed.
+        float recentBytesPerSec {0};
+        /// Window size negotiated with the destination.
+        uint16_t windowSize {0};
+        /// Number of proceed messages received.
+        uint16_t proceeds {0};
+        /// Number of times waiting for a proceed message timed out.
+        uint16_t timeouts {0};
+
+        /// @return the throughput achieved over the entire stream.
+        uint32_t bytes_per_sec() const
+        {
+            if (elapsedNsec <= 0)
+            {
+                return 0;
+            }
+            return (uint64_t)bytes * 1000000000ULL / elapsedNsec;
+        }
+    };
+
+    /// Smallest window size we will propose.
+    static constexpr uint16_t MIN_WINDOW = 64;
+
+    /// If waiting for the proceed message takes longer than 1/STALL_RATIO of
+    /// the time to send a window, the next stream will propose a larger
+    /// window.
+    static constexpr unsigned STALL_RATIO = 4;
+
+    /// @return the window size to propose in the next stream initiate
+    /// request.
+    uint16_t proposed_window()
+    {
+        return proposedWindow_;
+    }
+
+    /// Starts accounting for a new stream.
+    /// @param window_size the window size the destination accepted.
+    void start(uint16_t window_size)
+    {
+        stats_ = Stats();
+        stats_.windowSize = window_size;
+        credit_ = window_size;
+        startTimeNsec_ = os_get_time_monotonic();
+        windowStartNsec_ = startTimeNsec_;
+        lastProceedNsec_ = startTimeNsec_;
+        lastProceedBytes_ = 0;
+        stallStartNsec_ = 0;
+    }
+
+    /// @return how many bytes may be sent before the next proceed message.
+    uint32_t credit()
+    {
+        return credit_;
+    }
+
+    /// Records that some payload was sent.
+    /// @param len number of bytes sent, at most credit().
+    void sent(size_t len)
+    {
+        credit_ -= len;
+        stats_.bytes += len;
+        long long now = os_get_time_monotonic();
+        stats_.elapsedNsec = now - startTimeNsec_;
+        if (!credit_)
+        {
+            stallStartNsec_ = now;
+        }
+    }
+
+    /// Records the arrival of a stream proceed message.
+    void proceed()
+    {
+        long long now = os_get_time_monotonic();
+        ++stats_.proceeds;
+        credit_ += stats_.windowSize;
+        if (stallStartNsec_)
+        {
+            long long stall = now - stallStartNsec_;
+            long long send = stallStartNsec_ - windowStartNsec_;
+            stats_.lastStallNsec = stall;
+            stats_.stallNsec += stall;
+            stallStartNsec_ = 0;
+            windowStartNsec_ = now;
+            if (stall * STALL_RATIO > send)
+            {
+                uint32_t w = 2 * (uint32_t)stats_.windowSize;
+                if (w > StreamDefs::MAX_PAYLOAD)
+                {
+                    w = StreamDefs::MAX_PAYLOAD;
+                }
+                proposedWindow_ = w;
+            }
+        }
+        // else: the proceed arrived ahead of time; the credit accumulates.
+        if (now > lastProceedNsec_)
+        {
+            float spd = (stats_.bytes - lastProceedBytes_) * 1e9 /
+                (now - lastProceedNsec_);
+            if (stats_.proceeds == 1)
+            {
+                stats_.recentBytesPerSec = spd;
+            }
+            else
+            {
+                stats_.recentBytesPerSec =
+                    stats_.recentBytesPerSec * 0.8 + spd * 0.2;
+            }
+        }
+        lastProceedNsec_ = now;
+        lastProceedBytes_ = stats_.bytes;
+    }
+
+    /// Records that we gave up waiting for a proceed message.
+    void timeout()
+    {
+        ++stats_.timeouts;
+        uint16_t w = stats_.windowSize / 2;
+        if (w < MIN_WINDOW)
+        {
+            w = MIN_WINDOW;
+        }
+        proposedWindow_ = w;
+    }
+
+    /// @return statistics about the current stream.
+    const Stats &stats()
+    {
+        return stats_;
+    }
+
+private:
+    /// Statistics of the current stream.
+    Stats stats_;
+    /// How many bytes we may still send.
+    uint32_t credit_ {0};
+    /// Window size to propose in the next stream.
+    uint16_t proposedWindow_ {StreamDefs::MAX_PAYLOAD};
+    /// Time when the stream was started.
+    long long startTimeNsec_ {0};
+    /// Time when we got credit after the last stall.
+    long long windowStartNsec_ {0};
+    /// Time when the credit ran out, or 0 if we have credit.
+    long long stallStartNsec_ {0};
+    /// Time of the last proceed message.
+    long long lastProceedNsec_ {0};
+    /// Stats_.bytes at the time of the last proceed message.
+    uint32_t lastProceedBytes_ {0};
+};
+
+} // namespace openlcb
+
+#endif // _OPENLCB_STREAMWINDOW_HXX_
@@ -75,6 +75,32 @@ DEFAULT_CONST_TRUE(node_init_identify);
  * time. */
 DEFAULT_CONST(bulk_alias_num_can_frames, 20);
 
+/** Maximum number of aliases for which the bulk alias allocator has sent the
+ * CID frames but not yet the RID frame. 0 for no limit. */
+DEFAULT_CONST(bulk_alias_window, 64);
+
+/** How many CAN frames per second the bulk alias allocator may send. 0 for no
+ * pacing other than waiting for the frames to leave the device. */
+DEFAULT_CONST(bulk_alias_frames_per_sec, 0);
+
 /** Default number of bytes in maximum stream window size for { @ref
  * StreamReceiver }. */
 DEFAULT_CONST(stream_receiver_default_window_size, 2 * 1024);
+
+/** Minimum time in usec between calling two event handlers that reply to an
+ * identify events message. 0 for no pacing other than waiting for each
+ * handler's replies to leave the node. */
+DEFAULT_CONST(event_identify_pace_usec, 0);
+
+/** Set to CONSTANT_TRUE to remember which event handlers reply to an identify
+ * events message, and call only those for later identify messages until the
+ * event registry changes. */
+DEFAULT_CONST_FALSE(event_identify_cache);
+
+/** Set to CONSTANT_TRUE to keep the event handler registrations in a
+ * FlatEventHandlers instead of the default TreeEventHandlers. */
+DEFAULT_CONST_FALSE(event_registry_flat);
+
+/** A GcCanRoutingHub forgets the route to a node address that has not sent
+ * any frame for this many seconds. 0 disables aging. */
+DEFAULT_CONST(routing_hub_address_max_age_sec, 900);
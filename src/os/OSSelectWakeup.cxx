@@ -32,6 +32,9 @@
 */
 
 #include "os/OSSelectWakeup.hxx"
+
+#include <errno.h>
+
 #include "utils/logging.h"
 #if defined(__MACH__)
 #define _DARWIN_C_SOURCE // pselect
@@ -112,6 +115,65 @@ int OSSelectWakeup::select(int nfds, fd_set *readfds,
     return ret;
 }
 
+#if OPENMRN_HAVE_EPOLL
+
+#if defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 35)
+/// ::epoll_pwait2 takes the timeout in nanoseconds. Needs Linux 5.11.
+#define HAVE_EPOLL_PWAIT2 1
+/// Set to false when the kernel turns out not to have ::epoll_pwait2.
+static bool have_epoll_pwait2 = true;
+#endif
+#endif
+
+int OSSelectWakeup::epoll_wait(int epfd, struct epoll_event *events,
+    int maxevents, long long deadline_nsec)
+{
+    {
+        AtomicHolder l(this);
+        inSelect_ = true;
+        if (pendingWakeup_)
+        {
+            deadline_nsec = 0;
+        }
+    }
+    int ret;
+#ifdef HAVE_EPOLL_PWAIT2
+    if (have_epoll_pwait2)
+    {
+        // Rounds up to whole microseconds, the granularity of ::select. A
+        // shorter timeout elapses before the kernel would go to sleep, which
+        // makes the caller spin on the CPU until the deadline.
+        deadline_nsec = (deadline_nsec + 999) / 1000 * 1000;
+        struct timespec timeout;
+        timeout.tv_sec = deadline_nsec / 1000000000LL;
+        timeout.tv_nsec = deadline_nsec % 1000000000LL;
+        ret = ::epoll_pwait2(epfd, events, maxevents, &timeout, &origMask_);
+        if (ret < 0 && errno == ENOSYS)
+        {
+            have_epoll_pwait2 = false;
+        }
+    }
+    if (!have_epoll_pwait2)
+#endif
+    {
+        // Rounds up, so that we do not wake up before the next timer is due.
+        long long timeout_msec = (deadline_nsec + 999999) / 1000000;
+        if (timeout_msec > INT_MAX)
+        {
+            timeout_msec = INT_MAX;
+        }
+        ret = ::epoll_pwait(epfd, events, maxevents, timeout_msec, &origMask_);
+    }
+    {
+        AtomicHolder l(this);
+        pendingWakeup_ = false;
+        inSelect_ = false;
+    }
+    return ret;
+}
+#endif // OPENMRN_HAVE_EPOLL
+
 #ifdef ESP_PLATFORM
 #include "freertos_includes.h"
 
@@ -48,6 +48,10 @@
 #include <signal.h>
 #endif
 
+#if OPENMRN_HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef __WINNT__
 #include <winsock2.h>
 #elif OPENMRN_HAVE_SELECT
@@ -78,6 +82,7 @@ public:
     OSSelectWakeup()
         : pendingWakeup_(false)
         , inSelect_(false)
+        , thread_()
     {
     }
 
@@ -201,6 +206,26 @@ public:
     int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
                long long deadline_nsec);
 
+#if OPENMRN_HAVE_EPOLL
+    /** Call to ::epoll_wait that can be woken up asynchronously from a
+     * different thread, with the same semantics as select().
+     *
+     * @param epfd is as a regular ::epoll_wait call.
+     * @param events is as a regular ::epoll_wait call.
+     * @param maxevents is as a regular ::epoll_wait call.
+     * @param deadline_nsec is the maximum time to sleep if no fd activity and
+     * no wakeup happens. 0 to return immediately. Used with nanosecond
+     * precision when ::epoll_pwait2 is available (glibc 2.35 and Linux
+     * 5.11), otherwise rounded up to milliseconds.
+     *
+     * @return what epoll_wait would return (number of events, 0 in case of
+     * timeout), or -1 and errno==EINTR if the wait was woken up
+     * asynchronously
+     */
+    int epoll_wait(int epfd, struct epoll_event *events, int maxevents,
+        long long deadline_nsec);
+#endif
+
 private:
 #ifdef ESP_PLATFORM
     void esp_allocate_vfs_fd();
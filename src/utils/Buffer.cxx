@@ -32,6 +32,8 @@
  */
 
 #include "utils/Buffer.hxx"
+
+#include "nmranet_config.h"
 #include "utils/ByteBuffer.hxx"
 
 DynamicPool *mainBufferPool = nullptr;
@@ -47,6 +49,10 @@ Pool* init_main_buffer_pool()
     {
         mainBufferPool =
             new DynamicPool(Bucket::init(32, 48, LARGEST_BUFFERPOOL_BUCKET, 0));
+#if OPENMRN_FEATURE_POOL_THREAD_CACHE
+        mainBufferPool->set_thread_cache(
+            config_buffer_pool_thread_cache_size());
+#endif
     }
     return mainBufferPool;
 }
@@ -61,6 +67,9 @@ size_t DynamicPool::free_items()
     {
         total += current->pending();
     }
+#if OPENMRN_FEATURE_POOL_THREAD_CACHE
+    total += cached_items(nullptr);
+#endif
     return total;
 }
 
@@ -74,7 +83,11 @@ size_t DynamicPool::free_items(size_t size)
     {
         if (current->size() >= size)
         {
+#if OPENMRN_FEATURE_POOL_THREAD_CACHE
+            return current->pending() + cached_items(current);
+#else
             return current->pending();
+#endif
         }
     }
     return 0;
@@ -110,7 +123,17 @@ BufferBase *DynamicPool::alloc_untyped(size_t size, Executable *flow)
     {
         if (size <= current->size())
         {
-            result = static_cast<BufferBase*>(current->next().item);
+#if OPENMRN_FEATURE_POOL_THREAD_CACHE
+            ThreadCache *cache = magazineSize_ ? thread_cache() : nullptr;
+            if (cache)
+            {
+                result = cache_alloc(cache, current);
+            }
+            else
+#endif
+            {
+                result = static_cast<BufferBase *>(current->next().item);
+            }
             if (result == NULL)
             {
                 result = (BufferBase*)buffer_malloc(current->size());
@@ -174,6 +197,14 @@ void DynamicPool::free(BufferBase *item)
     {
         if (item->size() <= current->size())
         {
+#if OPENMRN_FEATURE_POOL_THREAD_CACHE
+            ThreadCache *cache = magazineSize_ ? thread_cache() : nullptr;
+            if (cache)
+            {
+                cache_free(cache, current, item);
+                return;
+            }
+#endif
             current->insert(item);
             return;
         }
@@ -186,6 +217,251 @@ void DynamicPool::free(BufferBase *item)
     free_large(item);
 }
 
+#if OPENMRN_FEATURE_POOL_THREAD_CACHE
+
+/// Free items of one pool kept by one thread.
+struct DynamicPool::ThreadCache
+{
+    /// Free items of one bucket.
+    struct Magazine
+    {
+        /// Number of valid entries in items_. Written only by the owning
+        /// thread, but read by free_items() from any thread.
+        std::atomic<unsigned> count_ {0};
+        /// Stack of free items.
+        BufferBase **items_;
+    };
+
+    /// Constructor.
+    /// @param pool which pool this cache belongs to.
+    /// @param num_buckets how many buckets the pool has.
+    /// @param capacity how many items to keep at most per bucket.
+    ThreadCache(DynamicPool *pool, unsigned num_buckets, unsigned capacity)
+        : pool_(pool)
+        , numBuckets_(num_buckets)
+        , capacity_(capacity)
+        , mags_(new Magazine[num_buckets])
+        , storage_(new BufferBase *[num_buckets * capacity])
+    {
+        for (unsigned i = 0; i < num_buckets; ++i)
+        {
+            mags_[i].items_ = storage_.get() + i * capacity;
+        }
+    }
+
+    /// Pool this cache belongs to. nullptr if the pool was destroyed.
+    std::atomic<DynamicPool *> pool_;
+    /// Next cache in the list of the pool.
+    ThreadCache *next_ {nullptr};
+    /// Number of entries in mags_.
+    unsigned numBuckets_;
+    /// Maximum number of items per magazine.
+    unsigned capacity_;
+    /// One magazine for each bucket of the pool.
+    std::unique_ptr<Magazine[]> mags_;
+    /// Backing storage of the item stacks.
+    std::unique_ptr<BufferBase *[]> storage_;
+};
+
+/// Holds the caches of one thread. Returns the cached items to the pools when
+/// the thread exits.
+class DynamicPool::ThreadCacheSet
+{
+public:
+    ~ThreadCacheSet()
+    {
+        exited_ = true;
+        for (ThreadCache *&c : caches_)
+        {
+            if (c)
+            {
+                release_thread_cache(c);
+                c = nullptr;
+            }
+        }
+    }
+
+    /// How many pools a thread can have a cache for.
+    static constexpr unsigned MAX_POOLS = 4;
+    /// Caches of this thread. Unused entries are nullptr.
+    ThreadCache *caches_[MAX_POOLS] = {};
+    /// True when the thread local storage is being destroyed.
+    bool exited_ {false};
+};
+
+/// @return the lock protecting the cache lists of all pools.
+static Atomic *thread_cache_lock()
+{
+    static Atomic lock;
+    return &lock;
+}
+
+DynamicPool::ThreadCache *DynamicPool::thread_cache()
+{
+    static thread_local ThreadCacheSet cache_set;
+    if (cache_set.exited_)
+    {
+        return nullptr;
+    }
+    ThreadCache **free_slot = nullptr;
+    for (ThreadCache *&c : cache_set.caches_)
+    {
+        if (c)
+        {
+            DynamicPool *pool = c->pool_.load(std::memory_order_relaxed);
+            if (pool == this)
+            {
+                return c;
+            }
+            if (pool)
+            {
+                continue;
+            }
+            // The pool of this cache was destroyed.
+            release_thread_cache(c);
+            c = nullptr;
+        }
+        if (!free_slot)
+        {
+            free_slot = &c;
+        }
+    }
+    if (!free_slot)
+    {
+        return nullptr;
+    }
+    unsigned num_buckets = 0;
+    while (buckets[num_buckets].size() != 0)
+    {
+        ++num_buckets;
+    }
+    ThreadCache *c = new ThreadCache(this, num_buckets, magazineSize_);
+    {
+        AtomicHolder h(thread_cache_lock());
+        c->next_ = caches_;
+        caches_ = c;
+    }
+    *free_slot = c;
+    return c;
+}
+
+BufferBase *DynamicPool::cache_alloc(ThreadCache *cache, Bucket *bucket)
+{
+    ThreadCache::Magazine *m = &cache->mags_[bucket - buckets];
+    unsigned count = m->count_.load(std::memory_order_relaxed);
+    if (count == 0)
+    {
+        unsigned refill = (cache->capacity_ + 1) / 2;
+        AtomicHolder h(bucket->lock());
+        while (count < refill)
+        {
+            QMember *item = bucket->next_locked().item;
+            if (!item)
+            {
+                break;
+            }
+            m->items_[count++] = static_cast<BufferBase *>(item);
+        }
+        if (count == 0)
+        {
+            return nullptr;
+        }
+    }
+    --count;
+    m->count_.store(count, std::memory_order_relaxed);
+    return m->items_[count];
+}
+
+void DynamicPool::cache_free(
+    ThreadCache *cache, Bucket *bucket, BufferBase *item)
+{
+    ThreadCache::Magazine *m = &cache->mags_[bucket - buckets];
+    unsigned count = m->count_.load(std::memory_order_relaxed);
+    if (count >= cache->capacity_)
+    {
+        unsigned keep = cache->capacity_ / 2;
+        AtomicHolder h(bucket->lock());
+        while (count > keep)
+        {
+            bucket->insert_locked(m->items_[--count]);
+        }
+    }
+    m->items_[count++] = item;
+    m->count_.store(count, std::memory_order_relaxed);
+}
+
+void DynamicPool::release_thread_cache(ThreadCache *cache)
+{
+    {
+        AtomicHolder h(thread_cache_lock());
+        DynamicPool *pool = cache->pool_.load(std::memory_order_relaxed);
+        if (pool)
+        {
+            for (unsigned i = 0; i < cache->numBuckets_; ++i)
+            {
+                ThreadCache::Magazine *m = &cache->mags_[i];
+                Bucket *bucket = pool->buckets + i;
+                AtomicHolder hh(bucket->lock());
+                for (unsigned j = m->count_; j > 0; --j)
+                {
+                    bucket->insert_locked(m->items_[j - 1]);
+                }
+                m->count_ = 0;
+            }
+            for (ThreadCache **p = &pool->caches_; *p; p = &(*p)->next_)
+            {
+                if (*p == cache)
+                {
+                    *p = cache->next_;
+                    break;
+                }
+            }
+        }
+    }
+    delete cache;
+}
+
+void DynamicPool::detach_thread_caches()
+{
+    AtomicHolder h(thread_cache_lock());
+    for (ThreadCache *c = caches_; c; c = c->next_)
+    {
+#ifdef GTEST
+        // Frees all memory left in the caches.
+        for (unsigned i = 0; i < c->numBuckets_; ++i)
+        {
+            ThreadCache::Magazine *m = &c->mags_[i];
+            for (unsigned j = m->count_; j > 0; --j)
+            {
+                ::free(m->items_[j - 1]);
+            }
+            m->count_ = 0;
+        }
+#endif
+        c->pool_ = nullptr;
+    }
+    caches_ = nullptr;
+}
+
+size_t DynamicPool::cached_items(Bucket *bucket)
+{
+    size_t total = 0;
+    AtomicHolder h(thread_cache_lock());
+    for (ThreadCache *c = caches_; c; c = c->next_)
+    {
+        for (unsigned i = 0; i < c->numBuckets_; ++i)
+        {
+            if (!bucket || bucket == buckets + i)
+            {
+                total += c->mags_[i].count_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    return total;
+}
+
+#endif // OPENMRN_FEATURE_POOL_THREAD_CACHE
+
 /** Get a free item out of the pool.
  * @param size how many payload bytes should he allocated buffer have. Usually
  * sizeof<T> for Buffer<T>.
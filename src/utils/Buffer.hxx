@@ -46,6 +46,7 @@
 
 #include "executor/Executable.hxx"
 #include "executor/Notifiable.hxx"
+#include "openmrn_features.h"
 #include "os/OS.hxx"
 #include "utils/Atomic.hxx"
 #include "utils/MultiMap.hxx"
@@ -502,6 +503,9 @@ public:
     /** default destructor */
     ~DynamicPool()
     {
+#if OPENMRN_FEATURE_POOL_THREAD_CACHE
+        detach_thread_caches();
+#endif
 #ifdef GTEST
         for (unsigned i = 0; buckets[i].size() != 0; ++i)
         {
@@ -531,11 +535,74 @@ public:
      */
     size_t free_items(size_t size) override;
 
+#if OPENMRN_FEATURE_POOL_THREAD_CACHE
+    /** Enables a per-thread cache of free buffers in front of the buckets.
+     * Every thread then allocates from and releases to its own magazine of
+     * buffers, and takes the bucket's lock only once for refilling or
+     * flushing half a magazine. Call this before the pool is used by more
+     * than one thread.
+     * @param magazine_size how many free buffers a thread may keep for each
+     * bucket; 0 disables the cache. */
+    void set_thread_cache(unsigned magazine_size)
+    {
+        magazineSize_ = magazine_size;
+    }
+
+    /** Number of free items held in the per-thread caches. These are also
+     * included in free_items().
+     * @return number of cached free items */
+    size_t cached_items()
+    {
+        return cached_items(nullptr);
+    }
+#endif
+
 protected:
     /** Free buffer queue */
     Bucket *buckets;
 
 private:
+#if OPENMRN_FEATURE_POOL_THREAD_CACHE
+    struct ThreadCache;
+    class ThreadCacheSet;
+
+    /** @return the cache of the calling thread for this pool, or nullptr if
+     * the thread cannot have one. */
+    ThreadCache *thread_cache();
+
+    /** Takes a free item from a thread cache, refilling it from the bucket if
+     * it is empty.
+     * @param cache cache of the calling thread
+     * @param bucket which bucket to allocate from
+     * @return free item or nullptr if the bucket is empty too. */
+    BufferBase *cache_alloc(ThreadCache *cache, Bucket *bucket);
+
+    /** Puts a free item into a thread cache, flushing half of it to the
+     * bucket if it is full.
+     * @param cache cache of the calling thread
+     * @param bucket which bucket the item belongs to
+     * @param item the item to release */
+    void cache_free(ThreadCache *cache, Bucket *bucket, BufferBase *item);
+
+    /** Returns all items of a thread cache to the buckets and unregisters the
+     * cache from its pool. Called on thread exit. @param cache to release. */
+    static void release_thread_cache(ThreadCache *cache);
+
+    /** Unregisters all thread caches before the pool goes away. */
+    void detach_thread_caches();
+
+    /** @param bucket if not nullptr, counts only the items of this bucket.
+     * @return number of free items in the thread caches. */
+    size_t cached_items(Bucket *bucket);
+
+    /** How many free items a thread may cache per bucket. 0 if disabled. */
+    unsigned magazineSize_ {0};
+
+    /** Linked list of the thread caches of this pool. Protected by the
+     * global thread cache lock. */
+    ThreadCache *caches_ {nullptr};
+#endif
+
     /** Get a free item out of the pool.
      * @param result pointer to a pointer to the result
      * @param flow if !NULL, then the alloc call is considered async and will
@@ -54,10 +54,14 @@ public:
     /// @param buffer_bytes how many bytes to buffer up max.
     /// @param delay_nsec how many nanoseconds long we should buffer the output
     /// data max.
+    /// @param skip_member what to set the skipMember_ of outgoing buffers to
+    /// for data that was added with try_append().
     BufferPort(Service *service, HubPortInterface *downstream,
-        unsigned buffer_bytes, long long delay_nsec)
+        unsigned buffer_bytes, long long delay_nsec,
+        HubPortInterface *skip_member = nullptr)
         : HubPort(service)
         , downstream_(downstream)
+        , skipMember_(skip_member)
         , delayNsec_(delay_nsec)
         , sendBuf_(new char[buffer_bytes])
         , bufSize_(buffer_bytes)
@@ -83,35 +87,92 @@ public:
         return true;
     }
 
-private:
-    Action entry() override
+    /// Appends data to the send buffer directly, bypassing the queue of
+    /// this flow. This allows the caller to share one buffer among many
+    /// ports (a buffer can only be in one queue at a time). Must be called on
+    /// the executor of this flow, and skip_member must have been given in the
+    /// constructor.
+    ///
+    /// @param data characters to append.
+    /// @param len number of characters to append.
+    /// @return true if the data was taken. If false, the caller has to send
+    /// a buffer with the data the regular way. This happens when the flow is
+    /// busy, the send buffer is full or all output buffers are in use.
+    bool try_append(const char *data, size_t len)
     {
+        HASSERT(skipMember_);
+        if (!is_waiting() || len >= (bufSize_ - bufEnd_))
+        {
+            return false;
+        }
         if (!tgtBuf_)
         {
-            return allocate_and_call(downstream_, STATE(buf_alloc_done),
-                config_gridconnect_bridge_max_outgoing_packets() <= 1
-                    ? nullptr
-                    : &outputPool_);
+            if (config_gridconnect_bridge_max_outgoing_packets() > 1)
+            {
+                outputPool_.try_alloc(&tgtBuf_);
+                if (!tgtBuf_)
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                downstream_->pool()->alloc(&tgtBuf_);
+            }
+            tgtBuf_->data()->skipMember_ = skipMember_;
         }
-        // Defines whether we should optimize the traffic and flush right now.
-        bool opt_flush = false;
-        // This code is OpenLCB-specific. It looks for a certain pattern in the
-        // output data stream, and if that pattern is found, inserts an extra
-        // flush right now, instead of waiting for the timeout to pass. The
-        // data sent on is never modified, so this is purely a performance
-        // optimization for OpenLCB.
-        if (msg().data()[0] == ':' && msg().data()[1] == 'X') {
-            if (msg().data()[3] == 'A' || msg().data()[3] == 'D')
+        memcpy(sendBuf_ + bufEnd_, data, len);
+        bufEnd_ += len;
+        if (should_flush(data, len))
+        {
+            flush_buffer();
+        }
+        else if (!timerPending_)
+        {
+            timerPending_ = 1;
+            bufferTimer_.start(delayNsec_);
+        }
+        return true;
+    }
+
+private:
+    /// This code is OpenLCB-specific. It looks for a certain pattern in the
+    /// output data stream, and if that pattern is found, we will flush right
+    /// now, instead of waiting for the timeout to pass. The data sent on is
+    /// never modified, so this is purely a performance optimization for
+    /// OpenLCB.
+    /// @param data one gridconnect packet.
+    /// @param len number of bytes in data.
+    /// @return true if the buffer should be flushed after this packet.
+    static bool should_flush(const char *data, size_t len)
+    {
+        if (len >= 7 && data[0] == ':' && data[1] == 'X')
+        {
+            if (data[3] == 'A' || data[3] == 'D')
             {
                 // Found datagram "only" or "end" packet.
-                opt_flush = true;
+                return true;
             }
-            else if (strncmp(msg().data() + 3, "9A28", 4) == 0)
+            else if (strncmp(data + 3, "9A28", 4) == 0)
             {
                 // Found datagram acknowledge packet.
-                opt_flush = true;
+                return true;
             }
         }
+        return false;
+    }
+
+    Action entry() override
+    {
+        if (!tgtBuf_)
+        {
+            return allocate_and_call(downstream_, STATE(buf_alloc_done),
+                config_gridconnect_bridge_max_outgoing_packets() <= 1
+                    ? nullptr
+                    : &outputPool_);
+        }
+        // Defines whether we should optimize the traffic and flush right now.
+        bool opt_flush = should_flush(msg().data(), msg().size());
         if (opt_flush && !bufEnd_)
         {
             // nothing accumulated, send off directly.
@@ -156,7 +217,8 @@ private:
     Action buf_alloc_done()
     {
         tgtBuf_ = get_allocation_result(downstream_);
-        tgtBuf_->data()->skipMember_ = message()->data()->skipMember_;
+        tgtBuf_->data()->skipMember_ =
+            skipMember_ ? skipMember_ : message()->data()->skipMember_;
         return call_immediately(STATE(entry));
     }
 
@@ -219,6 +281,8 @@ private:
     Buffer<HubData> *tgtBuf_{nullptr};
     /// Where to send output data to.
     HubPortInterface* downstream_;
+    /// If not null, the skipMember_ of the outgoing buffers.
+    HubPortInterface* skipMember_;
     /// How long maximum we should buffer the input data.
     long long delayNsec_;
     /// Temporarily stores outgoing data.
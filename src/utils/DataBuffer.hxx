@@ -527,6 +527,37 @@ public:
         }
     }
 
+    /// Creates a scatter list of the content, for example for ::writev.
+    /// @param iov array of segment descriptors. IoVec can be struct iovec or
+    /// any structure with iov_base and iov_len members.
+    /// @param max_iov number of entries in iov.
+    /// @return the number of entries filled in. If this is max_iov, there
+    /// might be more data than what fit into iov.
+    template <class IoVec>
+    unsigned fill_iovec(IoVec *iov, unsigned max_iov) const
+    {
+        DataBuffer *head = head_;
+        unsigned skip = skip_;
+        size_t len = size_;
+        unsigned count = 0;
+        while (len > 0 && count < max_iov)
+        {
+            uint8_t *ptr;
+            unsigned available;
+            head = head->get_read_pointer(skip, &ptr, &available);
+            if (available > len)
+            {
+                available = len;
+            }
+            iov[count].iov_base = ptr;
+            iov[count].iov_len = available;
+            ++count;
+            len -= available;
+            skip = 0;
+        }
+        return count;
+    }
+
     /// Attempt to combine *this with o into a single LinkedDataBufferPtr
     /// this. This tries to do `*this += o`. It will succeed if o.head() ==
     /// this->tail() and the bytes in these buffers are back to back.
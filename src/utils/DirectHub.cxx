@@ -43,6 +43,9 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <vector>
+#if OPENMRN_HAVE_WRITEV
+#include <sys/uio.h>
+#endif
 
 #include "executor/AsyncNotifiableBlock.hxx"
 #include "executor/StateFlow.hxx"
@@ -63,51 +66,116 @@ DataBufferPool g_direct_hub_kbyte_pool(1024);
 /// A single service class that is shared between all interconnected DirectHub
 /// instances. It is the responsibility of this Service to perform the locking
 /// of the individual flows.
-class DirectHubService : public Service
+///
+/// The service also contains the admission controller. Callers are queued per
+/// source. Each source may have a token bucket rate limit; callers that find
+/// no token are delayed until a token becomes available. Among the sources
+/// that have callers waiting, the next caller is selected by deficit round
+/// robin, where the cost of a message is its size.
+class DirectHubService : public Service, private Atomic
 {
 public:
-    typedef Q QueueType;
-
     DirectHubService(ExecutorBase *e)
         : Service(e)
         , busy_(0)
+        , currentDrop_(0)
+        , timerPending_(0)
+        , timer_(new TokenTimer(this))
     {
     }
 
-    /// @return lock object for the busy_ flag.
+    ~DirectHubService()
+    {
+        {
+            AtomicHolder h(lock());
+            if (timerPending_)
+            {
+                // The timer is running or about to be started. It will
+                // delete itself when it expires.
+                timer_->parent_ = nullptr;
+            }
+            else
+            {
+                delete timer_;
+            }
+        }
+        for (SourceState *s : sources_)
+        {
+            delete s;
+        }
+    }
+
+    /// @return lock object for the busy_ flag and the queues.
     Atomic *lock()
     {
-        return pendingSend_.lock();
+        return this;
     }
 
     /// Adds a caller to the waiting list of who wants to send traffic to the
     /// hub. If there is no waiting list, the caller will be executed inline.
     /// @param caller represents an entry point to the hub. It is required that
     /// caller finishes its run() by invoking on_done().
-    void enqueue_caller(Executable *caller)
+    /// @param source where the message comes from.
+    void enqueue_caller(Executable *caller, HubSource *source)
     {
         {
             AtomicHolder h(lock());
-            if (busy_)
+            SourceState *s = get_source_locked(source);
+            long long wait = s->token_wait(os_get_time_monotonic());
+            if (wait > 0)
+            {
+                if (s->queue_.pending() >= s->maxDelayed_)
+                {
+                    ++stats_.dropped;
+                    if (busy_)
+                    {
+                        dropQueue_.insert_locked(caller);
+                        return;
+                    }
+                    // Runs the caller inline, but the message will be
+                    // discarded.
+                    busy_ = 1;
+                    currentDrop_ = 1;
+                    currentSource_ = nullptr;
+                }
+                else
+                {
+                    ++stats_.delayed;
+                    s->queue_.insert_locked(caller);
+                    if (!busy_)
+                    {
+                        arm_timer_locked(wait);
+                    }
+                    return;
+                }
+            }
+            else if (busy_ || !s->queue_.empty())
             {
                 /// @todo there is a short period of priority inversion here,
                 /// because we insert an executable into a separate queue here
-                /// than the Executor. We dequeue the highest priority in
-                /// on_done(), but if that happens to be a low priority, that
-                /// might get stuck in the Executor for a long time, even if in
-                /// the meantime a higher priority message arrives here. A
-                /// better strategy would be to enqueue the Executable's in the
-                /// Service's executor directly instead of queueing them and
-                /// pushing them one by one to the Service's executor. In that
-                /// case we'd need a third state between busy and not busy:
-                /// whether we're queueing executable's or whether we're
-                /// dumping them into the executor. We would also need to keep
-                /// track of how many went to the Executor already, such that
-                /// we know when busy_ gets back to false.
-                pendingSend_.insert_locked(caller);
-                return;
+                /// than the Executor. We dequeue the next one in on_done(),
+                /// but if that happens to be a low priority, that might get
+                /// stuck in the Executor for a long time, even if in the
+                /// meantime a higher priority message arrives here.
+                s->queue_.insert_locked(caller);
+                if (busy_)
+                {
+                    return;
+                }
+                // Idle, but there are earlier callers of the same source
+                // waiting for the timer. They go first.
+                caller = pick_next_locked(&wait);
+                if (!caller)
+                {
+                    return;
+                }
+                busy_ = 1;
+            }
+            else
+            {
+                busy_ = 1;
+                admit_locked(s);
             }
-            busy_ = 1;
         }
         caller->run();
     }
@@ -115,27 +183,338 @@ public:
     /// This function must be called at the end of the enqueued functions in
     /// order to properly clear the busy flag or take out the next enqueued
     /// executable.
-    void on_done()
+    /// @param cost how much the message that was just sent costs the source
+    /// in the fair queueing (typically the number of bytes).
+    void on_done(unsigned cost = 1)
     {
-        // De-queues the next entry.
-        Result deq;
+        Executable *next;
         {
             AtomicHolder h(lock());
-            if (pendingSend_.empty())
+            if (currentSource_)
+            {
+                currentSource_->deficit_ -= cost;
+                currentSource_ = nullptr;
+            }
+            currentDrop_ = 0;
+            long long wait;
+            next = pick_next_locked(&wait);
+            if (!next)
             {
                 busy_ = 0;
+                if (wait > 0)
+                {
+                    arm_timer_locked(wait);
+                }
                 return;
             }
-            deq = pendingSend_.next();
         }
         // Schedules it on the executor.
-        executor()->add(static_cast<Executable *>(deq.item), deq.index);
+        executor()->add(next);
+    }
+
+    /// Sets the rate limit of a source. See
+    /// DirectHubInterface::set_source_limit.
+    void set_source_limit(HubSource *source, unsigned msg_per_sec,
+        unsigned burst, unsigned max_delayed)
+    {
+        AtomicHolder h(lock());
+        SourceState *s = get_source_locked(source);
+        s->msgPeriod_ = msg_per_sec ? SEC_TO_NSEC(1) / msg_per_sec : 0;
+        s->maxCredit_ = s->msgPeriod_ * std::max(burst, 1u);
+        s->credit_ = s->maxCredit_;
+        s->lastRefill_ = os_get_time_monotonic();
+        s->maxDelayed_ = max_delayed;
+        s->keep_ = msg_per_sec != 0;
+    }
+
+    /// Forgets the state of a source, unless it has callers waiting or a
+    /// rate limit. @param source the port that is going away.
+    void remove_source(HubSource *source)
+    {
+        AtomicHolder h(lock());
+        for (unsigned i = 0; i < sources_.size(); ++i)
+        {
+            SourceState *s = sources_[i];
+            if (s->source_ != source)
+            {
+                continue;
+            }
+            if (!s->queue_.empty() || s == currentSource_)
+            {
+                return;
+            }
+            delete s;
+            sources_.erase(sources_.begin() + i);
+            if (rrIndex_ > i)
+            {
+                --rrIndex_;
+            }
+            if (rrIndex_ >= sources_.size())
+            {
+                rrIndex_ = 0;
+            }
+            lastSource_ = nullptr;
+            return;
+        }
+    }
+
+    /// @return the counters of the admission controller.
+    DirectHubStats get_stats()
+    {
+        AtomicHolder h(lock());
+        return stats_;
     }
 
     /// 1 if there is any message being processed right now.
     unsigned busy_ : 1;
-    /// List of callers that are waiting for the busy_ lock.
-    QueueType pendingSend_;
+    /// 1 if the message being processed right now has to be discarded.
+    unsigned currentDrop_ : 1;
+
+private:
+    /// How much cost a source may send in one round of the fair queueing.
+    static constexpr int QUANTUM = 64;
+
+    /// Admission control and queueing state for one traffic source.
+    struct SourceState
+    {
+        /// @param source the port this state belongs to.
+        SourceState(HubSource *source)
+            : source_(source)
+        {
+        }
+
+        /// Refills the token bucket.
+        /// @param now current time.
+        /// @return 0 if there is a token available, otherwise the time in
+        /// nsec until there will be one.
+        long long token_wait(long long now)
+        {
+            if (!msgPeriod_)
+            {
+                return 0;
+            }
+            credit_ = std::min(maxCredit_, credit_ + (now - lastRefill_));
+            lastRefill_ = now;
+            return credit_ >= msgPeriod_ ? 0 : msgPeriod_ - credit_;
+        }
+
+        /// Where the messages come from.
+        HubSource *source_;
+        /// Callers waiting to send a message.
+        Q queue_;
+        /// Deficit counter for fair queueing. The source can send while this
+        /// is positive.
+        int deficit_ {0};
+        /// Nanoseconds between messages in steady state. 0 if unlimited.
+        long long msgPeriod_ {0};
+        /// Token bucket capacity in nsec (burst * msgPeriod_).
+        long long maxCredit_ {0};
+        /// Tokens in the bucket, in nsec.
+        long long credit_ {0};
+        /// When credit_ was last updated.
+        long long lastRefill_ {0};
+        /// Delayed callers beyond this count are dropped.
+        unsigned maxDelayed_ {UINT_MAX};
+        /// True if this state must be kept even if the source is removed.
+        bool keep_ {false};
+    };
+
+    /// Expires when a rate limited source gets a token again. Allocated
+    /// separately, because it may outlive the service.
+    class TokenTimer : public ::Timer
+    {
+    public:
+        /// @param parent owning service.
+        TokenTimer(DirectHubService *parent)
+            : ::Timer(parent->executor()->active_timers())
+            , parent_(parent)
+            , starter_(this)
+        {
+        }
+
+        /// Starts the timer. Called on the executor.
+        class Starter : public Executable
+        {
+        public:
+            /// @param t the timer to start.
+            Starter(TokenTimer *t)
+                : timer_(t)
+            {
+            }
+
+            void run() override
+            {
+                timer_->start(timer_->wait_);
+            }
+
+        private:
+            /// The timer to start.
+            TokenTimer *timer_;
+        };
+
+        long long timeout() override
+        {
+            if (!parent_)
+            {
+                return DELETE;
+            }
+            parent_->timer_expired();
+            return NONE;
+        }
+
+        /// Owning service, or nullptr if that was deleted.
+        DirectHubService *parent_;
+        /// How long to sleep when the timer is started.
+        long long wait_ {0};
+        /// Put on the executor to start the timer.
+        Starter starter_;
+    };
+
+    /// @return the state of a given source, creating it if needed.
+    /// @param source the port.
+    SourceState *get_source_locked(HubSource *source)
+    {
+        if (lastSource_ && lastSource_->source_ == source)
+        {
+            return lastSource_;
+        }
+        for (SourceState *s : sources_)
+        {
+            if (s->source_ == source)
+            {
+                return lastSource_ = s;
+            }
+        }
+        sources_.push_back(new SourceState(source));
+        return lastSource_ = sources_.back();
+    }
+
+    /// Marks a source as the owner of the message being processed.
+    /// @param s source.
+    void admit_locked(SourceState *s)
+    {
+        if (s->msgPeriod_)
+        {
+            s->credit_ -= s->msgPeriod_;
+        }
+        currentSource_ = s;
+        currentDrop_ = 0;
+        ++stats_.admitted;
+    }
+
+    /// Selects the next caller to run.
+    /// @param wait will be set to the time until a rate limited source gets a
+    /// token, or 0 if nothing is waiting for a token.
+    /// @return the next caller, or nullptr if no caller can run now.
+    Executable *pick_next_locked(long long *wait)
+    {
+        *wait = 0;
+        if (!dropQueue_.empty())
+        {
+            currentDrop_ = 1;
+            currentSource_ = nullptr;
+            return static_cast<Executable *>(dropQueue_.next().item);
+        }
+        long long now = os_get_time_monotonic();
+        bool any_eligible = false;
+        for (SourceState *s : sources_)
+        {
+            if (s->queue_.empty())
+            {
+                s->deficit_ = 0;
+                continue;
+            }
+            long long w = s->token_wait(now);
+            if (w == 0)
+            {
+                any_eligible = true;
+            }
+            else if (*wait == 0 || w < *wait)
+            {
+                *wait = w;
+            }
+        }
+        if (!any_eligible)
+        {
+            return nullptr;
+        }
+        while (true)
+        {
+            SourceState *s = sources_[rrIndex_];
+            if (s->deficit_ > 0 && !s->queue_.empty() && !s->token_wait(now))
+            {
+                admit_locked(s);
+                return static_cast<Executable *>(s->queue_.next().item);
+            }
+            // Turn of the next source.
+            if (++rrIndex_ >= sources_.size())
+            {
+                rrIndex_ = 0;
+            }
+            s = sources_[rrIndex_];
+            if (!s->queue_.empty() && !s->token_wait(now))
+            {
+                s->deficit_ += QUANTUM;
+            }
+        }
+    }
+
+    /// Requests a wakeup from the timer. @param wait nsec from now.
+    void arm_timer_locked(long long wait)
+    {
+        if (timerPending_)
+        {
+            return;
+        }
+        timerPending_ = 1;
+        timer_->wait_ = wait;
+        executor()->add(&timer_->starter_);
+    }
+
+    /// Called on the executor when a rate limited source may have a token.
+    void timer_expired()
+    {
+        Executable *next;
+        {
+            AtomicHolder h(lock());
+            timerPending_ = 0;
+            if (busy_)
+            {
+                // on_done() will take care of it.
+                return;
+            }
+            long long wait;
+            next = pick_next_locked(&wait);
+            if (!next)
+            {
+                if (wait > 0)
+                {
+                    arm_timer_locked(wait);
+                }
+                return;
+            }
+            busy_ = 1;
+        }
+        next->run();
+    }
+
+    /// 1 if the timer is started or about to be started.
+    unsigned timerPending_ : 1;
+    /// Per-source state.
+    std::vector<SourceState *> sources_;
+    /// Cache for the last looked up source.
+    SourceState *lastSource_ {nullptr};
+    /// The source of the message being processed, if it needs to be charged.
+    SourceState *currentSource_ {nullptr};
+    /// Index into sources_ of the source whose turn it is.
+    unsigned rrIndex_ {0};
+    /// Callers whose message will be dropped. They are served first, since
+    /// they are cheap.
+    Q dropQueue_;
+    /// Counters.
+    DirectHubStats stats_ {0, 0, 0};
+    /// Wakes us up when a rate limited source gets a token.
+    TokenTimer *timer_;
 };
 
 template <class T>
@@ -180,20 +559,37 @@ public:
     {
         // By enqueueing on the service we ensure that the state flow is not
         // processing any packets while the code below is running.
-        service()->enqueue_caller(new CallbackExecutable([this, port, done]() {
-            {
-                AtomicHolder h(this);
-                ports_.erase(std::remove(ports_.begin(), ports_.end(), port),
-                    ports_.end());
-            }
-            done->notify();
-            service()->on_done();
-        }));
+        service()->enqueue_caller(
+            new CallbackExecutable([this, port, done]() {
+                {
+                    AtomicHolder h(this);
+                    ports_.erase(
+                        std::remove(ports_.begin(), ports_.end(), port),
+                        ports_.end());
+                }
+                service()->remove_source(port);
+                done->notify();
+                service()->on_done();
+            }),
+            nullptr);
+    }
+
+    using DirectHubInterface<T>::enqueue_send;
+
+    void enqueue_send(Executable *caller, HubSource *source) override
+    {
+        service()->enqueue_caller(caller, source);
+    }
+
+    void set_source_limit(HubSource *source, unsigned msg_per_sec,
+        unsigned burst, unsigned max_delayed) override
+    {
+        service()->set_source_limit(source, msg_per_sec, burst, max_delayed);
     }
 
-    void enqueue_send(Executable *caller) override
+    DirectHubStats get_stats() override
     {
-        service()->enqueue_caller(caller);
+        return service()->get_stats();
     }
 
     MessageAccessor<T> *mutable_message() override
@@ -203,6 +599,13 @@ public:
 
     void do_send() override
     {
+        if (service()->currentDrop_)
+        {
+            msg_.clear();
+            service()->on_done();
+            return;
+        }
+        unsigned cost = message_cost();
         unsigned next_port = 0;
         while (true)
         {
@@ -223,9 +626,12 @@ public:
             }
         }
         msg_.clear();
-        service()->on_done();
+        service()->on_done(cost);
     }
 
+    /// @return the cost of the current message for the fair queueing.
+    unsigned message_cost();
+
     /// Filters a message going towards a specific output port.
     /// @param p the output port
     /// @return true if this message should be sent to that output port.
@@ -247,6 +653,11 @@ private:
     MessageAccessor<T> msg_;
 }; // class DirectHubImpl
 
+template <> unsigned DirectHubImpl<uint8_t[]>::message_cost()
+{
+    return std::max(msg_.buf_.size(), 1u);
+}
+
 /// Temporary function to instantiate the hub.
 DirectHubInterface<uint8_t[]> *create_hub(ExecutorBase *e)
 {
@@ -440,7 +851,7 @@ private:
             wait_and_call(STATE(send_callback));
             inlineCall_ = 1;
             sendComplete_ = 0;
-            parent_->hub_->enqueue_send(this); // causes the callback
+            parent_->hub_->enqueue_send(this, parent_); // causes the callback
             inlineCall_ = 0;
             if (sendComplete_)
             {
@@ -547,8 +958,10 @@ public:
 
         // Sets the initial state of the write flow to the stage where we read
         // the next entry from the queue.
-        wait_and_call(STATE(read_queue));
+        wait_and_call(STATE(start_batch));
         notRunning_ = 1;
+        waitingForBatch_ = 0;
+        flushPending_ = 0;
 
         hub_->register_port(this);
         readFlow_.start();
@@ -567,18 +980,28 @@ public:
             // Port already closed. Ignore data to send.
             return;
         }
+        bool appended = false;
+        bool wakeup = false;
         {
             AtomicHolder h(lock());
             if (pendingTail_ && pendingTail_->buf_.try_append_from(msg->buf_))
             {
                 // Successfully enqueued the bytes into the tail of the queue.
-                // Nothing else to do here.
-                return;
+                appended = true;
+                totalPendingSize_ += msg->buf_.size();
+                flushPending_ |= msg->isFlush_;
+                wakeup = waitingForBatch_ && batch_ready_locked();
+            }
+        }
+        if (appended)
+        {
+            if (wakeup)
+            {
+                timer_.ensure_triggered();
             }
+            return;
         }
 
-        /// @todo we should try to collect the bytes into a buffer first before
-        /// enqueueing them.
         BufferType *b;
         mainBufferPool->alloc(&b);
         b->data()->buf_.reset(msg->buf_);
@@ -597,6 +1020,7 @@ public:
             }
             pendingQueue_.insert_locked(b);
             totalPendingSize_ += msg->buf_.size();
+            flushPending_ |= msg->isFlush_;
             pendingTail_ = b->data();
             if (notRunning_)
             {
@@ -604,11 +1028,20 @@ public:
             }
             else
             {
-                // flow already running. Skip notify.
-                return;
+                // flow already running. Skip notify, but cut the wait for
+                // more data short if we have enough to write.
+                wakeup = waitingForBatch_ && batch_ready_locked();
+                b = nullptr;
             }
         }
-        notify();
+        if (b)
+        {
+            notify();
+        }
+        else if (wakeup)
+        {
+            timer_.ensure_triggered();
+        }
     }
 
 private:
@@ -631,71 +1064,178 @@ private:
         }
     }
 
-    Action read_queue()
+    /// @return true if the queued output is worth writing without waiting
+    /// any longer for more data. Must be called with the lock held.
+    bool batch_ready_locked()
+    {
+        return flushPending_ ||
+            totalPendingSize_ >=
+            (size_t)config_directhub_port_write_coalesce_bytes();
+    }
+
+    /// Called when there is data in the queue. If we have a latency budget,
+    /// waits for more data to arrive before writing, so that a single
+    /// syscall can carry many messages.
+    Action start_batch()
+    {
+        long long delay = config_directhub_port_write_delay_usec();
+        if (delay > 0 && fd_ >= 0 && !currentHead_)
+        {
+            AtomicHolder h(lock());
+            if (!batch_ready_locked())
+            {
+                waitingForBatch_ = 1;
+                return sleep_and_call(
+                    &timer_, USEC_TO_NSEC(delay), STATE(gather));
+            }
+        }
+        return call_immediately(STATE(gather));
+    }
+
+    /// Collects the queued messages into the iovec array, up to MAX_IOV
+    /// segments. Messages that are fully collected are kept alive in done_[]
+    /// until the write completes. A message that does not fit stays in
+    /// currentHead_ and is continued in the next batch.
+    Action gather()
     {
-        BufferType *head;
         {
             AtomicHolder h(lock());
-            head = static_cast<BufferType *>(pendingQueue_.next_locked().item);
-            HASSERT(head);
-            if (head->data() == pendingTail_)
+            waitingForBatch_ = 0;
+            flushPending_ = 0;
+        }
+        iovCount_ = 0;
+        iovHead_ = 0;
+        while (iovCount_ < MAX_IOV && numDone_ < MAX_IOV)
+        {
+            if (!currentHead_)
+            {
+                BufferType *head;
+                {
+                    AtomicHolder h(lock());
+                    head = static_cast<BufferType *>(
+                        pendingQueue_.next_locked().item);
+                    if (!head)
+                    {
+                        break;
+                    }
+                    if (head->data() == pendingTail_)
+                    {
+                        pendingTail_ = nullptr;
+                    }
+                }
+                currentHead_.reset(head);
+                nextToWrite_ = currentHead_->data()->buf_.head();
+                nextToSkip_ = currentHead_->data()->buf_.skip();
+                nextToSize_ = currentHead_->data()->buf_.size();
+            }
+            while (nextToSize_ && iovCount_ < MAX_IOV)
+            {
+                uint8_t *data;
+                unsigned len;
+                nextToWrite_ =
+                    nextToWrite_->get_read_pointer(nextToSkip_, &data, &len);
+                if (len > nextToSize_)
+                {
+                    len = nextToSize_;
+                }
+                nextToSkip_ = 0;
+                nextToSize_ -= len;
+                iov_[iovCount_].iov_base = data;
+                iov_[iovCount_].iov_len = len;
+                ++iovCount_;
+            }
+            if (nextToSize_)
             {
-                pendingTail_ = nullptr;
+                // Out of iovec entries.
+                break;
             }
+            done_[numDone_++] = currentHead_.release();
         }
-        currentHead_.reset(head);
-        nextToWrite_ = currentHead_->data()->buf_.head();
-        nextToSkip_ = currentHead_->data()->buf_.skip();
-        nextToSize_ = currentHead_->data()->buf_.size();
-        return do_write();
+        return call_immediately(STATE(do_write));
     }
 
+    /// Writes the collected iovec array to the fd, as few syscalls as the
+    /// kernel allows.
     Action do_write()
     {
         if (fd_ < 0)
         {
             // fd closed. Drop data to the floor.
-            totalPendingSize_ -= nextToSize_;
-            return check_for_new_message();
+            for (unsigned i = iovHead_; i < iovCount_; ++i)
+            {
+                totalPendingSize_ -= iov_[i].iov_len;
+            }
+            return batch_done();
         }
-        uint8_t *data;
-        unsigned len;
-        nextToWrite_ = nextToWrite_->get_read_pointer(nextToSkip_, &data, &len);
-        if (len > nextToSize_)
+        if (iovHead_ >= iovCount_)
         {
-            len = nextToSize_;
+            return batch_done();
         }
-        nextToSkip_ = 0;
-        nextToSize_ -= len;
-        totalPendingSize_ -= len;
-        totalWritten_ += len;
-        LOG(VERBOSE, "write %u total %zu", (unsigned)len, totalWritten_);
-        return write_repeated(
-            &selectHelper_, fd_, data, len, STATE(write_done));
+#if OPENMRN_HAVE_WRITEV
+        ssize_t ret = ::writev(fd_, &iov_[iovHead_], iovCount_ - iovHead_);
+#else
+        ssize_t ret =
+            ::write(fd_, iov_[iovHead_].iov_base, iov_[iovHead_].iov_len);
+#endif
+        if (ret > 0)
+        {
+            totalPendingSize_ -= ret;
+            totalWritten_ += ret;
+            LOG(VERBOSE, "write %d total %zu", (int)ret, totalWritten_);
+            while (ret > 0)
+            {
+                if ((size_t)ret >= iov_[iovHead_].iov_len)
+                {
+                    ret -= iov_[iovHead_].iov_len;
+                    ++iovHead_;
+                }
+                else
+                {
+                    iov_[iovHead_].iov_base =
+                        (uint8_t *)iov_[iovHead_].iov_base + ret;
+                    iov_[iovHead_].iov_len -= ret;
+                    ret = 0;
+                }
+            }
+            return again();
+        }
+        if (ret < 0 &&
+            (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        {
+            // Blocked. The wakeup will call this state again.
+            selectHelper_.reset(Selectable::WRITE, fd_, Selectable::MAX_PRIO);
+            selectHelper_.set_wakeup(this);
+            service()->executor()->select(&selectHelper_);
+            return wait();
+        }
+        LOG(INFO, "%p: Error writing to fd %d: (%d) %s", this, fd_, errno,
+            strerror(errno));
+        // will close fd and notify the reader flow to exit.
+        report_write_error();
+        // Flushes the queue of messages. fd_ == -1 now so no write will be
+        // attempted.
+        return call_immediately(STATE(do_write));
     }
 
-    Action write_done()
+    /// Called when the current batch is written (or dropped). Releases the
+    /// references to the written messages.
+    Action batch_done()
     {
-        if (selectHelper_.hasError_)
+        for (unsigned i = 0; i < numDone_; ++i)
         {
-            LOG(INFO, "%p: Error writing to fd %d: (%d) %s", this, fd_, errno,
-                strerror(errno));
-            // will close fd and notify the reader flow to exit.
-            report_write_error();
-            // Flushes the queue of messages. fd_ == -1 now so no write will be
-            // attempted.
-            return check_for_new_message();
+            done_[i]->unref();
         }
-        if (nextToSize_)
+        numDone_ = 0;
+        if (currentHead_)
         {
-            return do_write();
+            // The last message did not fit into the batch.
+            return call_immediately(STATE(gather));
         }
         return check_for_new_message();
     }
 
     Action check_for_new_message()
     {
-        currentHead_.reset();
         AtomicHolder h(lock());
         if (pendingQueue_.empty())
         {
@@ -706,11 +1246,11 @@ private:
                 return wait_and_call(STATE(report_and_exit));
             }
             notRunning_ = 1;
-            return wait_and_call(STATE(read_queue));
+            return wait_and_call(STATE(start_batch));
         }
         else
         {
-            return call_immediately(STATE(read_queue));
+            return call_immediately(STATE(start_batch));
         }
     }
 
@@ -850,8 +1390,35 @@ private:
     unsigned nextToSize_;
     /// Helper object for performing asynchronous writes.
     StateFlowSelectHelper selectHelper_ {this};
-    /// Time when the last buffer flush has happened. Not used yet.
-    // long long lastWriteTimeNsec_ = 0;
+    /// Wakes up the write flow when the latency budget runs out.
+    StateFlowTimer timer_ {this};
+
+#if OPENMRN_HAVE_WRITEV
+    /// Maximum number of segments we write with a single syscall.
+    static constexpr unsigned MAX_IOV = 32;
+    /// Segment descriptor for writev.
+    typedef struct iovec IoVec;
+#else
+    /// Maximum number of segments we write with a single syscall.
+    static constexpr unsigned MAX_IOV = 1;
+    /// Segment descriptor (same layout as struct iovec).
+    struct IoVec
+    {
+        void *iov_base;
+        size_t iov_len;
+    };
+#endif
+    /// Segments collected for the current write.
+    IoVec iov_[MAX_IOV];
+    /// Number of valid entries in iov_.
+    unsigned iovCount_ {0};
+    /// First entry in iov_ that is not completely written yet.
+    unsigned iovHead_ {0};
+    /// Messages that are entirely contained in the current write. We release
+    /// them when the write completes.
+    BufferType *done_[MAX_IOV];
+    /// Number of valid entries in done_.
+    unsigned numDone_ {0};
 
     /// Contains buffers of OutputDataEntries to write.
     QueueType pendingQueue_;
@@ -862,6 +1429,10 @@ private:
     size_t totalPendingSize_ = 0;
     /// 1 if the state flow is paused, waiting for the notification.
     uint8_t notRunning_ : 1;
+    /// 1 if the state flow is sleeping to collect more data before writing.
+    uint8_t waitingForBatch_ : 1;
+    /// 1 if a message in the queue requested the output to be flushed.
+    uint8_t flushPending_ : 1;
     /// 1 if the read flow is still running.
     uint8_t readFlowPending_;
     /// 1 if the write flow is still running.
@@ -884,16 +1455,20 @@ void create_port_for_fd(DirectHubInterface<uint8_t[]> *hub, int fd,
         new DirectHubPortSelect(hub, fd, std::move(segmenter), on_error);
 }
 
-class DirectGcTcpHub
+/// Listens on a TCP port and creates a DirectHub port for every incoming
+/// connection.
+class DirectTcpHub
 {
 public:
     /// Constructor.
     ///
-    /// @param can_hub Which CAN-hub should we attach the TCP gridconnect hub
-    /// onto.
-    /// @param port TCp port number to listen on.
-    DirectGcTcpHub(DirectHubInterface<uint8_t[]> *gc_hub, int port);
-    ~DirectGcTcpHub();
+    /// @param hub Which DirectHub should we attach the incoming connections
+    /// to.
+    /// @param port TCP port number to listen on.
+    /// @param segmenter_factory creates the segmenter for each connection.
+    DirectTcpHub(DirectHubInterface<uint8_t[]> *hub, int port,
+        MessageSegmenter *(*segmenter_factory)());
+    ~DirectTcpHub();
 
     /// @return true of the listener is ready to accept incoming connections.
     bool is_started()
@@ -908,13 +1483,15 @@ private:
     ///
     void OnNewConnection(int fd);
 
-    /// Direct GridConnect hub.
-    DirectHubInterface<uint8_t[]> *gcHub_;
+    /// Direct hub to attach the connections to.
+    DirectHubInterface<uint8_t[]> *hub_;
+    /// Creates the segmenter for the wire protocol of the connections.
+    MessageSegmenter *(*segmenterFactory_)();
     /// Helper object representing the listening on the socket.
     SocketListener tcpListener_;
 };
 
-void DirectGcTcpHub::OnNewConnection(int fd)
+void DirectTcpHub::OnNewConnection(int fd)
 {
 #if 0    
     uint32_t rcvbuf;
@@ -925,24 +1502,32 @@ void DirectGcTcpHub::OnNewConnection(int fd)
         LOG(ALWAYS, "Socket rcvbuf %u", (unsigned)rcvbuf);
     }
 #endif    
-    create_port_for_fd(gcHub_, fd,
-        std::unique_ptr<MessageSegmenter>(create_gc_message_segmenter()));
+    create_port_for_fd(
+        hub_, fd, std::unique_ptr<MessageSegmenter>(segmenterFactory_()));
 }
 
-DirectGcTcpHub::DirectGcTcpHub(DirectHubInterface<uint8_t[]> *gc_hub, int port)
-    : gcHub_(gc_hub)
+DirectTcpHub::DirectTcpHub(DirectHubInterface<uint8_t[]> *hub, int port,
+    MessageSegmenter *(*segmenter_factory)())
+    : hub_(hub)
+    , segmenterFactory_(segmenter_factory)
     , tcpListener_(port,
           std::bind(
-              &DirectGcTcpHub::OnNewConnection, this, std::placeholders::_1))
+              &DirectTcpHub::OnNewConnection, this, std::placeholders::_1))
 {
 }
 
-DirectGcTcpHub::~DirectGcTcpHub()
+DirectTcpHub::~DirectTcpHub()
 {
     tcpListener_.shutdown();
 }
 
+void create_direct_tcp_hub(DirectHubInterface<uint8_t[]> *hub, int port,
+    MessageSegmenter *(*segmenter_factory)())
+{
+    new DirectTcpHub(hub, port, segmenter_factory);
+}
+
 void create_direct_gc_tcp_hub(DirectHubInterface<uint8_t[]> *hub, int port)
 {
-    new DirectGcTcpHub(hub, port);
+    create_direct_tcp_hub(hub, port, &create_gc_message_segmenter);
 }
@@ -110,12 +110,30 @@ template <> struct MessageAccessor<uint8_t[]> : public MessageMetadata
     {
         // Walks the buffer links and unrefs everything we own.
         buf_.reset();
+        canBuf_.reset();
+        hasCanBuf_ = false;
         MessageMetadata::clear();
     }
+
+    /// Returns the binary (struct can_frame) representation of a gridconnect
+    /// message. The text is parsed upon the first call only; the result is
+    /// cached in the message, so every egress port that needs binary CAN
+    /// frames shares the same conversion and the same buffer.
+    /// @return a buffer containing exactly one struct can_frame, or an empty
+    /// buffer if this message is not a valid gridconnect packet.
+    const LinkedDataBufferPtr &can_frame_buf();
+
     /// Owns a sequence of linked DataBuffers, holds the offset where to start
     /// reading in the first one, and how many bytes are total in scope for
     /// this message.
     LinkedDataBufferPtr buf_;
+    /// Cached binary CAN representation of buf_. Ports that received the
+    /// message in binary form may fill this in before sending it to the
+    /// hub.
+    LinkedDataBufferPtr canBuf_;
+    /// True if canBuf_ is filled in (an empty canBuf_ then means that the
+    /// message is not a CAN frame).
+    bool hasCanBuf_ = false;
 };
 
 /// Abstract base class for segmenting a byte stream typed input into
@@ -161,6 +179,18 @@ public:
     virtual void send(MessageAccessor<T> *msg) = 0;
 };
 
+/// Counters of the admission controller of a hub.
+struct DirectHubStats
+{
+    /// Messages that were forwarded to the ports.
+    uint32_t admitted;
+    /// Messages that had to wait for their source's rate limit.
+    uint32_t delayed;
+    /// Messages that were discarded because their source exceeded its rate
+    /// limit and had too many messages waiting.
+    uint32_t dropped;
+};
+
 /// Interface for a the central part of a hub.
 template <class T> class DirectHubInterface : public Destructable
 {
@@ -187,7 +217,38 @@ public:
     /// within this function call, or on a different executor.
     /// @param caller callback that actually sends the message. It is required
     /// to call do_send() inline.
-    virtual void enqueue_send(Executable *caller) = 0;
+    void enqueue_send(Executable *caller)
+    {
+        enqueue_send(caller, nullptr);
+    }
+
+    /// Signals that the caller wants to send a message to the hub. When the
+    /// hub is ready for that, and the admission controller allows, will
+    /// execute *caller. This might happen inline within this function call,
+    /// or on a different executor. Callers waiting from different sources
+    /// are served fairly (deficit round robin on the message size).
+    /// @param caller callback that actually sends the message. It is required
+    /// to call do_send() inline.
+    /// @param source the port where the message comes from. This is used for
+    /// admission control and fair queueing. nullptr is a valid source, with no
+    /// rate limit.
+    virtual void enqueue_send(Executable *caller, HubSource *source) = 0;
+
+    /// Sets the rate limit for a given source. Messages beyond the limit are
+    /// delayed until the source gets a token again. When too many messages of
+    /// a source are waiting, further messages from that source are dropped.
+    /// @param source the port where the messages come from.
+    /// @param msg_per_sec how many messages per second are admitted in steady
+    /// state. 0 means unlimited.
+    /// @param burst how many messages can be admitted at once after the
+    /// source was quiet.
+    /// @param max_delayed how many messages may wait for a token before
+    /// messages get dropped.
+    virtual void set_source_limit(HubSource *source, unsigned msg_per_sec,
+        unsigned burst, unsigned max_delayed) = 0;
+
+    /// @return counters of the admission controller.
+    virtual DirectHubStats get_stats() = 0;
 
     /// Accessor to fill in the message payload. Must be called only from
     /// within the callback as invoked by enqueue_send.
@@ -218,6 +279,28 @@ void create_port_for_fd(ByteDirectHubInterface *hub, int fd,
     std::unique_ptr<MessageSegmenter> segmenter,
     Notifiable *on_error = nullptr);
 
+/// Creates a hub port that reads and writes binary struct can_frame packets
+/// on an fd (typically a SocketCAN socket). The hub carries gridconnect
+/// text; each frame is converted to and from the binary format once, see
+/// MessageAccessor<uint8_t[]>::can_frame_buf(). This port will be
+/// automatically deleted upon any error reading/writing the fd.
+/// @param hub gridconnect hub on which to register the new port. Ownership
+/// retained by caller.
+/// @param fd where to read and write CAN frames.
+/// @param on_error this will be notified if the port closes due to an error.
+void create_port_for_can_fd(ByteDirectHubInterface *hub, int fd,
+    Notifiable *on_error = nullptr);
+
+/// Creates a new listener on a given TCP port, which will create a hub port
+/// for each incoming connection. The object is leaked (never destroyed).
+/// @param hub incoming and outgoing data will be multiplexed through this hub
+/// instance.
+/// @param port the TCP port to listen on.
+/// @param segmenter_factory will be called to create the segmenter for each
+/// new connection.
+void create_direct_tcp_hub(ByteDirectHubInterface *hub, int port,
+    MessageSegmenter *(*segmenter_factory)());
+
 /// Creates a new GridConnect listener on a given TCP port. The object is
 /// leaked (never destroyed).
 /// @param hub incoming and outgoing data will be multiplexed through this hub
@@ -0,0 +1,531 @@
+/** \copyright
+ * Copyright (c) 2026, agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  - Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \file DirectHubCan.cxx
+ *
+ * Binary CAN frame (SocketCAN) ports for the gridconnect DirectHub.
+ *
+ * @author agent
+ * @date 17 Oct 2026
+ */
+
+#include "utils/DirectHub.hxx"
+
+#include <fcntl.h>
+
+#include "can_frame.h"
+#include "executor/AsyncNotifiableBlock.hxx"
+#include "executor/StateFlow.hxx"
+#include "nmranet_config.h"
+#include "utils/gc_format.h"
+#include "utils/logging.h"
+
+extern DataBufferPool g_direct_hub_kbyte_pool;
+extern DataBufferPool g_direct_hub_can_frame_pool;
+
+/// Connects a gridconnect hub to an FD that transfers binary struct can_frame
+/// packets, e.g. a SocketCAN socket. This state flow is the write flow; it
+/// takes the binary representation of each message from the hub (converted
+/// at most once per message for all such ports) and writes it to the fd, one
+/// frame per write call. The object is self-owning, i.e. will delete itself
+/// when the fd goes dead.
+class DirectHubCanPortSelect : public DirectHubPort<uint8_t[]>,
+                               private StateFlowBase
+{
+private:
+    /// State flow that reads CAN frames from the FD and sends them to the
+    /// hub.
+    class ReadFlow : public StateFlowBase
+    {
+    public:
+        ReadFlow(DirectHubCanPortSelect *parent)
+            : StateFlowBase(parent->service())
+            , parent_(parent)
+        {
+        }
+
+        /// Starts the current flow.
+        void start()
+        {
+            start_flow(STATE(alloc_for_read));
+        }
+
+        /// Requests the read port to shut down. Must be called on the main
+        /// executor. Causes the flow to notify the parent via the
+        /// read_flow_exit() function then terminate, either inline or not.
+        void read_shutdown()
+        {
+            auto *e = this->service()->executor();
+            if (e->is_selected(&helper_))
+            {
+                // We're waiting in select on reads, we can cancel right now.
+                e->unselect(&helper_);
+                set_terminated();
+                release_buffers();
+                parent_->read_flow_exit();
+            }
+            // Else we're waiting for the regular progress to wake up the
+            // flow. It will check fd_ < 0 to exit.
+        }
+
+    private:
+        /// Root of the read flow. Gets the barrier notifiable that limits the
+        /// number of frames in flight.
+        Action alloc_for_read()
+        {
+            QMember *bn = pendingLimiterPool_.next().item;
+            if (bn)
+            {
+                bufferNotifiable_ = pendingLimiterPool_.initialize(bn);
+                return do_read();
+            }
+            else
+            {
+                pendingLimiterPool_.next_async(this);
+                return wait_and_call(STATE(barrier_allocated));
+            }
+        }
+
+        /// Intermediate step if asynchronous allocation was necessary for the
+        /// read barrier.
+        Action barrier_allocated()
+        {
+            QMember *bn;
+            cast_allocation_result(&bn);
+            HASSERT(bn);
+            bufferNotifiable_ = pendingLimiterPool_.initialize(bn);
+            return do_read();
+        }
+
+        Action do_read()
+        {
+            if (parent_->fd_ < 0)
+            {
+                // Socket closed, terminate and exit.
+                set_terminated();
+                release_buffers();
+                parent_->read_flow_exit();
+                return wait();
+            }
+            return read_repeated(&helper_, parent_->fd_, &frame_,
+                sizeof(frame_), STATE(read_done));
+        }
+
+        /// Renders the incoming frame into gridconnect format. The binary
+        /// frame is kept as well, so that binary egress ports do not have to
+        /// parse it back.
+        Action read_done()
+        {
+            if (helper_.hasError_)
+            {
+                LOG(INFO, "%p: Error reading from fd %d: (%d) %s", parent_,
+                    parent_->fd_, errno, strerror(errno));
+                set_terminated();
+                release_buffers();
+                parent_->report_read_error();
+                return wait();
+            }
+            if (gcBuf_.free() < MIN_GC_FREE)
+            {
+                DataBuffer *b;
+                g_direct_hub_kbyte_pool.alloc(&b);
+                gcBuf_.append_empty_buffer(b);
+            }
+            char *start = (char *)gcBuf_.data_write_pointer();
+            char *end = gc_format_generate(&frame_, start, 0);
+            gcSize_ = end - start;
+            gcBuf_.data_write_advance(gcSize_);
+
+            DataBuffer *b;
+            g_direct_hub_can_frame_pool.alloc(&b);
+            memcpy(b->data(), &frame_, sizeof(frame_));
+            frameBuf_.reset(b, 0, sizeof(frame_));
+
+            // We expect either an inline call to our run() method or
+            // later a callback on the executor. This sequence of calls
+            // prepares for both of those options.
+            wait_and_call(STATE(send_callback));
+            inlineCall_ = 1;
+            sendComplete_ = 0;
+            parent_->hub_->enqueue_send(this, parent_); // causes the callback
+            inlineCall_ = 0;
+            if (sendComplete_)
+            {
+                return call_immediately(STATE(alloc_for_read));
+            }
+            return wait();
+        }
+
+        /// Callback state invoked by the hub when it is ready to take our
+        /// message.
+        Action send_callback()
+        {
+            auto *m = parent_->hub_->mutable_message();
+            m->set_done(bufferNotifiable_);
+            bufferNotifiable_ = nullptr;
+            m->source_ = parent_;
+            m->buf_ = gcBuf_.transfer_head(gcSize_);
+            m->canBuf_ = std::move(frameBuf_);
+            m->hasCanBuf_ = true;
+            parent_->hub_->do_send();
+            sendComplete_ = 1;
+            if (inlineCall_)
+            {
+                // do not disturb current state.
+                return wait();
+            }
+            else
+            {
+                // we were called queued; go back to running the flow on the
+                // main executor.
+                return yield_and_call(STATE(alloc_for_read));
+            }
+        }
+
+        /// Releases all buffers and the read barrier before exiting.
+        void release_buffers()
+        {
+            gcBuf_.reset();
+            frameBuf_.reset();
+            if (bufferNotifiable_)
+            {
+                bufferNotifiable_->notify();
+                bufferNotifiable_ = nullptr;
+            }
+        }
+
+        /// The frame being read.
+        struct can_frame frame_;
+        /// Output buffer where we render the gridconnect packets.
+        LinkedDataBufferPtr gcBuf_;
+        /// Binary copy of the current frame.
+        LinkedDataBufferPtr frameBuf_;
+        /// Barrier notifiable for the current frame.
+        BarrierNotifiable *bufferNotifiable_ = nullptr;
+        /// Number of bytes the current gridconnect packet is.
+        uint16_t gcSize_;
+        /// 1 if we got the send callback inline from the read_done.
+        uint16_t inlineCall_ : 1;
+        /// 1 if the run callback actually happened inline.
+        uint16_t sendComplete_ : 1;
+        /// Pool of BarrierNotifiables that limit the number of frames in
+        /// flight.
+        AsyncNotifiableBlock pendingLimiterPool_ {
+            (unsigned)config_directhub_can_port_max_incoming_frames()};
+        /// Helper object for Select.
+        StateFlowSelectHelper helper_ {this};
+        /// Pointer to the owning port.
+        DirectHubCanPortSelect *parent_;
+        /// Minimum amount of free bytes in the current render buffer in order
+        /// to use it for gridconnect rendering.
+        static constexpr unsigned MIN_GC_FREE = 29;
+    } readFlow_;
+
+    friend class ReadFlow;
+
+public:
+    DirectHubCanPortSelect(
+        DirectHubInterface<uint8_t[]> *hub, int fd, Notifiable *on_error)
+        : StateFlowBase(hub->get_service())
+        , readFlow_(this)
+        , readFlowPending_(1)
+        , writeFlowPending_(1)
+        , hub_(hub)
+        , fd_(fd)
+        , onError_(on_error)
+    {
+        ::fcntl(fd, F_SETFL, O_RDWR | O_NONBLOCK);
+        wait_and_call(STATE(read_queue));
+        notRunning_ = 1;
+
+        hub_->register_port(this);
+        readFlow_.start();
+        LOG(VERBOSE, "%p create can fd %d", this, fd_);
+    }
+
+    /// Synchronous output routine called by the hub.
+    void send(MessageAccessor<uint8_t[]> *msg) override
+    {
+        if (fd_ < 0)
+        {
+            // Port already closed. Ignore data to send.
+            return;
+        }
+        const LinkedDataBufferPtr &frame = msg->can_frame_buf();
+        if (!frame.size())
+        {
+            // Not a CAN frame.
+            return;
+        }
+        BufferType *b;
+        mainBufferPool->alloc(&b);
+        // Takes a reference to the shared binary frame; no copy.
+        b->data()->buf_.reset(frame);
+        if (msg->done_)
+        {
+            b->set_done(msg->done_->new_child());
+        }
+        {
+            AtomicHolder h(lock());
+            if (fd_ < 0)
+            {
+                // Catch race condition when port is already closed.
+                b->unref();
+                return;
+            }
+            pendingQueue_.insert_locked(b);
+            if (notRunning_)
+            {
+                notRunning_ = 0;
+            }
+            else
+            {
+                // flow already running. Skip notify.
+                return;
+            }
+        }
+        notify();
+    }
+
+private:
+    /// Called on the main executor when a read error wants to cancel the write
+    /// flow. Before calling, fd_ must be -1.
+    void shutdown()
+    {
+        HASSERT(fd_ < 0);
+        AtomicHolder h(lock());
+        if (notRunning_)
+        {
+            // Queue is empty, waiting for new entries. There will be no new
+            // entries because fd_ < 0.
+            hub_->unregister_port(this, this);
+            wait_and_call(STATE(report_and_exit));
+        }
+        // Else eventually we will get to check_for_new_message() which will
+        // flush the queue, unregister the port and exit.
+    }
+
+    Action read_queue()
+    {
+        BufferType *head;
+        {
+            AtomicHolder h(lock());
+            head = static_cast<BufferType *>(pendingQueue_.next_locked().item);
+            HASSERT(head);
+        }
+        currentHead_.reset(head);
+        return do_write();
+    }
+
+    Action do_write()
+    {
+        if (fd_ < 0)
+        {
+            // fd closed. Drop data to the floor.
+            return check_for_new_message();
+        }
+        auto &buf = currentHead_->data()->buf_;
+        uint8_t *data;
+        unsigned len;
+        buf.head()->get_read_pointer(buf.skip(), &data, &len);
+        HASSERT(len >= sizeof(struct can_frame));
+        return write_repeated(&selectHelper_, fd_, data,
+            sizeof(struct can_frame), STATE(write_done));
+    }
+
+    Action write_done()
+    {
+        if (selectHelper_.hasError_)
+        {
+            if (errno == ENOBUFS)
+            {
+                // The kernel transmit queue is full. SocketCAN reports this
+                // as an error instead of blocking; try again later.
+                return sleep_and_call(
+                    &timer_, MSEC_TO_NSEC(1), STATE(do_write));
+            }
+            LOG(INFO, "%p: Error writing to fd %d: (%d) %s", this, fd_, errno,
+                strerror(errno));
+            // will close fd and notify the reader flow to exit.
+            report_write_error();
+            // Flushes the queue of messages. fd_ == -1 now so no write will be
+            // attempted.
+            return check_for_new_message();
+        }
+        return check_for_new_message();
+    }
+
+    Action check_for_new_message()
+    {
+        currentHead_.reset();
+        AtomicHolder h(lock());
+        if (pendingQueue_.empty())
+        {
+            if (fd_ < 0)
+            {
+                // unregisters the port. All the queue has been flushed now.
+                hub_->unregister_port(this, this);
+                return wait_and_call(STATE(report_and_exit));
+            }
+            notRunning_ = 1;
+            return wait_and_call(STATE(read_queue));
+        }
+        else
+        {
+            return call_immediately(STATE(read_queue));
+        }
+    }
+
+    /// Terminates the flow, reporting to the barrier.
+    Action report_and_exit()
+    {
+        set_terminated();
+        currentHead_.reset();
+        write_flow_exit();
+        return wait();
+    }
+
+    /// Closes the fd if it is still open.
+    void close_fd()
+    {
+        int close_fd = -1;
+        {
+            AtomicHolder h(lock());
+            if (fd_ >= 0)
+            {
+                std::swap(fd_, close_fd);
+            }
+        }
+        if (close_fd >= 0)
+        {
+            ::close(close_fd);
+        }
+    }
+
+    /// Called by the write flow when it sees an error. Closes the socket, and
+    /// notifies the read flow to exit.
+    void report_write_error()
+    {
+        close_fd();
+        readFlow_.read_shutdown();
+    }
+
+    /// Callback from the ReadFlow when the read call has seen an error. The
+    /// read flow is assumed to be exited. Notifies the write flow to stop and
+    /// possibly deletes *this. Called on the main executor.
+    void report_read_error()
+    {
+        close_fd();
+        read_flow_exit();
+        shutdown();
+    }
+
+    /// Callback from the read flow that it has exited. May delete this.
+    void read_flow_exit()
+    {
+        flow_exit(true);
+    }
+
+    /// Marks the write flow as exited. May delete this.
+    void write_flow_exit()
+    {
+        flow_exit(false);
+    }
+
+    /// Marks a flow to be exited, and once both are exited, notifies done and
+    /// deletes this.
+    /// @param read if true, marks the read flow done, if false, marks the write
+    /// flow done.
+    void flow_exit(bool read)
+    {
+        bool del = false;
+        {
+            AtomicHolder h(lock());
+            if (read)
+            {
+                readFlowPending_ = 0;
+            }
+            else
+            {
+                writeFlowPending_ = 0;
+            }
+            if (writeFlowPending_ == 0 && readFlowPending_ == 0)
+            {
+                del = true;
+            }
+        }
+        if (del)
+        {
+            if (onError_)
+            {
+                onError_->notify();
+            }
+            delete this;
+        }
+    }
+
+    /// @return lock usable for the write flow and the port altogether.
+    Atomic *lock()
+    {
+        return pendingQueue_.lock();
+    }
+
+    /// Holds a reference to one binary frame in the output queue.
+    struct OutputDataEntry
+    {
+        LinkedDataBufferPtr buf_;
+    };
+
+    /// Type of buffers we are enqueuing for output.
+    typedef Buffer<OutputDataEntry> BufferType;
+
+    /// The buffer that is taken out of the queue while writing.
+    BufferPtr<OutputDataEntry> currentHead_;
+    /// Helper object for performing asynchronous writes.
+    StateFlowSelectHelper selectHelper_ {this};
+    /// Timer for retrying writes when the transmit queue is full.
+    StateFlowTimer timer_ {this};
+    /// Contains buffers of OutputDataEntries to write.
+    Q pendingQueue_;
+    /// 1 if the state flow is paused, waiting for the notification.
+    uint8_t notRunning_ : 1;
+    /// 1 if the read flow is still running.
+    uint8_t readFlowPending_ : 1;
+    /// 1 if the write flow is still running.
+    uint8_t writeFlowPending_ : 1;
+    /// Parent hub where output data is coming from.
+    DirectHubInterface<uint8_t[]> *hub_;
+    /// File descriptor for input/output.
+    int fd_;
+    /// This notifiable will be called before exiting.
+    Notifiable *onError_;
+};
+
+void create_port_for_can_fd(
+    DirectHubInterface<uint8_t[]> *hub, int fd, Notifiable *on_error)
+{
+    new DirectHubCanPortSelect(hub, fd, on_error);
+}
@@ -32,8 +32,17 @@
  * @date 1 Mar 2020
  */
 
+#include <string.h>
+
 #include "utils/DirectHub.hxx"
 
+#include "can_frame.h"
+#include "utils/gc_format.h"
+
+/// This object forwards allocations to mainBufferPool. The blocks allocated
+/// here hold exactly one binary CAN frame each.
+DataBufferPool g_direct_hub_can_frame_pool(sizeof(struct can_frame));
+
 /// Message segmenter that chops incoming byte stream into gridconnect packets.
 class DirectHubGcSegmenter : public MessageSegmenter
 {
@@ -59,19 +68,13 @@ public:
         if (isGcPacket_)
         {
             // looking for terminating ;
-            while ((ofs < size) && (data[ofs] != ';'))
-            {
-                ++ofs;
-            }
+            ofs = find(data, 0, size, ';');
             if (ofs < size)
             {
                 // found the terminating ;
                 ++ofs;
                 // append any garbage we still have.
-                while ((ofs < size) && (data[ofs] != ':'))
-                {
-                    ++ofs;
-                }
+                ofs = find(data, ofs, size, ':');
                 packetLen_ += ofs;
                 return packetLen_;
             }
@@ -85,10 +88,7 @@ public:
         else
         {
             // Looking for starting ':'
-            while ((ofs < size) && (data[ofs] != ':'))
-            {
-                ++ofs;
-            }
+            ofs = find(data, 0, size, ':');
             packetLen_ += ofs;
             if (ofs < size)
             {
@@ -111,6 +111,19 @@ public:
     }
 
 private:
+    /// Searches for a character. memchr is vectorized on most platforms.
+    /// @param data input buffer
+    /// @param ofs where to start searching
+    /// @param size number of bytes in data
+    /// @param c the character to look for
+    /// @return the offset of the first c at or after ofs, or size if not
+    /// found.
+    static size_t find(const char *data, size_t ofs, size_t size, char c)
+    {
+        const void *p = memchr(data + ofs, c, size - ofs);
+        return p ? static_cast<const char *>(p) - data : size;
+    }
+
     /// True if the current packet is a gridconnect packet; false if it is
     /// garbage.
     uint32_t isGcPacket_ : 1;
@@ -146,3 +159,48 @@ MessageSegmenter *create_trivial_message_segmenter()
 {
     return new DirectHubTrivialSegmenter();
 }
+
+const LinkedDataBufferPtr &MessageAccessor<uint8_t[]>::can_frame_buf()
+{
+    if (hasCanBuf_)
+    {
+        return canBuf_;
+    }
+    hasCanBuf_ = true;
+    if (!buf_.size())
+    {
+        return canBuf_;
+    }
+    uint8_t *p;
+    unsigned available;
+    buf_.head()->get_read_pointer(buf_.skip(), &p, &available);
+    if (*p != ':')
+    {
+        // Not a gridconnect packet.
+        return canBuf_;
+    }
+    const char *text_packet = nullptr;
+    string assembled_packet;
+    if (available >= buf_.size())
+    {
+        // One block of data. Convert in place.
+        text_packet = (const char *)p;
+    }
+    else
+    {
+        buf_.append_to(&assembled_packet);
+        text_packet = assembled_packet.c_str();
+    }
+    struct can_frame frame;
+    if (gc_format_parse(text_packet, &frame) < 0)
+    {
+        string debug(text_packet, buf_.size());
+        LOG(INFO, "Failed to parse gridconnect packet: '%s'", debug.c_str());
+        return canBuf_;
+    }
+    DataBuffer *b;
+    g_direct_hub_can_frame_pool.alloc(&b);
+    memcpy(b->data(), &frame, sizeof(frame));
+    canBuf_.reset(b, 0, sizeof(frame));
+    return canBuf_;
+}
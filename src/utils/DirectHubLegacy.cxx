@@ -80,7 +80,7 @@ public:
         wait_and_call(STATE(do_send));
         inlineRun_ = true;
         inlineComplete_ = false;
-        targetHub_->enqueue_send(this);
+        targetHub_->enqueue_send(this, (DirectHubPort<uint8_t[]> *)this);
         inlineRun_ = false;
         if (inlineComplete_)
         {
@@ -116,11 +116,10 @@ public:
     /// garbage packet.
     void send(MessageAccessor<uint8_t[]> *msg) override
     {
-        auto &buf = msg->buf_;
-        uint8_t *p;
-        unsigned available;
-        buf.head()->get_read_pointer(buf.skip(), &p, &available);
-        if (buf.size() == 0 || *p != ':')
+        // The conversion is shared with every other binary CAN port the
+        // message goes to.
+        const LinkedDataBufferPtr &frame = msg->can_frame_buf();
+        if (!frame.size())
         {
             // Not a gridconnect packet. Do not do anything.
             return;
@@ -131,26 +130,11 @@ public:
             can_buf->set_done(msg->done_->new_child());
         }
         can_buf->data()->skipMember_ = (CanHubPort *)this;
-        const char *text_packet = nullptr;
-        string assembled_packet;
-        if (available == buf.size())
-        {
-            // One block of data. Convert in place.
-            text_packet = (const char *)p;
-        }
-        else
-        {
-            buf.append_to(&assembled_packet);
-            text_packet = assembled_packet.c_str();
-        }
-        if (gc_format_parse(text_packet, can_buf->data()) < 0)
-        {
-            string debug(text_packet, buf.size());
-            LOG(INFO, "Failed to parse gridconnect packet: '%s'",
-                debug.c_str());
-            can_buf->unref();
-            return;
-        }
+        uint8_t *p;
+        unsigned available;
+        frame.head()->get_read_pointer(frame.skip(), &p, &available);
+        HASSERT(available >= sizeof(struct can_frame));
+        memcpy(can_buf->data()->mutable_frame(), p, sizeof(struct can_frame));
         /// @todo consider if we need to set the priority here.
         sourceHub_->send(can_buf, 0);
     }
@@ -35,6 +35,7 @@
 #include <string>
 
 #include "utils/GcStreamParser.hxx"
+#include "can_frame.h"
 #include "utils/gc_format.h"
 
 bool GcStreamParser::consume_byte(char c)
@@ -75,6 +76,40 @@ bool GcStreamParser::consume_byte(char c)
     return false;
 }
 
+unsigned GcStreamParser::consume_data(const char **data, size_t *len,
+    struct can_frame *frames, unsigned max_frames)
+{
+    unsigned num_frames = 0;
+    // Finishes a packet that was started in a previous call.
+    while (offset_ >= 0 && *len)
+    {
+        --*len;
+        if (consume_byte(*(*data)++) && parse_frame_to_output(frames))
+        {
+            ++num_frames;
+            if (num_frames >= max_frames)
+            {
+                return num_frames;
+            }
+        }
+    }
+    size_t consumed;
+    num_frames += gc_format_parse_bulk(
+        *data, *len, frames + num_frames, max_frames - num_frames, &consumed);
+    *data += consumed;
+    *len -= consumed;
+    if (num_frames < max_frames)
+    {
+        // The rest is a partial packet, which we keep for the next call.
+        while (*len)
+        {
+            --*len;
+            consume_byte(*(*data)++);
+        }
+    }
+    return num_frames;
+}
+
 void GcStreamParser::frame_buffer(std::string* payload) {
     if (offset_ >= 0) {
         payload->assign(cbuf_, offset_);
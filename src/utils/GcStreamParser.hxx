@@ -35,6 +35,7 @@
 #ifndef _UTILS_GCSTREAMPARSER_HXX_
 #define _UTILS_GCSTREAMPARSER_HXX_
 
+#include <stddef.h>
 #include <string>
 
 /**
@@ -66,6 +67,22 @@ public:
      * the frame is set to an error frame. */
     bool parse_frame_to_output(struct can_frame *output_frame);
 
+    /** Bulk version of consume_byte and parse_frame_to_output. Finds all
+     * complete frames in a buffer and parses them into an array. Packets that
+     * fail to parse are dropped. A partial packet at the end of the buffer is
+     * kept in the internal buffer and will be completed by the next call.
+     *
+     * @param data is the incoming data; will be advanced past the consumed
+     * bytes.
+     * @param len is the number of bytes at data; will be decremented by the
+     * consumed bytes. When this is not zero after the call, then the output
+     * array was full; call again to continue.
+     * @param frames is the output array.
+     * @param max_frames is the number of entries in frames; must be nonzero.
+     * @return the number of frames written to frames. */
+    unsigned consume_data(const char **data, size_t *len,
+        struct can_frame *frames, unsigned max_frames);
+
     /** @param payload fills with the current contents of the frame buffer. */
     void frame_buffer(std::string *payload);
 
@@ -49,7 +49,7 @@ void GcTcpHub::on_new_connection(int fd)
     FdUtils::optimize_socket_fd(fd);
     // Create new notification object for tracking the fd.
     OnErrorNotify *n = new OnErrorNotify(this, fd);
-    create_gc_port_for_can_hub(canHub_, fd, n, use_select);
+    create_gc_port_for_can_hub(canHub_, fd, n, use_select, renderer_);
 
     if (onConnectCallback_)
     {
@@ -61,6 +61,9 @@ GcTcpHub::GcTcpHub(CanHubFlow *can_hub, int port,
     std::function<void()> on_connect_callback)
     : onConnectCallback_(on_connect_callback)
     , canHub_(can_hub)
+    , renderer_(config_gridconnect_tcp_shared_rendering() == CONSTANT_TRUE
+              ? new GcSharedRenderer()
+              : nullptr)
     , tcpListener_(port,
           std::bind(&GcTcpHub::on_new_connection, this, std::placeholders::_1),
           "GcTcpHub")
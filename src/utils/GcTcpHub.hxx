@@ -36,11 +36,13 @@
 
 #include <vector>
 #include <functional>
+#include <memory>
 
 #include "utils/socket_listener.hxx"
 #include "utils/Hub.hxx"
 
 class ExecutorBase;
+class GcSharedRenderer;
 
 /// This class runs a CAN-bus HUB listening on TCP socket using the gridconnect
 /// format. Any new incoming connection will be wired into the same virtual CAN
@@ -152,6 +154,10 @@ private:
     /// Which CAN-hub should we attach the TCP gridconnect hub onto.
     CanHubFlow *canHub_;
 
+    /// Renders outgoing frames once for all clients. Null if the
+    /// gridconnect_tcp_shared_rendering option is disabled.
+    std::shared_ptr<GcSharedRenderer> renderer_;
+
     /// Helper object representing the listening on the socket.
     SocketListener tcpListener_;
 
@@ -70,6 +70,25 @@ public:
         isRegistered_ = 1;
     }
 
+    /// Constructor.
+    ///
+    /// @param gc_side A hub of type string, the gridconnect side.
+    /// @param can_side A hub of type struct can_frame, the binary side.
+    /// @param renderer will be used to render outgoing frames. Shared among
+    /// all adapters of can_side.
+    GCAdapter(HubFlow *gc_side, CanHubFlow *can_side,
+        std::shared_ptr<GcSharedRenderer> renderer)
+        : parser_(can_side->service(), can_side, &formatter_)
+        , formatter_(
+              can_side->service(), gc_side, &parser_, std::move(renderer))
+    {
+        gc_side->register_port(&parser_);
+        // The formatter does not queue the frames, so it can accept a shared
+        // reference instead of a private copy for each port.
+        can_side->register_shared_port(&formatter_);
+        isRegistered_ = 1;
+    }
+
     /// Constructor
     ///
     /// @param gc_side_read A hub of type string to read packets from. The read
@@ -135,17 +154,49 @@ public:
             , destination_(destination)
             , skipMember_(skip_member)
             , double_bytes_(double_bytes)
+        {
+            init_pool();
+        }
+
+        /// Constructor for the shared rendering mode. In this mode the
+        /// member has to be registered as a shared port of the CAN hub.
+        ///
+        /// @param service which executor to run on
+        /// @param destination string hub where to write gridconnecct data to.
+        /// @param skip_member what to set the skipmember_ field of the outgoing
+        /// packets to.
+        /// @param renderer will be used to render the frames.
+        BinaryToGCMember(Service *service, HubFlow *destination,
+            HubPort *skip_member, std::shared_ptr<GcSharedRenderer> renderer)
+            : CanHubPort(service)
+            , delayPort_(service, destination, config_gridconnect_buffer_size(),
+                  USEC_TO_NSEC(config_gridconnect_buffer_delay_usec()),
+                  skip_member)
+            , renderer_(std::move(renderer))
+            , destination_(destination)
+            , skipMember_(skip_member)
+            , double_bytes_(0)
+        {
+            init_pool();
+        }
+
+        /// Sets up the pool for the frames sent to us.
+        void init_pool()
         {
             const int cnt = config_gridconnect_bridge_max_outgoing_packets();
-            if (cnt > 1)
+            pool_ = mainBufferPool;
+            if (cnt <= 1)
             {
-                ownedPool_.reset(
-                    new LimitedPool(sizeof(Buffer<CanHubData>), cnt));
-                pool_ = ownedPool_.get();
+                return;
             }
-            else
+            ownedPool_.reset(new LimitedPool(sizeof(Buffer<CanHubData>), cnt));
+            pool_ = ownedPool_.get();
+            if (renderer_)
             {
-                pool_ = mainBufferPool;
+                // The hub makes copies for a shared port only for the frames
+                // that we decline. The rendered frames that we queue
+                // ourselves have their own limit.
+                textPool_.reset(new LimitedPool(sizeof(Buffer<HubData>), cnt));
             }
         }
 
@@ -166,6 +217,11 @@ public:
             {
                 state_pool = (int(ownedPool_->free_items()) == cnt);
             }
+            if (textPool_)
+            {
+                state_pool =
+                    state_pool && (int(textPool_->free_items()) == cnt);
+            }
             return state_delay && state_pool;
         }
 
@@ -176,6 +232,53 @@ public:
             return pool_;
         }
 
+        /// Called by the CAN hub before each frame in the shared rendering
+        /// mode. @return false if the frame has to be queued in this flow
+        /// instead of being rendered inline.
+        bool accepts_shared() override
+        {
+            // Frames queued in this flow have to go out first. If there is
+            // no buffer for queueing the rendered text, the hub has to wait
+            // for our pool like for a regular port.
+            sharedDeclined_ = !is_waiting() ||
+                (textPool_ && textPool_->free_items() == 0);
+            return !sharedDeclined_;
+        }
+
+        void send(Buffer<CanHubData> *message, unsigned priority) override
+        {
+            if (!renderer_ || sharedDeclined_)
+            {
+                // Private copy of the frame.
+                sharedDeclined_ = false;
+                CanHubPort::send(message, priority);
+                return;
+            }
+            // Shared rendering mode: we are called inline from the CAN hub
+            // with a shared reference, so we must not keep the message.
+            const string &text = renderer_->render(message->data()->frame());
+            message->unref();
+            if (text.empty() || delayPort_.try_append(text.data(), text.size()))
+            {
+                return;
+            }
+            // The output is busy; queues a private copy.
+            Buffer<HubData> *copy = nullptr;
+            if (textPool_)
+            {
+                textPool_->try_alloc(&copy);
+            }
+            else
+            {
+                mainBufferPool->alloc(&copy);
+            }
+            // accepts_shared() made sure that there is a free buffer.
+            HASSERT(copy);
+            copy->data()->assign(text);
+            copy->data()->skipMember_ = skipMember_;
+            delayPort_.send(copy, 0);
+        }
+
         Action entry() override
         {
             LOG(VERBOSE, "can packet arrived: %" PRIx32,
@@ -214,8 +317,13 @@ public:
         /// Helper class that assembles larger outgoing packets from the
         /// individual packets by delaying data a little bit.
         BufferPort delayPort_;
+        /// If not null, the frames are rendered by this object instead of
+        /// the state flow.
+        std::shared_ptr<GcSharedRenderer> renderer_;
         /// If we want frame limits, this pool can do that for us.
         std::unique_ptr<LimitedPool> ownedPool_;
+        /// Limits the rendered frames queued in the shared rendering mode.
+        std::unique_ptr<LimitedPool> textPool_;
         /// The allocation buffer pool to use for outgoing frames.
         Pool *pool_;
         /// Destination buffer (characters).
@@ -226,6 +334,9 @@ public:
         HubPort *skipMember_;
         /// Non-zero if doubling was requested.
         int double_bytes_;
+        /// True if we declined the current frame of the hub, so the next
+        /// send() brings a private copy.
+        bool sharedDeclined_ {false};
         /// Helper object
         BarrierNotifiable bn_;
     };
@@ -284,6 +395,8 @@ public:
         {
             inBuf_ = message()->data()->data();
             inBufSize_ = message()->data()->size();
+            numFrames_ = 0;
+            nextFrame_ = 0;
             return call_immediately(STATE(parse_more_data));
         }
 
@@ -291,40 +404,39 @@ public:
         /// frames. @return next state.
         Action parse_more_data()
         {
-            while (inBufSize_--)
+            if (nextFrame_ < numFrames_)
             {
-                char c = *inBuf_++;
-                if (streamSegmenter_.consume_byte(c))
-                {
-                    // End of frame. Allocate an output buffer and parse the
-                    // frame.
-                    return allocate_and_call(destination_, STATE(parse_to_output_frame), frameAllocator_.get());
-                }
+                // Allocate an output buffer for the next parsed frame.
+                return allocate_and_call(destination_,
+                    STATE(send_output_frame), frameAllocator_.get());
+            }
+            if (inBufSize_)
+            {
+                numFrames_ = streamSegmenter_.consume_data(
+                    &inBuf_, &inBufSize_, frames_, PARSE_BATCH);
+                nextFrame_ = 0;
+                return again();
             }
             // Will notify the caller.
             return release_and_exit();
         }
 
-        /** Takes the completed frame in cbuf_, parses it into the allocation
-         * result (a can pipe buffer) and sends off frame. Then comes back to
-         * process buffer. @return next state. */
-        Action parse_to_output_frame()
+        /** Copies the next parsed frame into the allocation result (a can
+         * pipe buffer) and sends off frame. Then comes back to process
+         * buffer. @return next state. */
+        Action send_output_frame()
         {
             auto* b = get_allocation_result(destination_);
-            if (streamSegmenter_.parse_frame_to_output(b->data()))
-            {
-                b->data()->skipMember_ = skipMember_;
-                destination_->send(b);
-            }
-            else
-            {
-                // Releases the buffer.
-                b->unref();
-            }
+            *b->data()->mutable_frame() = frames_[nextFrame_++];
+            b->data()->skipMember_ = skipMember_;
+            destination_->send(b);
             return call_immediately(STATE(parse_more_data));
         }
 
     private:
+        /// How many frames we parse from the input buffer at once.
+        static constexpr unsigned PARSE_BATCH = 8;
+
         /// Holds the state of the incoming characters and the boundary.
         GcStreamParser streamSegmenter_;
         
@@ -333,6 +445,13 @@ public:
         /// The remaining number of characters in inBuf_.
         size_t inBufSize_;
 
+        /// Frames parsed from the input buffer, waiting to be sent.
+        struct can_frame frames_[PARSE_BATCH];
+        /// Number of valid entries in frames_.
+        uint8_t numFrames_;
+        /// Index of the next entry in frames_ to send.
+        uint8_t nextFrame_;
+
         // Allocator to get the frame from. If NULL, the target's default
         // buffer pool will be used.
         std::unique_ptr<LimitedPool> frameAllocator_;
@@ -361,6 +480,12 @@ GCAdapterBase *GCAdapterBase::CreateGridConnectAdapter(HubFlow *gc_side,
     return new GCAdapter(gc_side, can_side, double_bytes);
 }
 
+GCAdapterBase *GCAdapterBase::CreateGridConnectAdapter(HubFlow *gc_side,
+    CanHubFlow *can_side, std::shared_ptr<GcSharedRenderer> renderer)
+{
+    return new GCAdapter(gc_side, can_side, std::move(renderer));
+}
+
 GCAdapterBase *GCAdapterBase::CreateGridConnectAdapter(HubFlow *gc_side_read,
                                                        HubFlow *gc_side_write,
                                                        CanHubFlow *can_side,
@@ -434,6 +559,31 @@ GcPacketPrinter::~GcPacketPrinter()
 {
 }
 
+GcSharedRenderer::GcSharedRenderer(bool double_bytes)
+    : doubleBytes_(double_bytes)
+{
+}
+
+const string &GcSharedRenderer::render(const struct can_frame &frame)
+{
+    // Some can_frame layouts keep the EFF, RTR and ERR flags outside of
+    // can_id, so they have to be compared separately.
+    if (!lastText_.empty() && lastFrame_.can_id == frame.can_id &&
+        IS_CAN_FRAME_EFF(lastFrame_) == IS_CAN_FRAME_EFF(frame) &&
+        IS_CAN_FRAME_RTR(lastFrame_) == IS_CAN_FRAME_RTR(frame) &&
+        IS_CAN_FRAME_ERR(lastFrame_) == IS_CAN_FRAME_ERR(frame) &&
+        lastFrame_.can_dlc == frame.can_dlc &&
+        memcmp(lastFrame_.data, frame.data, frame.can_dlc) == 0)
+    {
+        return lastText_;
+    }
+    char buf[57];
+    char *end = gc_format_generate(&frame, buf, doubleBytes_);
+    lastText_.assign(buf, end - buf);
+    lastFrame_ = frame;
+    return lastText_;
+}
+
 /// Implementation class that adds a device to a CAN hub with dynamic
 /// translation of the packets to/from GridConnect format.
 ///
@@ -449,10 +599,16 @@ struct GcHubPort : public Executable
     /// experiences an error (typically upon device closed or connection lost).
     /// @param use_select true if fd can be used with select, false if threads
     /// are needed.
-    GcHubPort(CanHubFlow *can_hub, int fd, Notifiable *on_exit, bool use_select)
+    /// @param renderer if not null, the rendering of outgoing frames is shared
+    /// with the other ports using this renderer.
+    GcHubPort(CanHubFlow *can_hub, int fd, Notifiable *on_exit, bool use_select,
+        std::shared_ptr<GcSharedRenderer> renderer)
         : gcHub_(can_hub->service())
-        , bridge_(
-              GCAdapterBase::CreateGridConnectAdapter(&gcHub_, can_hub, false))
+        , bridge_(renderer
+                  ? GCAdapterBase::CreateGridConnectAdapter(
+                        &gcHub_, can_hub, std::move(renderer))
+                  : GCAdapterBase::CreateGridConnectAdapter(
+                        &gcHub_, can_hub, false))
         , onExit_(on_exit)
     {
         LOG(VERBOSE, "gchub port %p", (Executable *)this);
@@ -523,8 +679,9 @@ struct GcHubPort : public Executable
     }
 };
 
-void create_gc_port_for_can_hub(
-    CanHubFlow *can_hub, int fd, Notifiable *on_exit, bool use_select)
+void create_gc_port_for_can_hub(CanHubFlow *can_hub, int fd,
+    Notifiable *on_exit, bool use_select,
+    std::shared_ptr<GcSharedRenderer> renderer)
 {
-    new GcHubPort(can_hub, fd, on_exit, use_select);
+    new GcHubPort(can_hub, fd, on_exit, use_select, std::move(renderer));
 }
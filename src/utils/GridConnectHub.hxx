@@ -42,6 +42,38 @@ class Pipe;
 template <class T> class FlowInterface;
 template <class T, int N> class DispatchFlow;
 
+/// Renders CAN frames into GridConnect text once on behalf of many
+/// gridconnect bridges attached to the same CAN hub. The CAN hub hands the
+/// same frame to every bridge in turn, and all but the first bridge get the
+/// cached rendering; each bridge then copies the text straight into its own
+/// output batch buffer.
+///
+/// All bridges using the same renderer must be attached to the same CAN hub,
+/// because the renderer is only accessed from that hub's executor.
+class GcSharedRenderer
+{
+public:
+    /// Constructor.
+    /// @param double_bytes if true, upon rendering data each byte will be
+    /// doubled.
+    GcSharedRenderer(bool double_bytes = false);
+
+    /// Renders a frame, or returns the previous rendering if the frame is
+    /// the same as the last one.
+    /// @param frame the CAN frame to render.
+    /// @return the rendered text; empty for error frames. Valid until the
+    /// next call.
+    const string &render(const struct can_frame &frame);
+
+private:
+    /// Copy of the last rendered frame.
+    struct can_frame lastFrame_;
+    /// Rendering of lastFrame_. Empty if there is no cached frame.
+    string lastText_;
+    /// True if the characters have to be doubled.
+    bool doubleBytes_;
+};
+
 /// Publicly visible API for the gridconnect-to-CAN bridge.  This bridge links
 /// two Hubs, one typed string, the other typed CanHubData, by
 /// parsing/rendering the packets from the gridconnect protocol.
@@ -101,6 +133,19 @@ public:
     ///
     static GCAdapterBase *CreateGridConnectAdapter(HubFlow *gc_side_read,
         HubFlow *gc_side_write, CanHubFlow *can_side, bool double_bytes);
+
+    /// Creates a gridconnect-CAN bridge that takes the GridConnect rendering
+    /// of the outgoing frames from a shared renderer.
+    ///
+    /// @param gc_side is the Hub that has the ASCII GridConnect traffic.
+    /// @param can_side is the Hub that has the binary CAN traffic.
+    /// @param renderer is the renderer shared among all bridges of can_side.
+    ///
+    /// @return a pointer to the created object. It can be deleted, which will
+    ///   terminate the link and unregister the link members from both pipes.
+    ///
+    static GCAdapterBase *CreateGridConnectAdapter(HubFlow *gc_side,
+        CanHubFlow *can_side, std::shared_ptr<GcSharedRenderer> renderer);
 };
 
 /** Create this port for a CAN hub and all packets will be written to stdout in
@@ -135,8 +180,11 @@ private:
  * @param on_exit is a notifiable (may be null) which will be called in case
  * an error is encountered on this port and the port is subsequently closed.
  * @param use_select when true, the FD will be used with select, when false,
- * separate threads will be started with blocking read and write calls. */
+ * separate threads will be started with blocking read and write calls.
+ * @param renderer if not null, the outgoing frames' GridConnect rendering
+ * will be shared with all other ports that use the same renderer. */
 void create_gc_port_for_can_hub(CanHubFlow *can_hub, int fd,
-    Notifiable *on_exit = nullptr, bool use_select = false);
+    Notifiable *on_exit = nullptr, bool use_select = false,
+    std::shared_ptr<GcSharedRenderer> renderer = nullptr);
 
 #endif //_UTILS_GRIDCONNECTHUB_HXX_
@@ -170,6 +170,16 @@ public:
                                POINTER_MASK);
     }
 
+    /// Adds a new port that receives a shared reference to each message
+    /// instead of a private copy. The port's send() is called inline and has
+    /// to follow the rules of DispatchFlow::register_shared_handler. @param
+    /// port is the object to add.
+    void register_shared_port(port_type *port)
+    {
+        this->register_shared_handler(port, reinterpret_cast<uintptr_t>(port),
+                                      POINTER_MASK);
+    }
+
     /// Removes a previously added port. @param port is the port to remove.
     void unregister_port(port_type *port)
     {
@@ -325,7 +325,7 @@ public:
     /// @param on_error notifiable that will be called when a write or read
     /// error is encountered.
     HubDeviceSelect(HFlow *hub, int fd, Notifiable *on_error = nullptr)
-        : FdHubPortService(hub->service()->executor(), fd)
+        : FdHubPortService(hub->service()->executor(), set_nonblocking(fd))
         , hub_(hub)
         , readFlow_(this, hub, &writeFlow_)
         , writeFlow_(this)
@@ -334,12 +334,6 @@ public:
         barrier_.reset(
             on_error ? on_error : EmptyNotifiable::DefaultInstance());
         barrier_.new_child();
-#ifdef __WINNT__
-        unsigned long par = 1;
-        ioctlsocket(fd_, FIONBIO, &par);
-#else
-        ::fcntl(fd, F_SETFL, O_RDWR | O_NONBLOCK);
-#endif
         hub_->register_port(write_port());
         isRegistered_ = true;
     }
@@ -516,6 +510,26 @@ protected:
         }));
     }
 
+    /// Puts a device into nonblocking mode. This has to happen before the
+    /// read flow is created, because the read flow may start reading from
+    /// the device on the executor right away.
+    /// @param fd the filedes of the device.
+    /// @return fd.
+    static int set_nonblocking(int fd)
+    {
+        if (fd < 0)
+        {
+            return fd;
+        }
+#ifdef __WINNT__
+        unsigned long par = 1;
+        ioctlsocket(fd, FIONBIO, &par);
+#else
+        ::fcntl(fd, F_SETFL, O_RDWR | O_NONBLOCK);
+#endif
+        return fd;
+    }
+
     /// Hub whose data we are trying to send.
     HFlow *hub_;
     /// StateFlow for reading data from the fd. Woken when data arrives.
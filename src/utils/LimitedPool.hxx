@@ -75,6 +75,33 @@ public:
         return size == itemSize_ ? freeCount_ : 0;
     }
 
+    /// Allocates a buffer if there is one available, without waiting.
+    /// @param result will be set to the new buffer, or to nullptr if all
+    /// buffers of this pool are in use.
+    template <class BufferType> void try_alloc(Buffer<BufferType> **result)
+    {
+        HASSERT(sizeof(Buffer<BufferType>) == itemSize_);
+        BufferBase *b = nullptr;
+        {
+            AtomicHolder h(this);
+            if (freeCount_ > 0)
+            {
+                --freeCount_;
+                b = base_pool()->alloc_untyped(itemSize_, nullptr);
+                HASSERT(b);
+                b->pool_ = this;
+            }
+        }
+        if (b)
+        {
+            alloc_async_init(b, result);
+        }
+        else
+        {
+            *result = nullptr;
+        }
+    }
+
 protected:
     /// Internal helper funciton used by the Buffer implementation.
     BufferBase *alloc_untyped(size_t size, Executable *flow) override
@@ -131,6 +131,7 @@ DEFAULT_CONST(main_thread_priority, 0xdefa01);
 DEFAULT_CONST(main_thread_stack_size, 2048);
 DEFAULT_CONST(executor_max_sleep_msec, 40);
 DEFAULT_CONST(executor_select_prescaler, 5);
+DEFAULT_CONST(buffer_pool_thread_cache_size, 32);
 
 DEFAULT_CONST(can_tx_buffer_size, 16);
 DEFAULT_CONST(can_rx_buffer_size, 16);
@@ -159,11 +160,20 @@ DEFAULT_CONST(gridconnect_tcp_notsent_lowat_buffer_size, 1);
 
 DEFAULT_CONST_FALSE(gridconnect_tcp_use_select);
 
+DEFAULT_CONST_TRUE(gridconnect_tcp_shared_rendering);
+
 // By default read a full TCP packet from the input port in one go.
 DEFAULT_CONST(directhub_port_incoming_buffer_size, 1460);
 // how many 1460-byte packets per port we parse before waiting for output to
 // drain.
 DEFAULT_CONST(directhub_port_max_incoming_packets, 2);
+// By default output ports write as soon as they get to run.
+DEFAULT_CONST(directhub_port_write_delay_usec, 0);
+// Stops waiting for more output data when a full TCP packet is queued.
+DEFAULT_CONST(directhub_port_write_coalesce_bytes, 1460);
+// how many binary CAN frames per port we read before waiting for output to
+// drain.
+DEFAULT_CONST(directhub_can_port_max_incoming_frames, 16);
 
 #ifdef ESP_PLATFORM
 /// Use a stack size of 3kb for SocketListener tasks.
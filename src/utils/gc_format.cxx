@@ -34,10 +34,23 @@
 //#define LOGLEVEL VERBOSE
 
 #include <stdint.h>
+#include <string.h>
 #include "utils/logging.h"
 #include "utils/gc_format.h"
 #include "can_frame.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/// Longest packet (between the ':' and ';') that the stream parsers accept.
+static const size_t GC_MAX_PACKET_LEN = 31;
+
+/// Uppercase hex digits, indexed by nibble value.
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
 extern "C" {
 
 /** Build an ASCII character representation of a nibble value (uppercase hex).
@@ -46,125 +59,207 @@ extern "C" {
  */
 static char nibble_to_ascii(int nibble)
 {
-    nibble &= 0xf;
-
-    if (nibble < 10)
-    {
-        return ('0' + nibble);
-    }
-    
-    return ('A' + (nibble - 10));
+    return HEX_DIGITS[nibble & 0xf];
 }
 
-/** Tries to parse a hex character to a nibble. Understands both upper and
-    lowercase hex.
+/** Converts a hex character to a nibble without branching. Understands both
+    upper and lowercase hex. Errors are accumulated instead of returned, so
+    that an entire packet can be decoded before checking.
     @param c is the character to convert.
-    @return a converted value, or -1 if an invalid character was encountered.
+    @param bad will be set to nonzero if c is not a hex digit.
+    @return the converted value (garbage if c was invalid).
 */
-static int ascii_to_nibble(const char c)
+static inline unsigned hex_to_nibble(char c, unsigned *bad)
 {
-    if ('0' <= c && '9' >= c)
+    unsigned digit = (uint8_t)(c - '0');
+    // Folds uppercase letters to lowercase.
+    unsigned letter = (uint8_t)((c | 0x20) - 'a');
+    bool is_digit = digit < 10;
+    *bad |= !is_digit & (letter >= 6);
+    return is_digit ? digit : letter + 10;
+}
+
+const char* gc_format_find_delimiter(const char* buf, size_t len)
+{
+    // ':' is 0x3A and ';' is 0x3B, so setting the low bit turns both into ';'
+    // and a single comparison finds either.
+    const char* end = buf + len;
+#if defined(__SSE2__)
+    const __m128i low_bit = _mm_set1_epi8(1);
+    const __m128i semicolon = _mm_set1_epi8(';');
+    while (end - buf >= 16)
     {
-        return c - '0';
+        __m128i v = _mm_loadu_si128((const __m128i*)buf);
+        int mask = _mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_or_si128(v, low_bit), semicolon));
+        if (mask)
+        {
+            return buf + __builtin_ctz(mask);
+        }
+        buf += 16;
     }
-    else if ('A' <= c && 'F' >= c)
+#elif defined(__ARM_NEON)
+    const uint8x16_t low_bit = vdupq_n_u8(1);
+    const uint8x16_t semicolon = vdupq_n_u8(';');
+    while (end - buf >= 16)
     {
-        return c - 'A' + 10;
+        uint8x16_t v = vld1q_u8((const uint8_t*)buf);
+        uint8x16_t eq = vceqq_u8(vorrq_u8(v, low_bit), semicolon);
+        // Narrows each byte of the comparison result to a nibble.
+        uint64_t mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if (mask)
+        {
+            return buf + (__builtin_ctzll(mask) >> 2);
+        }
+        buf += 16;
     }
-    else if ('a' <= c && 'f' >= c)
+#endif
+    for (; buf < end; ++buf)
     {
-        return c - 'a' + 10;
+        if ((*buf | 1) == ';')
+        {
+            return buf;
+        }
     }
-    return -1;
+    return end;
 }
 
-
-int gc_format_parse(const char* buf, struct can_frame* can_frame)
+int gc_format_parse_n(const char* buf, size_t len, struct can_frame* can_frame)
 {
+    const char* end = buf + len;
     CLR_CAN_FRAME_ERR(*can_frame);
-    if (*buf == ':')
+    if (buf < end && *buf == ':')
     {
         // skip leading :
         ++buf;
     }
-    if (*buf == 'X')
+    if (buf < end && *buf == 'X')
     {
         SET_CAN_FRAME_EFF(*can_frame);
     }
-    else if (*buf == 'S') 
+    else if (buf < end && *buf == 'S')
     {
         CLR_CAN_FRAME_EFF(*can_frame);
-    } else
+    }
+    else
     {
         // Unknown packet type.
         SET_CAN_FRAME_ERR(*can_frame);
         return -1;
     }
     buf++;
+    unsigned bad = 0;
     uint32_t id = 0;
     while (1)
     {
-        int nibble = ascii_to_nibble(*buf);
-        if (nibble >= 0)
+        if (buf >= end)
         {
-            id <<= 4;
-            id |= nibble;
-            ++buf;
+            // Ran out of characters before the end of the ID.
+            SET_CAN_FRAME_ERR(*can_frame);
+            return -1;
         }
-        else if (*buf == 'N')
+        char c = *buf++;
+        if (c == 'N')
         {
             // end of ID, frame is coming.
             CLR_CAN_FRAME_RTR(*can_frame);
-            ++buf;
             break;
         }
-        else if (*buf == 'R')
+        else if (c == 'R')
         {
             // end of ID, remote frame is coming.
             SET_CAN_FRAME_RTR(*can_frame);
-            ++buf;
             break;
         }
-        else
-        {
-            // This character should not happen here.
-            SET_CAN_FRAME_ERR(*can_frame);
-            return -1;
-        }
+        id <<= 4;
+        id |= hex_to_nibble(c, &bad);
     } // while parsing ID
+    size_t data_len = end - buf;
+    if (bad || (data_len & 1) || data_len > 2 * sizeof(can_frame->data))
+    {
+        SET_CAN_FRAME_ERR(*can_frame);
+        return -1;
+    }
     if (IS_CAN_FRAME_EFF(*can_frame))
     {
         SET_CAN_FRAME_ID_EFF(*can_frame, id);
     }
     else
     { 
+        // Clears the upper ID bits that a reused frame might still have.
+        SET_CAN_FRAME_ID_EFF(*can_frame, 0);
         SET_CAN_FRAME_ID(*can_frame, id);
     }
     int index = 0;
-    while ((*buf != 0) && (*buf != ';'))
+    for (; buf < end; buf += 2)
     {
-        int nh = ascii_to_nibble(*buf++);
-        int nl = ascii_to_nibble(*buf++);
-        if (nh < 0 || nl < 0)
-        {
-            SET_CAN_FRAME_ERR(*can_frame);
-            return -1;
-        }
-        can_frame->data[index++] = (nh << 4) | nl;
+        can_frame->data[index++] =
+            (hex_to_nibble(buf[0], &bad) << 4) | hex_to_nibble(buf[1], &bad);
     } // while parsing data
+    if (bad)
+    {
+        SET_CAN_FRAME_ERR(*can_frame);
+        return -1;
+    }
     can_frame->can_dlc = index;
     CLR_CAN_FRAME_ERR(*can_frame);
     return 0;
 }
 
-/// Helper function for appending to a buffer ONCE.
-///
-/// @param dst buffer to append data to
-/// @param value one character to append to.
-///
-static void output_single(char*& dst, char value)
+int gc_format_parse(const char* buf, struct can_frame* can_frame)
 {
-    *dst++ = value;
+    size_t len = 0;
+    while (buf[len] != 0 && buf[len] != ';')
+    {
+        ++len;
+    }
+    return gc_format_parse_n(buf, len, can_frame);
+}
+
+size_t gc_format_parse_bulk(const char* buf, size_t len,
+    struct can_frame* frames, size_t max_frames, size_t* consumed)
+{
+    const char* end = buf + len;
+    const char* p = buf;
+    // Points to the first character after the last seen ':', or NULL if we
+    // are not inside a packet.
+    const char* start = nullptr;
+    size_t num_frames = 0;
+    while (num_frames < max_frames)
+    {
+        const char* d = gc_format_find_delimiter(p, end - p);
+        if (d == end)
+        {
+            break;
+        }
+        p = d + 1;
+        if (*d == ':')
+        {
+            start = p;
+            continue;
+        }
+        if (start && size_t(d - start) <= GC_MAX_PACKET_LEN &&
+            gc_format_parse_n(start, d - start, frames + num_frames) == 0)
+        {
+            ++num_frames;
+        }
+        start = nullptr;
+    }
+    if (num_frames >= max_frames)
+    {
+        *consumed = p - buf;
+    }
+    else if (start)
+    {
+        // Partial packet remains; leaves it including the ':'.
+        *consumed = start - 1 - buf;
+    }
+    else
+    {
+        *consumed = len;
+    }
+    return num_frames;
 }
 
 /// Helper function for appending to a buffer TWICE. Used in the implementation
@@ -179,6 +274,46 @@ static void output_double(char*& dst, char value)
     *dst++ = value;
 }
 
+/// Renders the single-byte gridconnect format of a frame.
+///
+/// @param can_frame the frame to render; must not be an error frame.
+/// @param buf where to write the output (at least 28 bytes).
+///
+/// @return pointer after the last written character.
+///
+static char* generate_single(const struct can_frame* can_frame, char* buf)
+{
+    *buf++ = ':';
+    uint32_t id;
+    int offset;
+    if (IS_CAN_FRAME_EFF(*can_frame))
+    {
+        id = GET_CAN_FRAME_ID_EFF(*can_frame);
+        *buf++ = 'X';
+        offset = 28;
+    }
+    else
+    {
+        id = GET_CAN_FRAME_ID(*can_frame);
+        *buf++ = 'S';
+        offset = 8;
+    }
+    for (; offset >= 0; offset -= 4)
+    {
+        *buf++ = HEX_DIGITS[(id >> offset) & 0xf];
+    }
+    *buf++ = IS_CAN_FRAME_RTR(*can_frame) ? 'R' : 'N';
+    for (offset = 0; offset < can_frame->can_dlc; ++offset)
+    {
+        uint8_t d = can_frame->data[offset];
+        buf[0] = HEX_DIGITS[d >> 4];
+        buf[1] = HEX_DIGITS[d & 0xf];
+        buf += 2;
+    }
+    *buf++ = ';';
+    return buf;
+}
+
 /** Formats a can frame in the GridConnect protocol.
 
     If requested, it can create the double protocol with leading !!, trailing ;;
@@ -203,17 +338,17 @@ char* gc_format_generate(const struct can_frame* can_frame, char* buf, int doubl
         LOG(VERBOSE, "GC generate: incoming frame ERR.");
         return buf;
     }
-    void (*output)(char*& dst, char value);
-    if (double_format)
+    if (!double_format)
     {
-        output = output_double;
-        output(buf, '!');
-    }
-    else
-    {
-        output = output_single;
-        output(buf, ':');
+        buf = generate_single(can_frame, buf);
+        if (config_gc_generate_newlines() == CONSTANT_TRUE)
+        {
+            *buf++ = '\n';
+        }
+        return buf;
     }
+    void (*output)(char*& dst, char value) = output_double;
+    output(buf, '!');
     uint32_t id;
     int offset;
     if (IS_CAN_FRAME_EFF(*can_frame))
@@ -254,4 +389,14 @@ char* gc_format_generate(const struct can_frame* can_frame, char* buf, int doubl
     return buf;
 }
 
+char* gc_format_generate_bulk(const struct can_frame* frames, size_t count,
+    char* buf, int double_format)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        buf = gc_format_generate(frames + i, buf, double_format);
+    }
+    return buf;
+}
+
 }
@@ -34,6 +34,8 @@
 #ifndef _UTILS_GC_FORMAT_H_
 #define _UTILS_GC_FORMAT_H_
 
+#include <stddef.h>
+
 #include "utils/constants.hxx"
 
 #ifdef __cplusplus
@@ -79,6 +81,75 @@ int gc_format_parse(const char* buf, struct can_frame* can_frame);
 */
 char* gc_format_generate(const struct can_frame* can_frame, char* buf, int double_format);
 
+/** Finds the next GridConnect frame delimiter (':' or ';') in a buffer. Uses
+    SSE2 or NEON instructions when the target has them, and a scalar loop
+    otherwise.
+
+    @param buf is the start of the data to search.
+
+    @param len is the number of bytes in buf.
+
+    @return pointer to the first ':' or ';' character, or buf + len if there
+    is none.
+*/
+const char* gc_format_find_delimiter(const char* buf, size_t len);
+
+/** Parses a GridConnect packet that is given by its length.
+
+    @param buf points to the packet characters after the leading ':'. The
+    trailing ';' is not part of the packet and no \0 termination is needed.
+
+    @param len is the number of characters in the packet.
+
+    @param can_frame is the CAN frame that will be filled.
+
+    @return 0 in case of success, -1 if there was a packet format error (in
+    this case the frame is set to an error frame).
+*/
+int gc_format_parse_n(const char* buf, size_t len, struct can_frame* can_frame);
+
+/** Parses every complete GridConnect packet from a buffer of stream data.
+
+    Characters outside of a :...; pair are skipped. Packets that are longer
+    than 31 characters or fail to parse are dropped, the same way as
+    GcStreamParser does it.
+
+    @param buf is the incoming stream data.
+
+    @param len is the number of bytes in buf.
+
+    @param frames is the output array.
+
+    @param max_frames is the number of entries in frames.
+
+    @param consumed will be set to the number of bytes processed from
+    buf. The remaining bytes are either a partial packet (starting with ':')
+    or were not looked at because the output array was full.
+
+    @return the number of frames written to the output array.
+*/
+size_t gc_format_parse_bulk(const char* buf, size_t len,
+    struct can_frame* frames, size_t max_frames, size_t* consumed);
+
+/** Formats a sequence of CAN frames in the GridConnect protocol. Error
+    frames are skipped.
+
+    @param frames is the input array.
+
+    @param count is the number of frames in the input array.
+
+    @param buf is the output buffer. The caller must ensure this is big enough
+    to hold count frames (28 or 56 bytes each, plus one for the newline, if
+    enabled).
+
+    @param double_format if non-zero, the doubling format will be generated.
+
+    @return the pointer to the buffer character after the last formatted can
+    frame.
+*/
+char* gc_format_generate_bulk(const struct can_frame* frames, size_t count,
+    char* buf, int double_format);
+
 #ifdef __cplusplus
 }
 #endif